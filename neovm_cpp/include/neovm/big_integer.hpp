@@ -0,0 +1,279 @@
+#ifndef NEOVM_BIG_INTEGER_HPP
+#define NEOVM_BIG_INTEGER_HPP
+
+#include <neovm/config.hpp>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#if defined(_MSC_VER) && defined(_M_X64)
+#include <intrin.h>
+#endif
+
+namespace neo
+{
+	namespace vm
+	{
+		// integer of the vm with the semantics of NEO's BigInteger: truncating division, floor right shift
+		// and a little endian two's complement byte encoding.
+		// values fitting in 64 bits are kept as an int64_t and every operator tries that path first,
+		// larger values use a fixed array of 32-bit limbs, so a BigInteger never allocates
+		class BigInteger
+		{
+		public:
+			// limbs of the magnitude, room for the product of two NEOVM_MAX_BIGINTEGER_SIZE operands
+			static const size_t MAX_LIMBS = NEOVM_MAX_BIGINTEGER_SIZE / 2 + 1;
+
+		private:
+			int64_t _small; // the value when _size is 0
+			uint32_t _size; // limbs of the magnitude in use, 0 when the value fits in 64 bits
+			bool _negative;
+			uint32_t _limbs[MAX_LIMBS]; // magnitude, least significant limb first
+
+			// normalizes a magnitude into a value, throws when it needs more than MAX_LIMBS limbs
+			static BigInteger from_magnitude(const uint32_t *limbs, size_t size, bool negative);
+			static BigInteger from_uint64(uint64_t value);
+
+		public:
+			inline BigInteger() : _small(0), _size(0), _negative(false) {}
+			inline BigInteger(int value) : _small(value), _size(0), _negative(false) {}
+			inline BigInteger(long value) : _small(value), _size(0), _negative(false) {}
+			inline BigInteger(long long value) : _small(value), _size(0), _negative(false) {}
+			inline BigInteger(unsigned int value) : _small(value), _size(0), _negative(false) {}
+			inline BigInteger(unsigned long value) : _small(0), _size(0), _negative(false) { *this = from_uint64(value); }
+			inline BigInteger(unsigned long long value) : _small(0), _size(0), _negative(false) { *this = from_uint64(value); }
+
+			inline BigInteger(const BigInteger &other) : _small(other._small), _size(other._size), _negative(other._negative)
+			{
+				for (uint32_t i = 0; i < _size; i++)
+					_limbs[i] = other._limbs[i];
+			}
+
+			inline BigInteger &operator=(const BigInteger &other)
+			{
+				_small = other._small;
+				_size = other._size;
+				_negative = other._negative;
+				for (uint32_t i = 0; i < _size; i++)
+					_limbs[i] = other._limbs[i];
+				return *this;
+			}
+
+			// whether the value fits in 64 bits
+			inline bool is_small() const { return _size == 0; }
+
+			// the value when is_small()
+			inline int64_t small_value() const { return _small; }
+
+			// the value, INT64_MIN or INT64_MAX when it doesn't fit in 64 bits
+			int64_t to_int64() const;
+
+			inline explicit operator int64_t() const { return is_small() ? _small : to_int64(); }
+
+			// -1, 0 or 1
+			inline int sign() const
+			{
+				if (!is_small())
+					return _negative ? -1 : 1;
+				return _small < 0 ? -1 : (_small > 0 ? 1 : 0);
+			}
+
+			// copies the absolute value into limbs, which needs room for MAX_LIMBS limbs. returns the number of limbs
+			size_t magnitude(uint32_t *limbs, bool *negative) const;
+
+			// minimal little endian two's complement encoding, empty for zero
+			std::vector<char> to_byte_array() const;
+
+			// length of to_byte_array()
+			size_t byte_size() const;
+
+			// decodes a little endian two's complement value, empty bytes are zero
+			static BigInteger from_byte_array(const char *data, size_t size);
+
+			std::string to_string() const;
+
+			// slow paths of the operators, for operands or results that don't fit in 64 bits
+			static BigInteger add(const BigInteger &a, const BigInteger &b);
+			static BigInteger subtract(const BigInteger &a, const BigInteger &b);
+			static BigInteger multiply(const BigInteger &a, const BigInteger &b);
+			// both throw on division by zero
+			static BigInteger divide(const BigInteger &a, const BigInteger &b);
+			static BigInteger remainder(const BigInteger &a, const BigInteger &b);
+			static BigInteger negate(const BigInteger &a);
+			static BigInteger bitwise_and(const BigInteger &a, const BigInteger &b);
+			static BigInteger bitwise_or(const BigInteger &a, const BigInteger &b);
+			static BigInteger bitwise_xor(const BigInteger &a, const BigInteger &b);
+			// shifts right for negative n
+			static BigInteger shift_left(const BigInteger &a, int n);
+			static int compare(const BigInteger &a, const BigInteger &b);
+			static bool equals(const BigInteger &a, const BigInteger &b);
+		};
+
+		typedef BigInteger VMBigInteger;
+
+		inline BigInteger operator+(const BigInteger &a, const BigInteger &b)
+		{
+			if (a.is_small() && b.is_small())
+			{
+				int64_t x = a.small_value(), y = b.small_value();
+				int64_t r = (int64_t)((uint64_t)x + (uint64_t)y);
+				if (((x ^ r) & (y ^ r)) >= 0)
+					return BigInteger(r);
+			}
+			return BigInteger::add(a, b);
+		}
+
+		inline BigInteger operator-(const BigInteger &a, const BigInteger &b)
+		{
+			if (a.is_small() && b.is_small())
+			{
+				int64_t x = a.small_value(), y = b.small_value();
+				int64_t r = (int64_t)((uint64_t)x - (uint64_t)y);
+				if (((x ^ y) & (x ^ r)) >= 0)
+					return BigInteger(r);
+			}
+			return BigInteger::subtract(a, b);
+		}
+
+		// x * y in *result, false when the product doesn't fit in 64 bits
+		inline bool multiply_int64(int64_t x, int64_t y, int64_t *result)
+		{
+#if defined(__GNUC__) || defined(__clang__)
+			return !__builtin_mul_overflow(x, y, result);
+#elif defined(_MSC_VER) && defined(_M_X64)
+			int64_t high;
+			*result = _mul128(x, y, &high);
+			return high == (*result >> 63);
+#else
+			if (x == 0 || y == 0)
+			{
+				*result = 0;
+				return true;
+			}
+			if ((x == -1 && y == INT64_MIN) || (y == -1 && x == INT64_MIN))
+				return false;
+			int64_t r = (int64_t)((uint64_t)x * (uint64_t)y);
+			if (r / y != x)
+				return false;
+			*result = r;
+			return true;
+#endif
+		}
+
+		inline BigInteger operator*(const BigInteger &a, const BigInteger &b)
+		{
+			int64_t r;
+			if (a.is_small() && b.is_small() && multiply_int64(a.small_value(), b.small_value(), &r))
+				return BigInteger(r);
+			return BigInteger::multiply(a, b);
+		}
+
+		inline BigInteger operator/(const BigInteger &a, const BigInteger &b)
+		{
+			if (a.is_small() && b.is_small() && b.small_value() != 0 && !(a.small_value() == INT64_MIN && b.small_value() == -1))
+				return BigInteger(a.small_value() / b.small_value());
+			return BigInteger::divide(a, b);
+		}
+
+		inline BigInteger operator%(const BigInteger &a, const BigInteger &b)
+		{
+			if (a.is_small() && b.is_small() && b.small_value() != 0 && b.small_value() != -1)
+				return BigInteger(a.small_value() % b.small_value());
+			return BigInteger::remainder(a, b);
+		}
+
+		inline BigInteger operator-(const BigInteger &a)
+		{
+			if (a.is_small() && a.small_value() != INT64_MIN)
+				return BigInteger(-a.small_value());
+			return BigInteger::negate(a);
+		}
+
+		inline BigInteger operator~(const BigInteger &a)
+		{
+			// ~x == -x - 1
+			if (a.is_small())
+				return BigInteger(~a.small_value());
+			return BigInteger::negate(a) - 1;
+		}
+
+		inline BigInteger operator&(const BigInteger &a, const BigInteger &b)
+		{
+			if (a.is_small() && b.is_small())
+				return BigInteger(a.small_value() & b.small_value());
+			return BigInteger::bitwise_and(a, b);
+		}
+
+		inline BigInteger operator|(const BigInteger &a, const BigInteger &b)
+		{
+			if (a.is_small() && b.is_small())
+				return BigInteger(a.small_value() | b.small_value());
+			return BigInteger::bitwise_or(a, b);
+		}
+
+		inline BigInteger operator^(const BigInteger &a, const BigInteger &b)
+		{
+			if (a.is_small() && b.is_small())
+				return BigInteger(a.small_value() ^ b.small_value());
+			return BigInteger::bitwise_xor(a, b);
+		}
+
+		inline BigInteger operator<<(const BigInteger &a, int n)
+		{
+			if (a.is_small() && n >= 0 && n < 63)
+			{
+				int64_t r = (int64_t)((uint64_t)a.small_value() << n);
+				if ((r >> n) == a.small_value())
+					return BigInteger(r);
+			}
+			return BigInteger::shift_left(a, n);
+		}
+
+		inline BigInteger operator>>(const BigInteger &a, int n)
+		{
+			if (a.is_small() && n >= 0)
+				return BigInteger(n < 64 ? a.small_value() >> n : (a.small_value() < 0 ? -1 : 0));
+			return BigInteger::shift_left(a, -n);
+		}
+
+		inline bool operator==(const BigInteger &a, const BigInteger &b)
+		{
+			if (a.is_small() || b.is_small())
+				return a.is_small() && b.is_small() && a.small_value() == b.small_value();
+			return BigInteger::equals(a, b);
+		}
+
+		inline bool operator!=(const BigInteger &a, const BigInteger &b)
+		{
+			return !(a == b);
+		}
+
+		inline bool operator<(const BigInteger &a, const BigInteger &b)
+		{
+			if (a.is_small() && b.is_small())
+				return a.small_value() < b.small_value();
+			return BigInteger::compare(a, b) < 0;
+		}
+
+		inline bool operator>(const BigInteger &a, const BigInteger &b)
+		{
+			return b < a;
+		}
+
+		inline bool operator<=(const BigInteger &a, const BigInteger &b)
+		{
+			return !(b < a);
+		}
+
+		inline bool operator>=(const BigInteger &a, const BigInteger &b)
+		{
+			return !(a < b);
+		}
+
+		inline BigInteger abs(const BigInteger &a)
+		{
+			return a.sign() < 0 ? -a : a;
+		}
+	}
+}
+
+#endif
@@ -5,8 +5,6 @@ namespace neo
 {
 	namespace vm
 	{
-		typedef long long VMBigInteger;
-
 		typedef long long VMLInteger; // ʹõ
 
 		typedef unsigned char VMByte;
@@ -14,9 +12,74 @@ namespace neo
 		// to_json_stringʱ֧õĶ
 #define JSON_MAX_REFERENCE_OBJECT_COUNT 10240
 
+		// deepest nesting of arrays, structs and maps the binary serializer writes or reads, and of json json_loads parses
+#define NEOVM_MAX_SERIALIZE_DEPTH 1024
+
 		// invocation
 #define NEOVM_MAX_INVOCATION_DEPTH 1024
 
+		// capacity reserved up front for the evaluation and alt stacks, and the hard limit of items on both of them together
+#define NEOVM_STACK_INITIAL_CAPACITY 256
+#define NEOVM_MAX_STACK_SIZE 2048
+
+		// bytes of the largest integer operand or result of the numeric opcodes, like NEO
+#define NEOVM_MAX_BIGINTEGER_SIZE 32
+		// largest shift of OP_SHL/OP_SHR
+#define NEOVM_MAX_SHIFT 256
+
+		// capacity reserved up front for the invocation stack
+#define NEOVM_INVOCATION_STACK_INITIAL_CAPACITY 16
+
+		// stack items allocated between two garbage collections, grows with the number of live items
+#define NEOVM_GC_DEFAULT_THRESHOLD 4096
+		// default limit of the approximate bytes held by live stack items of one engine, 0 means unlimited
+#define NEOVM_DEFAULT_MAX_HEAP_SIZE (256 * 1024 * 1024)
+
+		// alignment of every block handed out by a MemoryResource
+#define NEOVM_MEMORY_ALIGNMENT 16
+		// bytes the arena reserves from the global heap at once
+#define NEOVM_ARENA_CHUNK_SIZE (64 * 1024)
+		// freed arena blocks up to this size are reused, larger blocks go to the global heap
+#define NEOVM_ARENA_MAX_SMALL_BLOCK 4096
+
+		// bytes of the fixed-size script cache key, the size of a NEO script hash
+#define NEOVM_SCRIPT_HASH_SIZE 20
+		// default byte budget of the decoded scripts kept by a ScriptCache
+#define NEOVM_SCRIPT_CACHE_DEFAULT_SIZE (64 * 1024 * 1024)
+		// ParallelCrypto verifies smaller signature batches on the calling thread
+#define NEOVM_MIN_PARALLEL_SIGNATURE_CHECKS 4
+		// w-NAF windows of secp256r1 public keys: decoded for one verification, and kept in a Secp256r1KeyCache
+#define NEOVM_SECP256R1_KEY_WINDOW 5
+#define NEOVM_SECP256R1_CACHED_KEY_WINDOW 7
+#define NEOVM_SECP256R1_KEY_CACHE_SIZE 4096
+		// jobs an EnginePool queues before submit waits
+#define NEOVM_ENGINE_POOL_QUEUE_SIZE 4096
+		// longest key of a Neo.Storage entry, like NEO
+#define NEOVM_MAX_STORAGE_KEY_SIZE 1024
+		// FileStorage: bytes of a page of the storage file, values longer than the inline limit go to pages of their own,
+		// a bucket of the hash index splits when the records fill more than this percentage of the bucket pages
+#define NEOVM_STORAGE_PAGE_SIZE 4096
+#define NEOVM_STORAGE_MAX_INLINE_VALUE 512
+#define NEOVM_STORAGE_BUCKET_FILL 70
+		// FileStorage: byte budget of the read cache, split into shards with a lock each, and the Bloom filter of the keys
+		// sized for twice the keys stored, at least the minimum
+#define NEOVM_STORAGE_CACHE_SIZE (64 * 1024 * 1024)
+#define NEOVM_STORAGE_CACHE_SHARDS 16
+#define NEOVM_STORAGE_BLOOM_BITS_PER_KEY 10
+#define NEOVM_STORAGE_BLOOM_MIN_KEYS 65536
+		// StateRoot hashes smaller change sets on the calling thread
+#define NEOVM_STATE_ROOT_MIN_PARALLEL_CHANGES 256
+
+		// the interpreter loop uses computed goto (direct threading) when the compiler supports it, a switch otherwise
+#if (defined(__GNUC__) || defined(__clang__)) && !defined(NEOVM_NO_THREADED_DISPATCH)
+#define NEOVM_THREADED_DISPATCH 1
+#endif
+
+		// SHA1/SHA256 use the x86 SHA extensions when the CPU has them, checked once at runtime
+#if (defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)) && !defined(NEOVM_NO_SHA_EXTENSIONS)
+#define NEOVM_SHA_EXTENSIONS 1
+#endif
+
 	}
 }
 
@@ -0,0 +1,126 @@
+#ifndef NEOVM_ENGINE_POOL_HPP
+#define NEOVM_ENGINE_POOL_HPP
+
+#include <neovm/config.hpp>
+#include <neovm/execution_engine.hpp>
+#include <neovm/mpmc_queue.hpp>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace neo
+{
+	namespace vm
+	{
+		// what EnginePool::execute copies out of the engine before it is reset
+		struct EngineJobResult
+		{
+			VMState state;
+			ErrorCode exit_code;
+			std::string fault_message;
+			int64_t gas_used;
+			std::vector<std::vector<char>> results; // the evaluation stack from the top in serialize_stack_item form, empty for interop interfaces
+		};
+
+		// worker threads with one engine each, running independent scripts in parallel.
+		// the crypto, script table and script cache are shared by all workers and must be thread safe, the interop
+		// service is shared too and frozen so no handler changes while engines use it.
+		// a job gets an engine with no script container, no storage, no gas limit and nothing loaded, and the engine is reset
+		// after the job, so nothing the job returns may point into it
+		class EnginePool
+		{
+		public:
+			typedef std::function<void(ExecutionEngine*)> Job;
+
+		private:
+			std::unique_ptr<InteropService> _own_service; // when the host didn't pass one
+			InteropService *_service;
+			std::vector<std::unique_ptr<ExecutionEngine>> _engines;
+			std::vector<std::thread> _workers;
+			MpmcQueue<Job> _queue;
+
+			// workers only sleep when the queue is empty, _pending counts jobs submitted and not yet taken
+			std::mutex _mutex;
+			std::condition_variable _job_ready;
+			std::condition_variable _space_ready;
+			std::condition_variable _idle;
+			std::atomic<int64_t> _pending;
+			std::atomic<int64_t> _unfinished;
+			std::atomic<size_t> _sleeping;
+			std::atomic<bool> _stopping;
+
+			std::unique_ptr<ExecutionEngine> _caller_engine; // for call(), one caller at a time
+			std::mutex _caller_mutex;
+
+		public:
+			// workers == 0 starts one per hardware thread
+			EnginePool(size_t workers, ICrypto *crypto, IScriptTable *table = nullptr, InteropService *service = nullptr,
+				ScriptCache *script_cache = nullptr, size_t queue_capacity = NEOVM_ENGINE_POOL_QUEUE_SIZE);
+
+			// runs the jobs already submitted, then stops the workers
+			~EnginePool();
+
+			size_t workers() const;
+
+			// job runs later on some worker, exceptions escaping it are dropped. waits while the queue is full
+			void submit(Job job);
+
+			// f(engine) on some worker, its result or exception through the future
+			template <class F>
+			std::future<typename std::result_of<F(ExecutionEngine*)>::type> run(F f)
+			{
+				typedef typename std::result_of<F(ExecutionEngine*)>::type Result;
+				auto task = std::make_shared<std::packaged_task<Result(ExecutionEngine*)>>(std::move(f));
+				auto future = task->get_future();
+				submit([task](ExecutionEngine *engine) { (*task)(engine); });
+				return future;
+			}
+
+			// f(engine) on the calling thread with an engine set up like the workers', for work that can't wait behind the
+			// jobs in the queue. callers take turns
+			template <class F>
+			typename std::result_of<F(ExecutionEngine*)>::type call(F f)
+			{
+				std::lock_guard<std::mutex> lock(_caller_mutex);
+				struct Reset
+				{
+					ExecutionEngine *engine;
+					~Reset() { engine->reset(); }
+				} reset = { _caller_engine.get() };
+				prepare(_caller_engine.get());
+				return f(_caller_engine.get());
+			}
+
+			// executes script as the entry script for container with the gas limit, no limit when negative
+			std::future<EngineJobResult> execute(std::vector<char> script, std::vector<char> script_id, IScriptContainer *container, int64_t gas_limit = -1);
+
+			// the same, callback gets the result on the worker thread
+			void execute(std::vector<char> script, std::vector<char> script_id, IScriptContainer *container, int64_t gas_limit,
+				std::function<void(EngineJobResult)> callback);
+
+			// waits until every job submitted so far has finished
+			void wait_idle();
+
+			// loads script as the entry script of engine, executes it and copies the result out
+			static EngineJobResult run_script(ExecutionEngine *engine, const std::vector<char> &script, const std::vector<char> &script_id,
+				IScriptContainer *container, int64_t gas_limit);
+
+			EnginePool(const EnginePool&) = delete;
+			EnginePool &operator=(const EnginePool&) = delete;
+
+		private:
+			// what every job starts with
+			static void prepare(ExecutionEngine *engine);
+			void worker_loop(ExecutionEngine *engine);
+		};
+	}
+}
+
+#endif
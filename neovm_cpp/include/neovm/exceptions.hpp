@@ -20,6 +20,15 @@ namespace neo
 			MEMORY_ERROR = 2,
 			OVER_GAS_LIMIT = 3,
 			UNKNOWN_INSTRUCTION_OP = 4,
+			STACK_UNDERFLOW = 5,
+			STACK_OVERFLOW = 6,
+			INVALID_OPERAND = 7, // wrong type, negative count, index out of range, division by zero
+			INVALID_JUMP = 8,
+			INVOCATION_OVER_LIMIT = 9,
+			SCRIPT_NOT_FOUND = 10,
+			SYSCALL_FAILED = 11,
+			SCRIPT_THROW = 12, // OP_THROW, OP_THROWIFNOT
+			BAD_SCRIPT = 13, // truncated operand, non-push instruction in a push-only script
 
 			UNKNOWN_ERROR = 100
 		};
@@ -44,7 +53,7 @@ namespace neo
 				_code = code;
 				_error_msg = msg;
 			}
-			inline NeoVmException(std::string &msg, ErrorCode code = ErrorCode::SIMPLE_ERROR)
+			inline NeoVmException(const std::string &msg, ErrorCode code = ErrorCode::SIMPLE_ERROR)
 			{
 				_code = code;
 				_error_msg = msg;
@@ -2,45 +2,74 @@
 #define NEOVM_EXECUTION_CONTEXT_HAPP
 
 #include <neovm/execution_engine.hpp>
+#include <neovm/instruction.hpp>
 #include <vector>
 #include <set>
+#include <memory>
 
 namespace neo
 {
 	namespace vm
 	{
+		// a script loaded into an engine, shared by every call frame running it
+		struct LoadedScript
+		{
+			std::shared_ptr<DecodedScript> decoded_script;
+			std::vector<char> script_id;
+			bool push_only;
+			std::set<uint64_t> break_points;
+
+			LoadedScript(std::shared_ptr<DecodedScript> decoded_script, std::vector<char> script_id, bool push_only, std::set<uint64_t> break_points);
+		};
+
+		// one call frame: the loaded script and the instruction pointer.
+		// frames are pooled by the engine, so OP_CALL and OP_RET don't allocate
 		class ExecutionContext
 		{
+			friend class ExecutionEngine;
 		private:
 			ExecutionEngineP _engine;
-			std::vector<char> _script;
-			bool _push_only;
-			BinaryReader *_op_reader;
-			std::set<uint64_t> _break_points;
-
-			std::vector<char> _script_id;
+			std::shared_ptr<LoadedScript> _script;
+			const DecodedScript *_decoded_script;
+			uint32_t _instruction_index;
 		public:
 			void set_instruction_pointer(int value);
 
 			int get_instruction_pointer();
 
+			inline uint32_t instruction_index() const { return _instruction_index; }
+
+			inline void set_instruction_index(uint32_t index) { _instruction_index = index; }
+
+			inline const DecodedScript *decoded_script() const { return _decoded_script; }
+
+			inline const std::shared_ptr<LoadedScript> &loaded_script() const { return _script; }
+
+			// shared by all frames of the loaded script
 			std::set<uint64_t> *break_points();
 
 			std::vector<char> script_id() const;
 
 			bool push_only() const;
 
-			BinaryReader *op_reader() const;
-
-			std::vector<char> *script();
+			const std::vector<char> *script() const;
 
 			OpCode next_instruction();
 
 			ExecutionContext(ExecutionEngineP engine, std::vector<char> script, std::vector<char> script_id, bool push_only, std::set<uint64_t> break_points);
 
+			ExecutionContext(ExecutionEngineP engine, std::shared_ptr<DecodedScript> decoded_script, std::vector<char> script_id, bool push_only, std::set<uint64_t> break_points);
+
+			ExecutionContext(ExecutionEngineP engine, std::shared_ptr<LoadedScript> script, uint32_t instruction_index);
+
 			ExecutionContext *clone();
 
 			virtual ~ExecutionContext();
+
+		private:
+			// used by the engine to recycle pooled frames
+			void reuse(const std::shared_ptr<LoadedScript> &script, uint32_t instruction_index);
+			void release();
 		};
 	}
 }
@@ -11,9 +11,13 @@
 #include <neovm/iinterop_interface.hpp>
 #include <neovm/interop_service.hpp>
 #include <neovm/iscript_table.hpp>
+#include <neovm/script_cache.hpp>
 #include <neovm/icrypto.hpp>
+#include <neovm/storage.hpp>
 #include <neovm/share_pool.hpp>
+#include <neovm/garbage_collector.hpp>
 #include <neovm/random_access_stack.hpp>
+#include <neovm/stack_value.hpp>
 #include <neovm/exceptions.hpp>
 
 namespace neo
@@ -25,41 +29,72 @@ namespace neo
 
 
 		class ExecutionContext;
+		struct LoadedScript;
 
 		class ExecutionEngine;
 
 		typedef std::function<void(ExecutionEngine*)> ExecutioEngineCallback;
 
+		// compile-time switches of the interpreter loop. the engine runs the specialization matching its settings,
+		// so the checks that are off cost nothing per instruction
+		template <bool Trace, bool LimitGas, bool Inspect>
+		struct ExecutionPolicy
+		{
+			static const bool trace = Trace; // debug mode: print every instruction and syscall
+			static const bool limit_gas = LimitGas; // fault when the gas limit is exceeded. gas is counted either way
+			static const bool inspect = Inspect; // breakpoints, push-only scripts and stepping
+		};
+
 		class ExecutionEngine
 		{
 		private:
 			IScriptTable *_table;
+			ScriptCache *_script_cache; // shared decoded scripts for APPCALL/TAILCALL, optional
 			InteropService *_service;
+			bool _owns_service;
 			IScriptContainer *_script_container;
 			ICrypto *_crypto;
+			IStorage *_storage; // behind the Neo.Storage syscalls, optional
+			// overlays of the APPCALL frames over _storage, innermost last, with the invocation stack size of the called context
+			struct StorageFrame
+			{
+				std::unique_ptr<StorageOverlay> overlay;
+				size_t depth;
+			};
+			std::vector<StorageFrame> _storage_frames;
+			bool _storage_frames_enabled;
 			RandomAccessStack<ExecutionContext*> _invocation_stack;
-			RandomAccessStack<StackItem*> _evaluation_stack;
-			std::vector<StackItem*> _alt_stack;
+			std::vector<ExecutionContext*> _free_contexts; // popped frames kept for reuse
+			RandomAccessStack<StackValue> _evaluation_stack;
+			RandomAccessStack<StackValue> _alt_stack;
 			VMState _state;
 			ErrorCode _exit_code;
+			const char *_fault_message; // reason of the last fault, nullptr if the engine didn't fault
+			std::string _fault_what; // message of an exception turned into a fault, _fault_message points to it
+			bool _throw_on_fault;
 
 			bool _debug_mode;
 
-			// memory pool
-			utils::ObjectPool<StackItem> _stack_items_pool;
+			// memory of the stack items, the engine's own arena unless the host passed a resource
+			ArenaResource _arena;
+			MemoryResource *_resource;
+			// owns all stack items of the engine
+			GarbageCollector _gc;
 
 			std::vector<ExecutioEngineCallback> _pre_close_callbacks; // رǰĻص(Դ)
 
 			// status monitor
 			int64_t _gas_limit;
 			int64_t _gas_used;
+			const GasCostTable *_gas_costs;
+			bool _stopped; // by stop() until the gas limit is set again, checked after every instruction whatever the gas policy of the run
 
 			bool _is_neo_mode; // Ƿneo vmģʽneo vmģʽºͷneo vmģʽһЩȥ
 
 			std::map<std::string, StackItem*> _global_env; // ȫֱ
 			std::map<std::string, StackItem*> _container_values; // engineԱʹһЩֵЩֵȫֱ
 		public:
-			ExecutionEngine(IScriptContainer *container, ICrypto *crypto, IScriptTable *table = nullptr, InteropService *service = nullptr);
+			ExecutionEngine(IScriptContainer *container, ICrypto *crypto, IScriptTable *table = nullptr, InteropService *service = nullptr, MemoryResource *resource = nullptr);
 
 			ExecutionContext* current_context() const;
 
@@ -76,10 +111,14 @@ namespace neo
 			void set_no_gas_limit();
 			void set_gas_used(int64_t gas_used);
 			void add_gas_used(int64_t delta_used);
+			// prices the scripts loaded afterwards, the default table (1 gas per opcode) if nullptr
+			void set_gas_cost_table(const GasCostTable *gas_costs);
+			const GasCostTable *gas_cost_table() const;
 
 			void set_neo_mode(bool neo_mode);
 			bool is_neo_mode() const;
 
+			// faults at the next instruction, also when called by a syscall of a run without a gas limit
 			void stop();
 
 			void open_debug_mode();
@@ -88,11 +127,29 @@ namespace neo
 
 			void add_stack_item_to_pool(StackItem *obj);
 
+			MemoryResource *memory_resource() const;
+
+			GarbageCollector *garbage_collector();
+
+			// frees the stack items not reachable from the stacks, global variables, container values or pinned items
+			void collect_garbage();
+
 			ExecutionContext *pop_from_invocation_stack();
 
-			RandomAccessStack<StackItem*> *evaluation_stack();
+			RandomAccessStack<StackValue> *evaluation_stack();
 
 			IScriptContainer *script_container() const;
+			// the container of the next script, e.g. the transaction an engine from a pool verifies
+			void set_script_container(IScriptContainer *container);
+
+			// the storage the Neo.Storage syscalls read and write, nullptr makes them fail.
+			// the overlay of the innermost APPCALL frame when storage frames are on
+			IStorage *storage() const;
+			void set_storage(IStorage *storage);
+			// every APPCALL runs on an overlay of its caller's storage, committed to it when the callee returns. a fault or
+			// reset drops all frames without touching the storage set, so the writes of a failed call never reach it. off by default
+			void set_storage_frames(bool enabled);
+			bool storage_frames() const;
 
 			void add_break_point(uint64_t position);
 
@@ -102,10 +159,22 @@ namespace neo
 
 			void execute();
 
+			// drops all contexts, stack items, global variables and container values and rewinds the memory arena,
+			// so the engine can run the next script like a new one. runs the pre-close callbacks
+			void reset();
+
 			VMState state() const;
 
 			ErrorCode exit_code() const;
 
+			// reason of the fault when the state has FAULT, empty otherwise
+			std::string fault_message() const;
+
+			// faults stop the engine with exit_code() and fault_message() set and the invocation stack unwound.
+			// when on, execute() and the step methods also throw a NeoVmException for the fault. off by default
+			void set_throw_on_fault(bool throw_on_fault);
+			bool throw_on_fault() const;
+
 			void register_global_variable(std::string name, StackItem *value);
 			void register_string_global_variable(std::string name, std::string value);
 
@@ -116,6 +185,15 @@ namespace neo
 
 			void load_script(std::vector<char> script, std::vector<char> script_id, bool push_only);
 
+			void load_script(std::shared_ptr<DecodedScript> script, std::vector<char> script_id, bool push_only);
+
+			// scripts loaded from the script table are looked up in and added to cache, nullptr disables caching
+			void set_script_cache(ScriptCache *cache);
+			ScriptCache *script_cache() const;
+
+			// the decoded script of a script id from the script cache or the script table, nullptr if there is no such script
+			std::shared_ptr<DecodedScript> get_decoded_script(const char *script_id, size_t size);
+
 			bool remove_break_point(uint64_t position);
 
 			void step_into();
@@ -128,10 +206,34 @@ namespace neo
 			StackItem *execute_script(std::vector<char> script_id, std::vector<StackItem*> args, bool has_return=false);
 
 		private:
-			void ExecuteOp(OpCode opcode, ExecutionContext *context);
+			void execute_steps(size_t max_steps);
+
+			// the interpreter loop, runs until the engine halts, faults, breaks or max_steps instructions were executed
+			template <class Policy>
+			void ExecuteOps(size_t max_steps);
+
+			// whether a loaded script has breakpoints or is push-only
+			bool needs_inspection() const;
 
 			void union_change_state(VMState other);
 
+			// stops the engine: sets the exit code and FAULT and unwinds the invocation stack. message must be a literal
+			void fault(ErrorCode code, const char *message);
+
+			// adds gas to the used gas, false without adding when it would exceed the gas limit
+			inline bool charge_gas(int64_t gas)
+			{
+				if (_gas_limit >= 0 && _gas_used + gas > _gas_limit)
+					return false;
+				_gas_used += gas;
+				return true;
+			}
+
+			// a frame from the pool, or a new one when the pool is empty
+			ExecutionContext *new_context(const std::shared_ptr<LoadedScript> &script, uint32_t instruction_index);
+			// returns a popped frame to the pool
+			void free_context(ExecutionContext *context);
+
 		};
 
 		typedef ExecutionEngine* ExecutionEngineP;
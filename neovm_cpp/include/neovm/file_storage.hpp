@@ -0,0 +1,190 @@
+#ifndef NEOVM_FILE_STORAGE_HPP
+#define NEOVM_FILE_STORAGE_HPP
+
+#include <neovm/config.hpp>
+#include <neovm/storage.hpp>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace neo
+{
+	namespace vm
+	{
+		// a file read through a read-only memory map of all of it and written with positioned writes
+		class MappedFile
+		{
+		private:
+			std::string _path;
+			intptr_t _handle;
+			intptr_t _mapping; // the file mapping object on windows
+			char *_data;
+			uint64_t _size;
+
+			void map();
+			void unmap();
+		public:
+			// opens the file for reading and writing, creating it when it doesn't exist
+			explicit MappedFile(const std::string &path);
+			~MappedFile();
+
+			inline const char *data() const { return _data; }
+			inline uint64_t size() const { return _size; }
+
+			// the map is recreated, so pointers into data() are invalid afterwards
+			void resize(uint64_t size);
+
+			// writing past the end grows the file, but only resize maps the new part
+			void write(uint64_t offset, const char *data, size_t size);
+
+			// blocks until everything written is on disk
+			void sync();
+
+			MappedFile(const MappedFile&) = delete;
+			MappedFile &operator=(const MappedFile&) = delete;
+		};
+
+		// Bloom filter of 64 bit hashes, every hash sets bits in a single cache line so a lookup touches memory once
+		class BloomFilter
+		{
+		private:
+			std::vector<uint64_t> _words;
+			uint64_t _block_mask;
+		public:
+			explicit BloomFilter(size_t keys = 0);
+
+			// empties the filter and sizes it for keys hashes
+			void reset(size_t keys);
+
+			void add(uint64_t hash);
+
+			// false only when the hash was never added
+			bool may_contain(uint64_t hash) const;
+		};
+
+		// key to value cache with a byte budget, split into shards by key hash that each evict their least recently used
+		// entries and have a lock of their own. thread safe
+		class StorageCache
+		{
+		private:
+			typedef std::list<std::pair<std::string, std::vector<char>>> EntryList;
+
+			struct Shard
+			{
+				std::mutex mutex;
+				EntryList entries; // most recently used first
+				std::unordered_map<std::string, EntryList::iterator> index;
+				size_t bytes;
+			};
+
+			std::unique_ptr<Shard[]> _shards;
+			size_t _shard_bytes;
+
+			inline Shard &shard_of(uint64_t hash) { return _shards[(hash >> 20) % NEOVM_STORAGE_CACHE_SHARDS]; }
+		public:
+			// max_bytes == 0 caches nothing
+			explicit StorageCache(size_t max_bytes);
+
+			bool get(uint64_t hash, const std::string &key, std::vector<char> *value);
+
+			void put(uint64_t hash, const std::string &key, const std::vector<char> &value);
+
+			void remove(uint64_t hash, const std::string &key);
+
+			void clear();
+
+			StorageCache(const StorageCache&) = delete;
+			StorageCache &operator=(const StorageCache&) = delete;
+		};
+
+		// persistent key-value store in a single file of fixed-size pages, read through a memory map.
+		// keys are indexed by a linear hash table with a page per bucket, overflowing to chained pages, and the bucket
+		// directory is kept in memory. keys are hashed with SipHash under a random key of the file, so contracts can't pick
+		// keys that all land in one bucket. a Bloom filter of the keys answers most lookups of missing keys without touching
+		// the file, and a sharded cache keeps the values read last.
+		// writes change copies of the pages in memory until commit, which writes them to a journal next to the file before
+		// the file itself, so after a crash the file is as of the last commit. get is thread safe while nothing is written
+		class FileStorage : public IStorage
+		{
+		private:
+			MappedFile _file;
+			MappedFile _journal;
+			uint64_t _hash_key[2];
+
+			// the header page
+			uint32_t _page_count; // the file can be longer
+			uint32_t _free_page; // first page of the list of free pages, 0 when there is none
+			uint64_t _record_count;
+			uint64_t _record_bytes;
+			uint32_t _level; // 2^level + split buckets, buckets below split are split already
+			uint32_t _split;
+			uint32_t _directory_page;
+
+			std::vector<uint32_t> _buckets; // first page of every bucket
+			size_t _saved_buckets; // buckets in the directory pages
+
+			// pages written since the last commit, by page number
+			std::vector<std::unique_ptr<char[]>> _dirty;
+			std::vector<uint32_t> _dirty_pages;
+
+			BloomFilter _bloom;
+			uint64_t _bloom_capacity;
+			uint64_t _bloom_keys;
+			bool _bloom_rebuilt; // since the last commit
+			StorageCache _cache;
+
+			void recover();
+			void create();
+			void load_header();
+			void load_directory();
+			void save_directory();
+			void write_header();
+
+			inline const char *page_data(uint32_t page) const
+			{
+				return page < _dirty.size() && _dirty[page] ? _dirty[page].get() : _file.data() + (size_t)page * NEOVM_STORAGE_PAGE_SIZE;
+			}
+			char *writable_page(uint32_t page);
+			uint32_t allocate_page();
+			void free_page(uint32_t page);
+
+			uint64_t hash_key(const std::string &key) const;
+			uint32_t bucket_of(uint64_t hash) const;
+			bool find(uint64_t hash, const std::string &key, uint32_t *page, size_t *offset, uint32_t *previous) const;
+			void read_value(const char *record, std::vector<char> *value) const;
+			void insert_record(uint64_t hash, const char *record, size_t size);
+			void remove_record(uint32_t page, size_t offset, uint32_t previous);
+			uint32_t write_blob(const char *data, size_t size);
+			void free_blob(uint32_t page);
+			void split_bucket();
+			void rebuild_bloom();
+		public:
+			// opens or creates the file at path, path + "-journal" is the journal
+			explicit FileStorage(const std::string &path, size_t cache_size = NEOVM_STORAGE_CACHE_SIZE);
+
+			virtual bool get(const std::string &key, std::vector<char> *value);
+
+			virtual void put(const std::string &key, const std::vector<char> &value);
+
+			virtual void remove(const std::string &key);
+
+			// makes the writes since the last commit durable
+			void commit();
+
+			// throws the writes since the last commit away
+			void rollback();
+
+			inline uint64_t size() const { return _record_count; }
+
+			FileStorage(const FileStorage&) = delete;
+			FileStorage &operator=(const FileStorage&) = delete;
+		};
+	}
+}
+
+#endif
@@ -0,0 +1,70 @@
+#ifndef NEOVM_GARBAGE_COLLECTOR_HPP
+#define NEOVM_GARBAGE_COLLECTOR_HPP
+
+#include <neovm/config.hpp>
+#include <neovm/stack_item.hpp>
+#include <neovm/memory_resource.hpp>
+#include <map>
+#include <vector>
+
+namespace neo
+{
+	namespace vm
+	{
+		// owns every stack item created by one engine and frees the unreachable ones with mark and sweep.
+		// the engine collects only between two instructions, so items held in C++ locals of a running op or syscall are never freed.
+		// items kept by the host across executions must be pinned
+		class GarbageCollector
+		{
+		private:
+			MemoryResource *_resource;
+			std::vector<StackItem*> _items;
+			std::map<StackItem*, size_t> _pinned; // pinned item => pin count
+			size_t _threshold;
+			size_t _max_heap_size;
+			size_t _allocated_count; // items added since the last collection
+			size_t _next_collect_count; // collect when _allocated_count reaches this
+			size_t _heap_size; // approximate bytes of live items at the last collection plus items added since
+			size_t _collections_count;
+		public:
+			GarbageCollector(MemoryResource *resource, size_t threshold = NEOVM_GC_DEFAULT_THRESHOLD, size_t max_heap_size = NEOVM_DEFAULT_MAX_HEAP_SIZE);
+			~GarbageCollector();
+
+			void add(StackItem *item);
+
+			// keep item and everything reachable from it alive until it is unpinned as many times as it was pinned
+			void pin(StackItem *item);
+			void unpin(StackItem *item);
+
+			inline bool should_collect() const
+			{
+				return _allocated_count >= _next_collect_count
+					|| (_max_heap_size > 0 && _heap_size > _max_heap_size);
+			}
+
+			// marks everything reachable from roots and the pinned items, frees the rest.
+			// throws a MEMORY_ERROR NeoVmException when the live items still exceed the heap limit
+			void collect(const std::vector<StackItem*> &roots);
+
+			// drops every item and pin. when the items come from an arena their destructors are skipped,
+			// the memory is reclaimed by resetting the arena
+			void clear();
+
+			size_t items_count() const;
+			size_t heap_size() const;
+			size_t collections_count() const;
+
+			size_t threshold() const;
+			void set_threshold(size_t threshold);
+
+			size_t max_heap_size() const;
+			// 0 means unlimited
+			void set_max_heap_size(size_t max_heap_size);
+
+			GarbageCollector(const GarbageCollector&) = delete;
+			GarbageCollector &operator=(const GarbageCollector&) = delete;
+		};
+	}
+}
+
+#endif
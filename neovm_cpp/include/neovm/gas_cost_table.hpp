@@ -0,0 +1,50 @@
+#ifndef NEOVM_GAS_COST_TABLE_HPP
+#define NEOVM_GAS_COST_TABLE_HPP
+
+#include <neovm/config.hpp>
+#include <neovm/op_code.hpp>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+namespace neo
+{
+	namespace vm
+	{
+		// gas price of every opcode and of every syscall service on top of the SYSCALL opcode.
+		// scripts are priced when they are decoded, so configure a table before loading scripts with it
+		// and don't modify it while engines use it. CHECKMULTISIG costs its opcode cost per pubkey
+		class GasCostTable
+		{
+		private:
+			int64_t _opcode_costs[256];
+			std::vector<int64_t> _service_costs; // indexed by service id, -1 means the default service cost
+			int64_t _default_service_cost;
+			uint64_t _version;
+
+		public:
+			explicit GasCostTable(int64_t opcode_cost = 1, int64_t service_cost = 0);
+
+			// every opcode costs 1, services cost nothing on top of it
+			static const GasCostTable *default_table();
+
+			inline int64_t opcode_cost(OpCode opcode) const
+			{
+				return _opcode_costs[(VMByte)opcode];
+			}
+
+			void set_opcode_cost(OpCode opcode, int64_t cost);
+
+			int64_t service_cost(uint32_t service_id) const;
+
+			void set_service_cost(const std::string &method, int64_t cost);
+
+			void set_default_service_cost(int64_t cost);
+
+			// unique among all tables and changed by every modification, decoded scripts remember the version they were priced with
+			inline uint64_t version() const { return _version; }
+		};
+	}
+}
+
+#endif
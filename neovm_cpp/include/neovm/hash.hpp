@@ -0,0 +1,36 @@
+#ifndef NEOVM_HASH_HPP
+#define NEOVM_HASH_HPP
+
+#include <neovm/config.hpp>
+#include <stddef.h>
+
+namespace neo
+{
+	namespace vm
+	{
+#define NEOVM_SHA1_SIZE 20
+#define NEOVM_SHA256_SIZE 32
+#define NEOVM_RIPEMD160_SIZE 20
+#define NEOVM_HASH160_SIZE 20
+#define NEOVM_HASH256_SIZE 32
+
+		// the digest of size bytes of data is written to out, which must have room for it
+
+		void sha1(const char *data, size_t size, char *out);
+
+		void sha256(const char *data, size_t size, char *out);
+
+		void ripemd160(const char *data, size_t size, char *out);
+
+		// RIPEMD160(SHA256(data)), the NEO script hash
+		void hash160(const char *data, size_t size, char *out);
+
+		// SHA256(SHA256(data))
+		void hash256(const char *data, size_t size, char *out);
+
+		// whether sha1 and sha256 run on the x86 SHA extensions
+		bool sha_extensions_enabled();
+	}
+}
+
+#endif
@@ -16,18 +16,40 @@ namespace neo
 	namespace vm
 	{
 
+		// non-owning view of bytes inside a buffer that outlives it
+		struct ByteSpan
+		{
+			const char *data;
+			size_t size;
+
+			inline const char *begin() const { return data; }
+			inline const char *end() const { return data + size; }
+			inline std::vector<char> to_vector() const { return std::vector<char>(data, data + size); }
+		};
+
+		// reads little endian values straight from a buffer it doesn't own, so the buffer must outlive the reader
 		class BinaryReader
 		{
 		private:
-			std::vector<char> _data;
+			const char *_data;
+			size_t _size;
 			size_t _position;
 		public:
 			static const size_t BEGIN = 0;
 
-			BinaryReader(std::vector<char> data);
+			BinaryReader(const char *data, size_t size);
+
+			BinaryReader(const std::vector<char> &data);
+
+			BinaryReader(std::vector<char> &&data) = delete;
 
 			size_t position();
 
+			size_t size() const;
+
+			// next size bytes of the buffer, without copying them
+			ByteSpan ReadSpan(size_t size);
+
 			std::vector<char> ReadBytes(size_t size);
 
 			std::vector<VMByte> ReadUBytes(size_t size);
@@ -50,6 +72,8 @@ namespace neo
 
 			void Seek(int offset, int begin);
 
+		private:
+			const VMByte *take(size_t size);
 		};
 
 		class Helper
@@ -61,6 +85,8 @@ namespace neo
 
 			static std::string bytes_to_string(std::vector<char> bytes);
 
+			static std::string bytes_to_string(const char *data, size_t size);
+
 			static std::vector<char> string_content_to_chars(std::string str);
 
 			static std::vector<VMByte> string_content_to_bytes(std::string str);
@@ -86,8 +112,8 @@ namespace neo
 				return true;
 			}
 
-			template <typename T>
-			static bool sequence_equal(std::vector<T> &a, std::vector<T> &b)
+			template <typename T, typename A>
+			static bool sequence_equal(std::vector<T, A> &a, std::vector<T, A> &b)
 			{
 				if (a.size() != b.size())
 					return false;
@@ -107,9 +133,15 @@ namespace neo
 
 			static bool enum_has_flag(int enum_value, int flag);
 
-			static std::vector<char> big_integer_to_chars(VMBigInteger num);
+			// FNV-1a hash of bytes
+			static size_t hash_bytes(const char *data, size_t size);
 
-			static std::vector<VMByte> big_integer_to_bytes(VMBigInteger num);
+			// hash of a 64-bit integer, consecutive integers spread over all bits
+			static size_t hash_int64(int64_t value);
+
+			static std::vector<char> big_integer_to_chars(const VMBigInteger &num);
+
+			static std::vector<VMByte> big_integer_to_bytes(const VMBigInteger &num);
 
 			static std::vector<VMByte> int16_to_bytes(int16_t num);
 
@@ -151,9 +183,7 @@ namespace neo
 			{
 				if (col.size() < 1)
 					throw NeoVmException("pop from empty collection error");
-				auto item = col.peek();
-				col.pop();
-				return item;
+				return col.pop();
 			}
 			
 			template <typename T>
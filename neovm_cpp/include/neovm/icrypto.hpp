@@ -1,11 +1,20 @@
 #ifndef NEOVM_ICRYPTO_HPP
 #define NEOVM_ICRYPTO_HPP
 #include <vector>
+#include <stddef.h>
 
 namespace neo
 {
 	namespace vm
 	{
+		// one (message, signature, pubkey) triple of a batch, the bytes are owned by the caller
+		struct SignatureCheck
+		{
+			const std::vector<char> *message;
+			const std::vector<char> *signature;
+			const std::vector<char> *pubkey;
+		};
+
 		class ICrypto
 		{
 		public:
@@ -13,7 +22,16 @@ namespace neo
 
 			virtual std::vector<char> Hash256(std::vector<char> message) = 0;
 
+			// false for a malformed signature or pubkey instead of throwing
 			virtual bool VerifySignature(std::vector<char> message, std::vector<char> signature, std::vector<char> pubkey) = 0;
+
+			// verifies every check and writes results[i] for checks[i], results has room for checks.size() values.
+			// checks are independent, implementations may verify them in any order or concurrently
+			virtual void VerifySignatures(const std::vector<SignatureCheck> &checks, bool *results)
+			{
+				for (size_t i = 0; i < checks.size(); i++)
+					results[i] = VerifySignature(*checks[i].message, *checks[i].signature, *checks[i].pubkey);
+			}
 		};
 	}
 }
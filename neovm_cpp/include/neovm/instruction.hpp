@@ -0,0 +1,100 @@
+#ifndef NEOVM_INSTRUCTION_HPP
+#define NEOVM_INSTRUCTION_HPP
+
+#include <neovm/config.hpp>
+#include <neovm/op_code.hpp>
+#include <neovm/gas_cost_table.hpp>
+#include <vector>
+#include <stdint.h>
+
+namespace neo
+{
+	namespace vm
+	{
+		class BinaryReader;
+
+		// every handler of the interpreter loop, one per group of opcodes sharing the same semantics
+#define NEOVM_INSTRUCTION_HANDLERS(H) \
+	H(PUSHBYTES) H(PUSH0) H(PUSHINT) \
+	H(NOP) H(JMP) H(JMPIF) H(JMPIFNOT) H(CALL) H(RET) H(APPCALL) H(TAILCALL) H(SYSCALL) \
+	H(DUPFROMALTSTACK) H(TOALTSTACK) H(FROMALTSTACK) H(XDROP) H(XSWAP) H(XTUCK) H(DEPTH) H(DROP) H(DUP) \
+	H(NIP) H(OVER) H(PICK) H(ROLL) H(ROT) H(SWAP) H(TUCK) \
+	H(CAT) H(SUBSTR) H(LEFT) H(RIGHT) H(SIZE) \
+	H(INVERT) H(AND) H(OR) H(XOR) H(EQUAL) \
+	H(INC) H(DEC) H(SIGN) H(NEGATE) H(ABS) H(NOT) H(NZ) H(ADD) H(SUB) H(MUL) H(DIV) H(MOD) H(SHL) H(SHR) \
+	H(BOOLAND) H(BOOLOR) H(NUMEQUAL) H(NUMNOTEQUAL) H(LT) H(GT) H(LTE) H(GTE) H(MIN) H(MAX) H(WITHIN) \
+	H(SHA1) H(SHA256) H(HASH160) H(HASH256) H(CHECKSIG) H(CHECKMULTISIG) \
+	H(ARRAYSIZE) H(PACK) H(UNPACK) H(PICKITEM) H(SETITEM) H(NEWARRAY) H(NEWSTRUCT) \
+	H(NEWMAP) H(REMOVE) H(HASKEY) H(KEYS) H(VALUES) \
+	H(THROW) H(THROWIFNOT) \
+	H(UNKNOWN) H(BADOPERAND)
+
+		enum InstructionHandler
+		{
+#define NEOVM_INSTRUCTION_HANDLER_ENUM(name) IH_##name,
+			NEOVM_INSTRUCTION_HANDLERS(NEOVM_INSTRUCTION_HANDLER_ENUM)
+#undef NEOVM_INSTRUCTION_HANDLER_ENUM
+			IH_COUNT
+		};
+
+		InstructionHandler instruction_handler_of(OpCode opcode);
+
+		// how many items the handler pops from the evaluation stack at least, checked before it runs
+		uint8_t instruction_stack_inputs(InstructionHandler handler);
+
+		// one instruction of a script, decoded once when the script is loaded
+		struct Instruction
+		{
+			uint16_t handler; // InstructionHandler
+			VMByte opcode;
+			uint8_t stack_inputs; // see instruction_stack_inputs
+			uint32_t offset; // position of the opcode byte in the script
+			uint32_t next; // index of the instruction executed after this one when not jumping
+			int32_t target; // index of the JMP/CALL target instruction, -1 if the target is out of the script
+			int64_t value; // constant of PUSHM1, PUSH1-PUSH16
+			uint32_t data_offset; // operand bytes of PUSHBYTES/PUSHDATA, APPCALL script id, SYSCALL name
+			uint32_t data_size;
+			uint32_t service_id; // SYSCALL: id of the interned service name, NEOVM_UNKNOWN_SERVICE_ID if it wasn't registered at decode time
+			int64_t block_gas; // gas of the basic block starting at this instruction, charged when it is entered. 0 inside blocks
+		};
+
+		class DecodedScript
+		{
+		private:
+			std::vector<char> _script;
+			std::vector<Instruction> _instructions;
+			std::vector<int32_t> _index_of_offset; // instruction index of every script offset, -1 if no instruction starts there
+			uint64_t _gas_table_version;
+		public:
+			// gas_costs prices the basic blocks, the default table if nullptr
+			DecodedScript(std::vector<char> script, bool neo_mode, const GasCostTable *gas_costs = nullptr);
+
+			const std::vector<char> &script() const;
+
+			const Instruction *instructions() const;
+
+			size_t instructions_count() const;
+
+			// version of the gas cost table the blocks were priced with
+			inline uint64_t gas_table_version() const { return _gas_table_version; }
+
+			// approximate bytes of memory held by the decoded script
+			size_t memory_size() const;
+
+			// index of the instruction starting at offset, -1 if offset is not an instruction boundary
+			int32_t index_of(size_t offset) const;
+
+			inline const char *data(const Instruction &instruction) const
+			{
+				return _script.data() + instruction.data_offset;
+			}
+
+		private:
+			void price_blocks(const GasCostTable *gas_costs);
+
+			uint32_t decode_one(BinaryReader *reader, uint32_t offset, bool neo_mode, int64_t *jump_offset, uint32_t *next_offset);
+		};
+	}
+}
+
+#endif
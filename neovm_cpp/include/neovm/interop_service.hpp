@@ -5,6 +5,7 @@
 #include <map>
 #include <string>
 #include <functional>
+#include <stdint.h>
 #include <neovm/stack_item.hpp>
 
 namespace neo
@@ -13,20 +14,44 @@ namespace neo
 	{
 		class ExecutionEngine;
 
+#define NEOVM_UNKNOWN_SERVICE_ID 0xFFFFFFFFu
+
+		// dense process-wide id of a service name, the same in every InteropService and decoded script.
+		// names are interned when a service is registered
+		uint32_t intern_service_name(const std::string &method);
+
+		// id of a name interned before, NEOVM_UNKNOWN_SERVICE_ID otherwise
+		uint32_t find_service_id(const std::string &method);
+
+		// invoking is thread safe while no services are registered or cleared, freeze() makes sure none are
 		class InteropService
 		{
 		private:
-			std::map<std::string, std::function<bool(ExecutionEngine*)>> _dictionary;
+			std::vector<std::function<bool(ExecutionEngine*)>> _handlers; // indexed by service id
+			bool _frozen;
 
 		public:
 			InteropService();
 
+			// throws NeoVmException once frozen
 			void register_service(std::string method, std::function<bool(ExecutionEngine*)> handler);
 
 			void clear_services();
 
+			// no more changes, so engines on several threads can share the service
+			void freeze();
+			bool is_frozen() const;
+
 			bool invoke(std::string method, ExecutionEngine *engine);
 
+			// false when no handler is registered for service_id
+			inline bool invoke(uint32_t service_id, ExecutionEngine *engine)
+			{
+				if (service_id >= _handlers.size() || !_handlers[service_id])
+					return false;
+				return _handlers[service_id](engine);
+			}
+
 		private:
 			static bool GetScriptContainer(ExecutionEngine *engine);
 
@@ -40,6 +65,27 @@ namespace neo
 			
 			static bool GetGlobalVariable(ExecutionEngine *engine);
 
+			// json text of the top item
+			static bool JsonDumps(ExecutionEngine *engine);
+
+			// stack item parsed from a json string
+			static bool JsonLoads(ExecutionEngine *engine);
+
+			// NEO binary form of the top item, see serialize_stack_item
+			static bool Serialize(ExecutionEngine *engine);
+
+			static bool Deserialize(ExecutionEngine *engine);
+
+			// storage of the engine, see ExecutionEngine::set_storage. the context is the script id of the contract,
+			// a contract can read the storage of any context but only write its own
+			static bool StorageGetContext(ExecutionEngine *engine);
+
+			static bool StorageGet(ExecutionEngine *engine);
+
+			static bool StoragePut(ExecutionEngine *engine);
+
+			static bool StorageDelete(ExecutionEngine *engine);
+
 		};
 	}
 }
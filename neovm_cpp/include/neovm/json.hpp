@@ -0,0 +1,54 @@
+#ifndef NEOVM_JSON_HPP
+#define NEOVM_JSON_HPP
+
+#include <neovm/config.hpp>
+#include <neovm/big_integer.hpp>
+#include <string>
+#include <unordered_set>
+
+namespace neo
+{
+	namespace vm
+	{
+		class StackItem;
+		class StackValue;
+		class ExecutionEngine;
+
+		// writes stack items as json in one pass into a buffer that keeps its capacity between uses
+		class JsonWriter
+		{
+		private:
+			std::string _buffer;
+			std::unordered_set<const StackItem*> _path; // arrays and maps being written, one seen again is a circular reference
+		public:
+			// empties the buffer but keeps its memory
+			inline void clear() { _buffer.clear(); _path.clear(); }
+
+			inline const std::string &str() const { return _buffer; }
+
+			void write(const StackValue &value);
+
+			inline void write_raw(char c) { _buffer.push_back(c); }
+
+			inline void write_raw(const char *data, size_t size) { _buffer.append(data, size); }
+
+			// a quoted and escaped json string
+			void write_string(const char *data, size_t size);
+
+			void write_integer(const VMBigInteger &value);
+
+			void write_bool(bool value);
+
+			// brackets the elements of an array or map, throws on circular references and too deep nesting
+			void enter(const StackItem *container);
+
+			inline void leave(const StackItem *container) { _path.erase(container); }
+		};
+
+		// parses json into stack items owned by engine. objects become maps with byte array keys,
+		// numbers must be integers and null becomes false like other nil values of the vm
+		StackItem *json_loads(ExecutionEngine *engine, const char *data, size_t size);
+	}
+}
+
+#endif
@@ -0,0 +1,139 @@
+#ifndef NEOVM_MEMORY_RESOURCE_HPP
+#define NEOVM_MEMORY_RESOURCE_HPP
+
+#include <neovm/config.hpp>
+#include <stddef.h>
+#include <limits>
+#include <unordered_set>
+#include <vector>
+
+namespace neo
+{
+	namespace vm
+	{
+		// source of the memory of stack items and their buffers, modeled after std::pmr::memory_resource
+		class MemoryResource
+		{
+		public:
+			inline virtual ~MemoryResource() {}
+
+			// every block is aligned to NEOVM_MEMORY_ALIGNMENT
+			virtual void *allocate(size_t bytes) = 0;
+
+			virtual void deallocate(void *p, size_t bytes) = 0;
+
+			// true when all memory handed out is reclaimed at once by reset(),
+			// so the owner of the allocated objects may drop them without running their destructors
+			inline virtual bool is_arena() const { return false; }
+
+			inline virtual void reset() {}
+		};
+
+		// the global heap
+		MemoryResource *new_delete_resource();
+
+		// bump allocator over large chunks.
+		// freed small blocks are kept in per size class free lists and reused, blocks larger than
+		// NEOVM_ARENA_MAX_SMALL_BLOCK come from the global heap. reset() rewinds to the first chunk
+		// and keeps the chunks for the next execution
+		class ArenaResource : public MemoryResource
+		{
+		private:
+			struct FreeBlock
+			{
+				FreeBlock *next;
+			};
+
+			size_t _chunk_size;
+			std::vector<char*> _chunks;
+			size_t _current_chunk;
+			char *_cursor;
+			char *_end;
+			FreeBlock *_free_lists[NEOVM_ARENA_MAX_SMALL_BLOCK / NEOVM_MEMORY_ALIGNMENT];
+			std::unordered_set<void*> _large_blocks;
+
+		public:
+			explicit ArenaResource(size_t chunk_size = NEOVM_ARENA_CHUNK_SIZE);
+			virtual ~ArenaResource();
+
+			virtual void *allocate(size_t bytes);
+
+			virtual void deallocate(void *p, size_t bytes);
+
+			inline virtual bool is_arena() const { return true; }
+
+			virtual void reset();
+
+			// bytes of chunks reserved from the global heap, large blocks not included
+			size_t reserved_size() const;
+
+			ArenaResource(const ArenaResource&) = delete;
+			ArenaResource &operator=(const ArenaResource&) = delete;
+
+		private:
+			void *allocate_from_chunks(size_t bytes);
+		};
+
+		// std allocator over a MemoryResource, for the containers owned by stack items
+		template <typename T>
+		class Allocator
+		{
+		public:
+			typedef T value_type;
+			typedef T *pointer;
+			typedef const T *const_pointer;
+			typedef T &reference;
+			typedef const T &const_reference;
+			typedef size_t size_type;
+			typedef ptrdiff_t difference_type;
+
+			template <typename U>
+			struct rebind
+			{
+				typedef Allocator<U> other;
+			};
+
+			inline Allocator(MemoryResource *resource = new_delete_resource()) : _resource(resource) {}
+
+			template <typename U>
+			inline Allocator(const Allocator<U> &other) : _resource(other.resource()) {}
+
+			inline T *allocate(size_t n)
+			{
+				return (T*)_resource->allocate(n * sizeof(T));
+			}
+
+			inline void deallocate(T *p, size_t n)
+			{
+				_resource->deallocate(p, n * sizeof(T));
+			}
+
+			inline size_t max_size() const
+			{
+				return (std::numeric_limits<size_t>::max)() / sizeof(T);
+			}
+
+			inline MemoryResource *resource() const
+			{
+				return _resource;
+			}
+
+			template <typename U>
+			inline bool operator==(const Allocator<U> &other) const
+			{
+				return _resource == other.resource();
+			}
+
+			template <typename U>
+			inline bool operator!=(const Allocator<U> &other) const
+			{
+				return _resource != other.resource();
+			}
+
+		private:
+			MemoryResource *_resource;
+		};
+	}
+}
+
+#endif
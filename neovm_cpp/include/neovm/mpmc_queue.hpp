@@ -0,0 +1,109 @@
+#ifndef NEOVM_MPMC_QUEUE_HPP
+#define NEOVM_MPMC_QUEUE_HPP
+
+#include <neovm/config.hpp>
+#include <atomic>
+#include <memory>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace neo
+{
+	namespace vm
+	{
+		// bounded lock-free multi-producer multi-consumer queue (Vyukov). every cell has a sequence number telling
+		// whether it is free for the push of that lap or holds the value for the pop of that lap
+		template <class T>
+		class MpmcQueue
+		{
+		private:
+			struct Cell
+			{
+				std::atomic<size_t> sequence;
+				T value;
+			};
+
+			std::unique_ptr<Cell[]> _cells;
+			size_t _mask;
+			// producers and consumers on separate cache lines
+			alignas(64) std::atomic<size_t> _enqueue_position;
+			alignas(64) std::atomic<size_t> _dequeue_position;
+
+		public:
+			// capacity is rounded up to a power of 2
+			explicit MpmcQueue(size_t capacity)
+			{
+				size_t size = 2;
+				while (size < capacity)
+					size <<= 1;
+				_cells.reset(new Cell[size]);
+				_mask = size - 1;
+				for (size_t i = 0; i < size; i++)
+					_cells[i].sequence.store(i, std::memory_order_relaxed);
+				_enqueue_position.store(0, std::memory_order_relaxed);
+				_dequeue_position.store(0, std::memory_order_relaxed);
+			}
+
+			size_t capacity() const
+			{
+				return _mask + 1;
+			}
+
+			// false when the queue is full, value is not moved from then
+			bool try_push(T &value)
+			{
+				Cell *cell;
+				size_t position = _enqueue_position.load(std::memory_order_relaxed);
+				for (;;)
+				{
+					cell = &_cells[position & _mask];
+					size_t sequence = cell->sequence.load(std::memory_order_acquire);
+					intptr_t diff = (intptr_t)sequence - (intptr_t)position;
+					if (diff == 0)
+					{
+						if (_enqueue_position.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+							break;
+					}
+					else if (diff < 0)
+						return false;
+					else
+						position = _enqueue_position.load(std::memory_order_relaxed);
+				}
+				cell->value = std::move(value);
+				cell->sequence.store(position + 1, std::memory_order_release);
+				return true;
+			}
+
+			// false when the queue is empty
+			bool try_pop(T *value)
+			{
+				Cell *cell;
+				size_t position = _dequeue_position.load(std::memory_order_relaxed);
+				for (;;)
+				{
+					cell = &_cells[position & _mask];
+					size_t sequence = cell->sequence.load(std::memory_order_acquire);
+					intptr_t diff = (intptr_t)sequence - (intptr_t)(position + 1);
+					if (diff == 0)
+					{
+						if (_dequeue_position.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+							break;
+					}
+					else if (diff < 0)
+						return false;
+					else
+						position = _dequeue_position.load(std::memory_order_relaxed);
+				}
+				*value = std::move(cell->value);
+				cell->value = T();
+				cell->sequence.store(position + _mask + 1, std::memory_order_release);
+				return true;
+			}
+
+			MpmcQueue(const MpmcQueue&) = delete;
+			MpmcQueue &operator=(const MpmcQueue&) = delete;
+		};
+	}
+}
+
+#endif
@@ -134,6 +134,11 @@ namespace neo
 				OP_SETITEM = 0xC4,
 				OP_NEWARRAY = 0xC5, //
 				OP_NEWSTRUCT = 0xC6, //ֵ
+				OP_NEWMAP = 0xC7,
+				OP_REMOVE = 0xCA,
+				OP_HASKEY = 0xCB,
+				OP_KEYS = 0xCC,
+				OP_VALUES = 0xCD,
 
 			// Exceptions
 				OP_THROW = 0xF0,
@@ -0,0 +1,34 @@
+#ifndef NEOVM_PARALLEL_CRYPTO_HPP
+#define NEOVM_PARALLEL_CRYPTO_HPP
+
+#include <neovm/config.hpp>
+#include <neovm/icrypto.hpp>
+#include <neovm/thread_pool.hpp>
+
+namespace neo
+{
+	namespace vm
+	{
+		// forwards to another ICrypto and spreads the checks of VerifySignatures over a thread pool.
+		// the VerifySignature of the wrapped crypto must be thread safe
+		class ParallelCrypto : public ICrypto
+		{
+		private:
+			ICrypto *_crypto;
+			ThreadPool *_pool;
+			size_t _min_parallel_checks; // smaller batches are verified on the calling thread
+		public:
+			ParallelCrypto(ICrypto *crypto, ThreadPool *pool, size_t min_parallel_checks = NEOVM_MIN_PARALLEL_SIGNATURE_CHECKS);
+
+			virtual std::vector<char> Hash160(std::vector<char> message);
+
+			virtual std::vector<char> Hash256(std::vector<char> message);
+
+			virtual bool VerifySignature(std::vector<char> message, std::vector<char> signature, std::vector<char> pubkey);
+
+			virtual void VerifySignatures(const std::vector<SignatureCheck> &checks, bool *results);
+		};
+	}
+}
+
+#endif
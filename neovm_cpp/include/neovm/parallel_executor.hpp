@@ -0,0 +1,44 @@
+#ifndef NEOVM_PARALLEL_EXECUTOR_HPP
+#define NEOVM_PARALLEL_EXECUTOR_HPP
+
+#include <neovm/config.hpp>
+#include <neovm/engine_pool.hpp>
+#include <neovm/storage.hpp>
+#include <vector>
+
+namespace neo
+{
+	namespace vm
+	{
+		struct BlockTransaction
+		{
+			std::vector<char> script;
+			std::vector<char> script_id;
+			IScriptContainer *container;
+			int64_t gas_limit; // no limit when negative
+		};
+
+		// executes the transactions of a block speculatively in parallel with the same outcome as executing them one
+		// after another in block order. every transaction runs against the storage at the start of the block, recording
+		// the keys it reads and buffering its writes. they are then validated in block order as they finish: a transaction
+		// that read a key written by an earlier one runs again on top of the committed writes on the calling thread, all others commit
+		// without running twice, so transactions touching disjoint keys cost one parallel execution each
+		class ParallelBlockExecutor
+		{
+		private:
+			EnginePool *_pool;
+			size_t _executions;
+		public:
+			explicit ParallelBlockExecutor(EnginePool *pool);
+
+			// results in block order. storage is only read while the transactions run, then the writes of the
+			// transactions that didn't fault are applied to it
+			std::vector<EngineJobResult> execute(const std::vector<BlockTransaction> &transactions, IStorage *storage);
+
+			// of the last block, executions() minus the number of transactions is the number of conflicts
+			size_t executions() const;
+		};
+	}
+}
+
+#endif
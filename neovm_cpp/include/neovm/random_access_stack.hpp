@@ -1,59 +1,87 @@
 #ifndef NEOVM_RANDOM_ACCESS_STACK_HPP
 #define NEOVM_RANDOM_ACCESS_STACK_HPP
 
+#include <neovm/config.hpp>
+#include <neovm/exceptions.hpp>
 #include <vector>
-#include <list>
 
 namespace neo
 {
 	namespace vm
 	{
+		// stack stored bottom-to-top in one contiguous buffer, indexes count from the top.
+		// the buffer is reserved up front and never shrinks, so pushing and popping don't reallocate in steady state
 		template <typename T>
 		class RandomAccessStack
 		{
 		private:
 			std::vector<T> list;
+			size_t _max_size;
 
 		public:
+			RandomAccessStack(size_t capacity = NEOVM_STACK_INITIAL_CAPACITY, size_t max_size = NEOVM_MAX_STACK_SIZE)
+				: _max_size(max_size)
+			{
+				reserve(capacity);
+			}
+
 			size_t size() const {
 				return list.size();
 			}
 
+			size_t capacity() const {
+				return list.capacity();
+			}
+
+			size_t max_size() const {
+				return _max_size;
+			}
+
+			void reserve(size_t capacity)
+			{
+				list.reserve(capacity < _max_size ? capacity : _max_size);
+			}
+
+			void set_max_size(size_t max_size)
+			{
+				_max_size = max_size;
+			}
+
 			void clear()
 			{
 				list.clear();
 			}
 
+			// after inserting, peek(index) is value
 			void insert(size_t index, T value)
 			{
 				if(index > list.size())
 					throw NeoVmException("too large position to insert");
-				list.push_back(value);
-				if (index == list.size() - 1)
-					return;
-				auto index_in_list = list.size() - index - 1;
-				for (size_t i = list.size() - 1; i >= index_in_list + 1; i--)
-				{
-					list[i] = list[i - 1];
-				}
-				list[index_in_list] = value;
+				if (list.size() >= _max_size)
+					throw NeoVmException("stack overflow");
+				list.insert(list.end() - index, value);
 			}
 
 			T peek(size_t index = 0) const
 			{
 				if (index >= list.size())
 					throw NeoVmException("index out of range");
-				auto index_in_list = list.size() - 1 - index;
-				return list[index_in_list];
+				return list[list.size() - 1 - index];
 			}
 
 			T pop()
 			{
-				return remove(0);
+				if (list.empty())
+					throw NeoVmException("index out of range");
+				T item = list.back();
+				list.pop_back();
+				return item;
 			}
 
 			void push(T item)
 			{
+				if (list.size() >= _max_size)
+					throw NeoVmException("stack overflow");
 				list.push_back(item);
 			}
 
@@ -64,24 +92,11 @@ namespace neo
 
 			T remove(size_t index)
 			{
-				if (index >= list.size() || index < 0)
+				if (index >= list.size())
 					throw NeoVmException("index out of range");
-				auto index_in_list = list.size() - index - 1;
-				auto item = list[index_in_list];
-				// list.remove(item); // TODO: change to remove at index
-				std::vector<T> result;
-				for (size_t i = 0; i < index_in_list; i++)
-				{
-					result.push_back(list[i]);
-				}
-				if (index_in_list + 1 < list.size())
-				{
-					for (size_t i = index_in_list + 1; i < list.size(); i++)
-					{
-						result.push_back(list[i]);
-					}
-				}
-				list = result;
+				auto position = list.end() - 1 - index;
+				T item = *position;
+				list.erase(position);
 				return item;
 			}
 
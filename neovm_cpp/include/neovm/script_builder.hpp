@@ -28,7 +28,7 @@ namespace neo
 
 			ScriptBuilder *emit_jump(OpCode op, int16_t offset);
 
-			ScriptBuilder *emit_push(VMBigInteger number);
+			ScriptBuilder *emit_push(const VMBigInteger &number);
 
 			ScriptBuilder *emit_push(bool data);
 
@@ -0,0 +1,89 @@
+#ifndef NEOVM_SCRIPT_CACHE_HPP
+#define NEOVM_SCRIPT_CACHE_HPP
+
+#include <neovm/config.hpp>
+#include <neovm/instruction.hpp>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include <stdint.h>
+
+namespace neo
+{
+	namespace vm
+	{
+		// fixed-size cache key of a script id.
+		// 20 byte ids (NEO script hashes) are used as is, other ids are hashed, so the cache also keeps the full id to detect collisions
+		struct ScriptHash
+		{
+			uint8_t bytes[NEOVM_SCRIPT_HASH_SIZE];
+
+			static ScriptHash of_script_id(const char *script_id, size_t size);
+
+			bool operator==(const ScriptHash &other) const;
+		};
+
+		struct ScriptHashHasher
+		{
+			size_t operator()(const ScriptHash &hash) const;
+		};
+
+		// decoded scripts shared by all engines using the cache, least recently used ones are evicted
+		// when the decoded scripts exceed the byte budget. thread safe.
+		// hosts must erase a script id when the script behind it changes
+		class ScriptCache
+		{
+		private:
+			struct Entry
+			{
+				ScriptHash hash;
+				std::vector<char> script_id;
+				bool neo_mode;
+				std::shared_ptr<DecodedScript> script;
+				size_t size;
+			};
+
+			typedef std::list<Entry> EntryList;
+
+			mutable std::mutex _mutex;
+			EntryList _entries; // most recently used first
+			std::unordered_map<ScriptHash, EntryList::iterator, ScriptHashHasher> _index;
+			size_t _max_size;
+			size_t _size;
+			uint64_t _hits;
+			uint64_t _misses;
+
+		public:
+			explicit ScriptCache(size_t max_size = NEOVM_SCRIPT_CACHE_DEFAULT_SIZE);
+
+			// the cached decoded script, nullptr if the id is not cached or was decoded in another mode or with another gas table
+			std::shared_ptr<DecodedScript> find(const char *script_id, size_t size, bool neo_mode, uint64_t gas_table_version);
+
+			// caches script under the id, replacing any older entry, and evicts until the cache fits its budget.
+			// a script larger than the whole budget is not cached
+			void insert(const char *script_id, size_t size, bool neo_mode, std::shared_ptr<DecodedScript> script);
+
+			void erase(const char *script_id, size_t size);
+
+			void clear();
+
+			size_t size() const;
+			size_t max_size() const;
+			void set_max_size(size_t max_size);
+			size_t entries_count() const;
+			uint64_t hits() const;
+			uint64_t misses() const;
+
+			ScriptCache(const ScriptCache&) = delete;
+			ScriptCache &operator=(const ScriptCache&) = delete;
+
+		private:
+			void erase_entry(EntryList::iterator entry);
+			void evict();
+		};
+	}
+}
+
+#endif
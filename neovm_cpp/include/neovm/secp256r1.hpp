@@ -0,0 +1,74 @@
+#ifndef NEOVM_SECP256R1_HPP
+#define NEOVM_SECP256R1_HPP
+
+#include <neovm/config.hpp>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace neo
+{
+	namespace vm
+	{
+		// affine point, coordinates are 4 little-endian 64 bit limbs in Montgomery form
+		struct Secp256r1AffinePoint
+		{
+			uint64_t x[4];
+			uint64_t y[4];
+		};
+
+		// a decoded secp256r1 (NIST P-256) public key with its odd multiples P, 3P, 5P... precomputed for w-NAF.
+		// a wider window costs more to prepare and makes every verification with the key faster
+		class Secp256r1PublicKey
+		{
+		private:
+			int _window;
+			Secp256r1AffinePoint _table[1 << (NEOVM_SECP256R1_CACHED_KEY_WINDOW - 2)];
+
+			Secp256r1PublicKey() {}
+		public:
+			// compressed (33 bytes), uncompressed (65 bytes) or raw x and y (64 bytes) like NEO.
+			// nullptr when the bytes are not a point on the curve
+			static std::shared_ptr<Secp256r1PublicKey> decode(const char *data, size_t size, int window = NEOVM_SECP256R1_KEY_WINDOW);
+
+			inline int window() const { return _window; }
+			// (2 * i + 1) times the key
+			inline const Secp256r1AffinePoint &odd_multiple(size_t i) const { return _table[i]; }
+		};
+
+		// ECDSA verification of a 32 byte message hash with a 64 byte r || s signature, both big-endian.
+		// the inputs are public, so this is not constant time
+		bool secp256r1_verify(const char *hash, const char *signature, size_t signature_size, const Secp256r1PublicKey &key);
+
+		// decodes the key for this one verification
+		bool secp256r1_verify(const char *hash, const char *signature, size_t signature_size, const char *pubkey, size_t pubkey_size);
+
+		// keys decoded with the wide window, least recently used ones are evicted when there are more than max_entries. thread safe
+		class Secp256r1KeyCache
+		{
+		private:
+			typedef std::list<std::pair<std::string, std::shared_ptr<Secp256r1PublicKey>>> EntryList;
+
+			std::mutex _mutex;
+			EntryList _entries; // most recently used first
+			std::unordered_map<std::string, EntryList::iterator> _index;
+			size_t _max_entries;
+		public:
+			explicit Secp256r1KeyCache(size_t max_entries = NEOVM_SECP256R1_KEY_CACHE_SIZE);
+
+			// nullptr for an invalid key, which is not cached
+			std::shared_ptr<Secp256r1PublicKey> get(const char *pubkey, size_t size);
+
+			size_t size();
+
+			Secp256r1KeyCache(const Secp256r1KeyCache&) = delete;
+			Secp256r1KeyCache &operator=(const Secp256r1KeyCache&) = delete;
+		};
+	}
+}
+
+#endif
@@ -0,0 +1,36 @@
+#ifndef NEOVM_SERIALIZATION_HPP
+#define NEOVM_SERIALIZATION_HPP
+
+#include <neovm/config.hpp>
+#include <vector>
+#include <stddef.h>
+
+namespace neo
+{
+	namespace vm
+	{
+		class StackItem;
+		class StackValue;
+		class ExecutionEngine;
+
+		// type byte of every serialized item, the same as NEO's Runtime.Serialize
+		enum SerializedItemType
+		{
+			SERIALIZED_BYTE_ARRAY = 0x00,
+			SERIALIZED_BOOLEAN = 0x01,
+			SERIALIZED_INTEGER = 0x02,
+			SERIALIZED_ARRAY = 0x80,
+			SERIALIZED_STRUCT = 0x81,
+			SERIALIZED_MAP = 0x82
+		};
+
+		// appends the binary form of value and everything it references to out. like NEO, throws NeoVmException when an array,
+		// struct or map is reached twice, whether it is shared or part of a cycle
+		void serialize_stack_item(const StackValue &value, std::vector<char> *out);
+
+		// reads one serialized item, the items are owned by engine. throws NeoVmException on malformed or trailing data
+		StackItem *deserialize_stack_item(ExecutionEngine *engine, const char *data, size_t size);
+	}
+}
+
+#endif
@@ -6,7 +6,9 @@
 #include <set>
 #include <memory>
 #include <neovm/config.hpp>
+#include <neovm/big_integer.hpp>
 #include <neovm/exceptions.hpp>
+#include <neovm/memory_resource.hpp>
 
 namespace neo
 {
@@ -14,6 +16,7 @@ namespace neo
 	{
 		class IInteropInterface;
 		class ExecutionEngine;
+		class JsonWriter;
 
 		enum StackItemType
 		{
@@ -29,12 +32,25 @@ namespace neo
 			SIT_INTEROP_INTERFACE = 10
 		};
 
+		class StackItem;
+
+		typedef std::vector<StackItem*, Allocator<StackItem*>> StackItemVector;
+
 		class StackItem
 		{
+			friend class GarbageCollector;
 		protected:
 			StackItemType _type;
+		private:
+			bool _gc_marked;
 		public:
+			inline StackItem() : _gc_marked(false) {}
 			inline virtual ~StackItem() {}
+
+			// stack items live in the memory resource of their engine, new (engine->memory_resource()) Integer(engine, 1)
+			static void *operator new(size_t size, MemoryResource *resource);
+			static void operator delete(void *p, MemoryResource *resource);
+			static void operator delete(void *p);
 			inline virtual bool IsArray() const { return false; }
 			inline virtual bool IsStruct() const { return false; }
 			inline virtual bool IsUserdata() const { return false; }
@@ -42,7 +58,7 @@ namespace neo
 
 			virtual bool Equals(StackItem *other) = 0;
 
-			inline virtual std::vector<StackItem*> *GetArray()
+			inline virtual StackItemVector *GetArray()
 			{
 				throw NeoVmException("not supported operation");
 			}
@@ -60,9 +76,21 @@ namespace neo
 
 			virtual std::string GetString() const;
 
-			virtual std::string to_json_string(std::set<void*> referenced_objects) const;
+			std::string to_json_string() const;
+
+			// appends the json of this item to writer
+			virtual void write_json(JsonWriter *writer) const;
 
 			virtual IInteropInterface *GetInterface();
+
+			// hash consistent with Equals, only for the primitive items usable as map keys
+			virtual size_t hash_code() const;
+
+			// appends the stack items directly referenced by this item, used by the garbage collector to trace reachable items
+			inline virtual void references(std::vector<StackItem*> *out) const {}
+
+			// approximate bytes of memory owned by this item
+			inline virtual size_t memory_size() const { return sizeof(StackItem); }
 			
 
 			static StackItem *to_stack_item(ExecutionEngine *engine, std::vector<char> bytes);
@@ -79,6 +107,8 @@ namespace neo
 
 			static StackItem *to_stack_userdata_item(ExecutionEngine *engine, void *userdata);
 
+			static StackItem *to_stack_map_item(ExecutionEngine *engine);
+
 		};
 
 		StackItem *GetStackItemFromInterface(ExecutionEngine *engine, IInteropInterface *value);
@@ -0,0 +1,135 @@
+#ifndef NEOVM_STACK_VALUE_HPP
+#define NEOVM_STACK_VALUE_HPP
+
+#include <neovm/config.hpp>
+#include <neovm/stack_item.hpp>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace neo
+{
+	namespace vm
+	{
+		class ExecutionEngine;
+
+		// one slot of the evaluation/alt stack.
+		// integers fitting in 64 bits and booleans are stored inline without a heap object,
+		// every other value is a StackItem owned by the engine.
+		// inline values are boxed into Integer/Boolean items only when a reference type or a host API needs a StackItem
+		class StackValue
+		{
+		private:
+			enum Tag
+			{
+				SV_ITEM = 0,
+				SV_INTEGER = 1,
+				SV_BOOLEAN = 2
+			};
+
+			union
+			{
+				StackItem *_item;
+				int64_t _integer;
+				bool _boolean;
+			};
+			Tag _tag;
+
+		public:
+			inline StackValue() : _item(nullptr), _tag(SV_ITEM) {}
+			inline StackValue(StackItem *item) : _item(item), _tag(SV_ITEM) {}
+
+			static inline StackValue from_integer(int64_t value)
+			{
+				StackValue result;
+				result._integer = value;
+				result._tag = SV_INTEGER;
+				return result;
+			}
+
+			// inline when the value fits in 64 bits, otherwise boxed into an Integer owned by engine
+			static inline StackValue from_integer(ExecutionEngine *engine, const VMBigInteger &value)
+			{
+				if (value.is_small())
+					return from_integer(value.small_value());
+				return box_integer(engine, value);
+			}
+
+			static inline StackValue from_bool(bool value)
+			{
+				StackValue result;
+				result._boolean = value;
+				result._tag = SV_BOOLEAN;
+				return result;
+			}
+
+			inline bool is_inline() const { return _tag != SV_ITEM; }
+
+			// the referenced item, nullptr for inline values
+			inline StackItem *item() const { return _tag == SV_ITEM ? _item : nullptr; }
+
+			inline StackItemType type() const
+			{
+				switch (_tag)
+				{
+				case SV_INTEGER: return StackItemType::SIT_INTEGER;
+				case SV_BOOLEAN: return StackItemType::SIT_BOOLEAN;
+				default: return _item->type();
+				}
+			}
+
+			inline bool IsArray() const { return _tag == SV_ITEM && _item->IsArray(); }
+			inline bool IsStruct() const { return _tag == SV_ITEM && _item->IsStruct(); }
+			inline bool IsUserdata() const { return _tag == SV_ITEM && _item->IsUserdata(); }
+			inline bool is_map() const { return _tag == SV_ITEM && _item->is_map(); }
+
+			inline VMBigInteger GetBigInteger() const
+			{
+				switch (_tag)
+				{
+				case SV_INTEGER: return VMBigInteger(_integer);
+				case SV_BOOLEAN: return VMBigInteger(_boolean ? 1 : 0);
+				default: return _item->GetBigInteger();
+				}
+			}
+
+			// the integer value, INT64_MIN or INT64_MAX when it doesn't fit in 64 bits
+			inline int64_t GetInt64() const
+			{
+				switch (_tag)
+				{
+				case SV_INTEGER: return _integer;
+				case SV_BOOLEAN: return _boolean ? 1 : 0;
+				default: return _item->GetBigInteger().to_int64();
+				}
+			}
+
+			inline bool GetBoolean() const
+			{
+				switch (_tag)
+				{
+				case SV_INTEGER: return _integer != 0;
+				case SV_BOOLEAN: return _boolean;
+				default: return _item->GetBoolean();
+				}
+			}
+
+			std::vector<char> GetByteArray() const;
+
+			std::string GetString() const;
+
+			bool Equals(const StackValue &other) const;
+
+			// same hash as the boxed item, see StackItem::hash_code
+			size_t hash_code() const;
+
+			// the value as a heap item, boxing inline values into a new Integer/Boolean owned by engine
+			StackItem *to_stack_item(ExecutionEngine *engine) const;
+
+		private:
+			static StackValue box_integer(ExecutionEngine *engine, const VMBigInteger &value);
+		};
+	}
+}
+
+#endif
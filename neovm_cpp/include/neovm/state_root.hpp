@@ -0,0 +1,57 @@
+#ifndef NEOVM_STATE_ROOT_HPP
+#define NEOVM_STATE_ROOT_HPP
+
+#include <neovm/config.hpp>
+#include <neovm/storage.hpp>
+#include <neovm/thread_pool.hpp>
+#include <string>
+#include <stdint.h>
+
+namespace neo
+{
+	namespace vm
+	{
+#define NEOVM_STATE_ROOT_SIZE 32
+
+		// Merkle root over the contract storage: a binary trie on SHA256(key) with SHA256(value) in its leaves, where a
+		// subtree holding one entry is just its leaf, so the root only depends on the entries.
+		// the nodes live in the storage itself under keys no contract can write, one per trie position, so updating the
+		// root for a block reads and writes the nodes on the paths of the keys it changed and nothing else.
+		// a large change set is split into subtrees hashed in parallel.
+		// the usual block: execute on a StorageOverlay of the FileStorage, update with the overlay's writes, commit the
+		// overlay and then the file, so the entries and the nodes become durable together
+		class StateRoot
+		{
+		private:
+			struct Node;
+			struct Change;
+			struct Plan;
+
+			IStorage *_storage;
+			ThreadPool *_pool;
+
+			Node read_node(uint32_t depth, const char *path) const;
+			Node update(uint32_t depth, const Node &node, const Change *begin, const Change *end, StorageWriteSet *writes, Plan *plan) const;
+			Node join(uint32_t depth, const char *path, Node left, Node right, bool left_changed, bool right_changed, StorageWriteSet *writes) const;
+			Node build(uint32_t depth, const Change *begin, const Change *end, StorageWriteSet *writes) const;
+		public:
+			// pool is optional
+			explicit StateRoot(IStorage *storage, ThreadPool *pool = nullptr);
+
+			// NEOVM_STATE_ROOT_SIZE bytes, all zero for an empty storage
+			void root(char *out) const;
+
+			// updates the trie for the writes, which may or may not be in the storage yet, writes the changed nodes to the
+			// storage and returns the new root like root(). writes to trie nodes themselves are ignored
+			void update(const StorageWriteSet &writes, char *out);
+
+			// whether key is the key of a trie node rather than a contract_storage_key
+			static bool is_node_key(const std::string &key);
+
+			StateRoot(const StateRoot&) = delete;
+			StateRoot &operator=(const StateRoot&) = delete;
+		};
+	}
+}
+
+#endif
@@ -0,0 +1,90 @@
+#ifndef NEOVM_STORAGE_HPP
+#define NEOVM_STORAGE_HPP
+
+#include <neovm/config.hpp>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <stddef.h>
+
+namespace neo
+{
+	namespace vm
+	{
+		struct StorageWrite
+		{
+			bool removed;
+			std::vector<char> value;
+		};
+
+		typedef std::unordered_map<std::string, StorageWrite> StorageWriteSet;
+
+		// key-value state behind the Neo.Storage syscalls of an engine, keys are contract_storage_key values.
+		// get must be safe to call from several threads as long as nothing is written
+		class IStorage
+		{
+		public:
+			virtual ~IStorage() {}
+
+			// false when there is no value under key
+			virtual bool get(const std::string &key, std::vector<char> *value) = 0;
+
+			virtual void put(const std::string &key, const std::vector<char> &value) = 0;
+
+			virtual void remove(const std::string &key) = 0;
+		};
+
+		// the script id length, the script id and the key, so two contracts never share a key
+		std::string contract_storage_key(const char *script_id, size_t script_id_size, const char *key, size_t key_size);
+
+		// copy-on-write layer over a parent storage: writes stay in the overlay, reads fall through to the parent for keys
+		// it didn't write. overlays stack, e.g. one per transaction over the block state and one per APPCALL frame over
+		// that, so a dry run or fee estimate runs on an overlay that is thrown away instead of a copy of the state
+		class StorageOverlay : public IStorage
+		{
+		protected:
+			IStorage *_parent;
+			StorageWriteSet _writes;
+		public:
+			explicit StorageOverlay(IStorage *parent);
+
+			virtual bool get(const std::string &key, std::vector<char> *value);
+
+			virtual void put(const std::string &key, const std::vector<char> &value);
+
+			virtual void remove(const std::string &key);
+
+			inline IStorage *parent() const { return _parent; }
+			inline const StorageWriteSet &writes() const { return _writes; }
+
+			// writes the changes into the parent, one write per key changed, and empties the overlay
+			void commit();
+
+			// empties the overlay, the parent is never touched
+			void discard();
+		};
+
+		// an overlay that also records every key read from the parent.
+		// what a transaction executed speculatively sees
+		class RecordingStorage : public StorageOverlay
+		{
+		private:
+			std::unordered_set<std::string> _reads;
+		public:
+			explicit RecordingStorage(IStorage *base);
+
+			virtual bool get(const std::string &key, std::vector<char> *value);
+
+			// keys read from the base, keys read after this storage wrote them are not
+			inline const std::unordered_set<std::string> &reads() const { return _reads; }
+
+			void clear();
+		};
+
+		// applies the writes to storage
+		void apply_storage_writes(const StorageWriteSet &writes, IStorage *storage);
+	}
+}
+
+#endif
@@ -0,0 +1,57 @@
+#ifndef NEOVM_THREAD_POOL_HPP
+#define NEOVM_THREAD_POOL_HPP
+
+#include <neovm/config.hpp>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <stdint.h>
+
+namespace neo
+{
+	namespace vm
+	{
+		// fixed set of worker threads running one parallel_for at a time, the calling thread works too
+		class ThreadPool
+		{
+		private:
+			std::vector<std::thread> _workers;
+			std::mutex _call_mutex; // one parallel_for at a time
+			std::mutex _mutex;
+			std::condition_variable _work_ready;
+			std::condition_variable _work_done;
+			const std::function<void(size_t)> *_task;
+			size_t _count;
+			std::atomic<size_t> _next;
+			size_t _active; // workers still running the current parallel_for
+			uint64_t _generation;
+			bool _stopping;
+			std::exception_ptr _error;
+
+		public:
+			// threads is the number of workers besides the calling thread, 0 uses every hardware thread
+			explicit ThreadPool(size_t threads = 0);
+			~ThreadPool();
+
+			// workers plus the calling thread
+			size_t concurrency() const;
+
+			// runs task(i) for every i in [0, count) and returns when all are done.
+			// the first exception thrown by a task is rethrown here after the others finished
+			void parallel_for(size_t count, const std::function<void(size_t)> &task);
+
+			ThreadPool(const ThreadPool&) = delete;
+			ThreadPool &operator=(const ThreadPool&) = delete;
+
+		private:
+			void worker_loop();
+			void run_tasks();
+		};
+	}
+}
+
+#endif
@@ -2,6 +2,7 @@
 #define NEOVM_TYPES_HPP
 
 #include <neovm/stack_item.hpp>
+#include <neovm/stack_value.hpp>
 #include <neovm/helper.hpp>
 #include <vector>
 
@@ -14,7 +15,7 @@ namespace neo
 		class Array : public StackItem
 		{
 		protected:
-			std::vector<StackItem*> _array;
+			StackItemVector _array;
 
 		public:
 			inline virtual ~Array() {}
@@ -24,7 +25,11 @@ namespace neo
 
 			virtual bool Equals(StackItem *other);
 
-			virtual std::vector<StackItem*> *GetArray();
+			virtual StackItemVector *GetArray();
+
+			virtual void references(std::vector<StackItem*> *out) const;
+
+			virtual size_t memory_size() const;
 
 			virtual VMBigInteger GetBigInteger() const;
 
@@ -32,17 +37,39 @@ namespace neo
 
 			virtual std::string GetString() const;
 
-			virtual std::string to_json_string(std::set<void*> referenced_objects) const;
+			virtual void write_json(JsonWriter *writer) const;
 
 			virtual std::vector<char> GetByteArray() const;
 		};
 
 
 
+		// insertion-ordered hash table. keys are ByteArray, Integer or Boolean items, compared by Equals
 		class Map : public StackItem
 		{
 		protected:
-			std::vector<std::pair<StackItem*, StackItem*>> _items;
+			struct Entry
+			{
+				StackItem *key; // nullptr once the entry was removed
+				StackItem *value;
+				size_t hash;
+			};
+
+			std::vector<Entry, Allocator<Entry>> _entries; // in insertion order
+			// open addressing with linear probing, indexes of _entries, EMPTY_SLOT or REMOVED_SLOT. the size is a power of 2
+			std::vector<int32_t, Allocator<int32_t>> _slots;
+			size_t _count;
+
+			static const int32_t EMPTY_SLOT = -1;
+			static const int32_t REMOVED_SLOT = -2;
+
+			// slot of the key, or the empty slot where it would be inserted
+			size_t find_slot(const StackValue &key, size_t hash) const;
+			// rebuilds the slots and drops removed entries
+			void rehash(size_t capacity);
+			// makes room for one more entry
+			void reserve_one();
+			static void check_key(const StackValue &key);
 		public:
 			inline virtual ~Map() {}
 			inline virtual bool is_map() const { return true; }
@@ -51,19 +78,55 @@ namespace neo
 
 			virtual bool Equals(StackItem *other);
 
+			// whether the value can be used as a key: a byte array, integer or boolean
+			static bool is_valid_key(const StackValue &key);
+
 			virtual void put(StackItem *key, StackItem *value);
 
+			// inline keys are boxed into items owned by engine only when they are not in the map yet
+			virtual void put(ExecutionEngine *engine, const StackValue &key, StackItem *value);
+
+			// nullptr if the map has no such key
 			virtual StackItem* get(StackItem *key);
 
+			virtual StackItem* get(const StackValue &key);
+
+			inline bool contains_key(const StackValue &key) { return get(key) != nullptr; }
+
+			// whether the key was in the map
+			virtual bool remove(const StackValue &key);
+
+			inline size_t count() const { return _count; }
+
 			virtual std::vector<StackItem*> keys() const;
 
+			// append the keys/values in insertion order
+			virtual void keys(StackItemVector *out) const;
+
+			virtual void values(StackItemVector *out) const;
+
+			// calls f(key, value) for every entry in insertion order
+			template <typename F>
+			inline void for_each_entry(F f) const
+			{
+				for (const auto &entry : _entries)
+				{
+					if (entry.key)
+						f(entry.key, entry.value);
+				}
+			}
+
+			virtual void references(std::vector<StackItem*> *out) const;
+
+			virtual size_t memory_size() const;
+
 			virtual VMBigInteger GetBigInteger() const;
 
 			virtual bool GetBoolean() const;
 
 			virtual std::string GetString() const;
 
-			virtual std::string to_json_string(std::set<void*> referenced_objects) const;
+			virtual void write_json(JsonWriter *writer) const;
 
 			virtual std::vector<char> GetByteArray() const;
 		};
@@ -82,13 +145,15 @@ namespace neo
 
 			virtual bool Equals(StackItem *other);
 
+			virtual size_t hash_code() const;
+
 			virtual VMBigInteger GetBigInteger() const;
 
 			virtual bool GetBoolean() const;
 
 			virtual std::string GetString() const;
 
-			virtual std::string to_json_string(std::set<void*> referenced_objects) const;
+			virtual void write_json(JsonWriter *writer) const;
 
 			virtual std::vector<char> GetByteArray() const;
 		};
@@ -96,19 +161,31 @@ namespace neo
 		class ByteArray : public StackItem
 		{
 		private:
-			std::vector<char> _value;
+			std::vector<char, Allocator<char>> _value;
 
 		public:
 			ByteArray(ExecutionEngine *engine, std::vector<char> value);
+			ByteArray(ExecutionEngine *engine, const char *data, size_t size);
 			inline virtual ~ByteArray() {}
 
+			// the bytes of the item without copying them, valid while the item lives and isn't changed
+			inline ByteSpan span() const
+			{
+				ByteSpan result = { _value.data(), _value.size() };
+				return result;
+			}
+
 			virtual bool Equals(StackItem *other);
 
+			virtual size_t hash_code() const;
+
 			virtual std::vector<char> GetByteArray() const;
 
 			virtual std::string GetString() const;
 
-			virtual std::string to_json_string(std::set<void*> referenced_objects) const;
+			virtual size_t memory_size() const;
+
+			virtual void write_json(JsonWriter *writer) const;
 		};
 
 		class Integer : public StackItem
@@ -122,13 +199,15 @@ namespace neo
 
 			virtual bool Equals(StackItem *other);
 
+			virtual size_t hash_code() const;
+
 			virtual VMBigInteger GetBigInteger() const;
 
 			virtual bool GetBoolean() const;
 
 			virtual std::string GetString() const;
 
-			virtual std::string to_json_string(std::set<void*> referenced_objects) const;
+			virtual void write_json(JsonWriter *writer) const;
 
 			virtual std::vector<char> GetByteArray() const;
 		};
@@ -136,7 +215,7 @@ namespace neo
 		class Struct : public Array
 		{
 		public:
-			inline virtual bool IsStruct() { return true; }
+			inline virtual bool IsStruct() const override { return true; }
 
 			Struct(ExecutionEngine *engine, std::vector<StackItem*> value);
 			inline virtual ~Struct() {}
@@ -144,10 +223,6 @@ namespace neo
 			virtual StackItem *Clone(ExecutionEngine *engine);
 
 			virtual bool Equals(StackItem *other);
-
-			virtual std::string GetString() const;
-
-			virtual std::string to_json_string(std::set<void*> referenced_objects) const;
 		};
 
 		class Userdata : public StackItem
@@ -170,7 +245,7 @@ namespace neo
 
 			virtual std::string GetString() const;
 
-			virtual std::string to_json_string(std::set<void*> referenced_objects) const;
+			virtual void write_json(JsonWriter *writer) const;
 
 			virtual std::vector<char> GetByteArray() const;
 		};
@@ -1,6 +1,8 @@
 #ifndef NEOVM_CRYPTO_HPP
 #define NEOVM_CRYPTO_HPP
 #include "neovm/icrypto.hpp"
+#include "neovm/hash.hpp"
+#include "neovm/secp256r1.hpp"
 
 namespace neo
 {
@@ -13,15 +15,15 @@ namespace neo
 			public:
 				virtual std::vector<char> Hash160(std::vector<char> message)
 				{
-					std::vector<char> data(10);
-					memcpy(data.data(), "hashed160", 10);
+					std::vector<char> data(NEOVM_HASH160_SIZE);
+					hash160(message.data(), message.size(), data.data());
 					return data;
 				}
 
 				virtual std::vector<char> Hash256(std::vector<char> message)
 				{
-					std::vector<char> data(10);
-					memcpy(data.data(), "hashed256", 10);
+					std::vector<char> data(NEOVM_HASH256_SIZE);
+					hash256(message.data(), message.size(), data.data());
 					return data;
 				}
 
@@ -30,6 +32,59 @@ namespace neo
 					return true;
 				}
 			};
+
+			// ECDSA over secp256r1 with the SHA256 of the message, like NEO. decoded public keys are cached with their
+			// precomputed multiples, so keys that sign again (validators, exchanges) skip decompression and table building
+			class Secp256r1Crypto : public ICrypto
+			{
+			private:
+				Secp256r1KeyCache _keys;
+
+				bool verify(const char *hash, const std::vector<char> &signature, const std::vector<char> &pubkey)
+				{
+					auto key = _keys.get(pubkey.data(), pubkey.size());
+					return key && secp256r1_verify(hash, signature.data(), signature.size(), *key);
+				}
+			public:
+				explicit Secp256r1Crypto(size_t max_cached_keys = NEOVM_SECP256R1_KEY_CACHE_SIZE) : _keys(max_cached_keys) {}
+
+				virtual std::vector<char> Hash160(std::vector<char> message)
+				{
+					std::vector<char> data(NEOVM_HASH160_SIZE);
+					hash160(message.data(), message.size(), data.data());
+					return data;
+				}
+
+				virtual std::vector<char> Hash256(std::vector<char> message)
+				{
+					std::vector<char> data(NEOVM_HASH256_SIZE);
+					hash256(message.data(), message.size(), data.data());
+					return data;
+				}
+
+				virtual bool VerifySignature(std::vector<char> message, std::vector<char> signature, std::vector<char> pubkey)
+				{
+					char hash[NEOVM_SHA256_SIZE];
+					sha256(message.data(), message.size(), hash);
+					return verify(hash, signature, pubkey);
+				}
+
+				// the checks of a multisig share one message, which is hashed once
+				virtual void VerifySignatures(const std::vector<SignatureCheck> &checks, bool *results)
+				{
+					const std::vector<char> *hashed = nullptr;
+					char hash[NEOVM_SHA256_SIZE];
+					for (size_t i = 0; i < checks.size(); i++)
+					{
+						if (checks[i].message != hashed)
+						{
+							hashed = checks[i].message;
+							sha256(hashed->data(), hashed->size(), hash);
+						}
+						results[i] = verify(hash, *checks[i].signature, *checks[i].pubkey);
+					}
+				}
+			};
 		}
 	}
 }
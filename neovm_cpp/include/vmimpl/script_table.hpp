@@ -19,9 +19,11 @@ namespace neo
 			public:
 				virtual std::vector<char> get_script(std::string script_id)
 				{
-					if (_cached_scripts.find(script_id) == _cached_scripts.end())
+					// find only, so engines on several threads can share the table once the scripts are put
+					auto found = _cached_scripts.find(script_id);
+					if (found == _cached_scripts.end())
 						throw NeoVmException(("can't find script " + script_id).c_str());
-					return _cached_scripts[script_id];
+					return found->second;
 				}
 
 				void put_script(std::string script_id, std::vector<char> &script)
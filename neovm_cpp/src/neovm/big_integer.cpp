@@ -0,0 +1,516 @@
+#include <neovm/big_integer.hpp>
+#include <neovm/exceptions.hpp>
+
+#include <algorithm>
+
+namespace neo
+{
+	namespace vm
+	{
+		namespace
+		{
+			// limbs of the intermediate results, a product of two full values and one limb of carry
+			const size_t WORK_LIMBS = 2 * BigInteger::MAX_LIMBS + 1;
+			// limbs of the two's complement form used by the bitwise operators
+			const size_t TWOS_LIMBS = BigInteger::MAX_LIMBS + 1;
+
+			// sign and magnitude of a value, the form the slow paths work on
+			struct Magnitude
+			{
+				uint32_t limbs[WORK_LIMBS];
+				size_t size;
+				bool negative;
+			};
+
+			void trim(Magnitude *m)
+			{
+				while (m->size > 0 && m->limbs[m->size - 1] == 0)
+					m->size--;
+			}
+
+			void set_uint64(Magnitude *m, uint64_t value)
+			{
+				m->limbs[0] = (uint32_t)value;
+				m->limbs[1] = (uint32_t)(value >> 32);
+				m->size = 2;
+				trim(m);
+			}
+
+			int compare_magnitude(const uint32_t *a, size_t a_size, const uint32_t *b, size_t b_size)
+			{
+				if (a_size != b_size)
+					return a_size < b_size ? -1 : 1;
+				for (size_t i = a_size; i > 0; i--)
+				{
+					if (a[i - 1] != b[i - 1])
+						return a[i - 1] < b[i - 1] ? -1 : 1;
+				}
+				return 0;
+			}
+
+			// result = a + b, result may be a or b
+			void add_magnitude(const Magnitude &a, const Magnitude &b, Magnitude *result)
+			{
+				size_t size = std::max(a.size, b.size);
+				uint64_t carry = 0;
+				for (size_t i = 0; i < size; i++)
+				{
+					uint64_t sum = carry + (i < a.size ? a.limbs[i] : 0) + (i < b.size ? b.limbs[i] : 0);
+					result->limbs[i] = (uint32_t)sum;
+					carry = sum >> 32;
+				}
+				result->size = size;
+				if (carry)
+					result->limbs[result->size++] = (uint32_t)carry;
+			}
+
+			// result = a - b for a >= b, result may be a or b
+			void subtract_magnitude(const Magnitude &a, const Magnitude &b, Magnitude *result)
+			{
+				int64_t borrow = 0;
+				for (size_t i = 0; i < a.size; i++)
+				{
+					int64_t diff = (int64_t)a.limbs[i] - (i < b.size ? b.limbs[i] : 0) - borrow;
+					borrow = diff < 0 ? 1 : 0;
+					result->limbs[i] = (uint32_t)(diff + (borrow << 32));
+				}
+				result->size = a.size;
+				trim(result);
+			}
+
+			// signed sum of two magnitudes
+			void add_signed(const Magnitude &a, const Magnitude &b, Magnitude *result)
+			{
+				if (a.negative == b.negative)
+				{
+					add_magnitude(a, b, result);
+					result->negative = a.negative;
+				}
+				else if (compare_magnitude(a.limbs, a.size, b.limbs, b.size) >= 0)
+				{
+					bool negative = a.negative;
+					subtract_magnitude(a, b, result);
+					result->negative = negative;
+				}
+				else
+				{
+					bool negative = b.negative;
+					subtract_magnitude(b, a, result);
+					result->negative = negative;
+				}
+			}
+
+			// quotient and remainder of the magnitudes, divisor must not be zero
+			void divide_magnitude(const Magnitude &a, const Magnitude &b, Magnitude *quotient, Magnitude *remainder)
+			{
+				quotient->size = a.size;
+				std::fill(quotient->limbs, quotient->limbs + a.size, 0);
+				if (b.size == 1)
+				{
+					// one limb divisor, the common case
+					uint64_t rest = 0;
+					for (size_t i = a.size; i > 0; i--)
+					{
+						uint64_t current = (rest << 32) | a.limbs[i - 1];
+						quotient->limbs[i - 1] = (uint32_t)(current / b.limbs[0]);
+						rest = current % b.limbs[0];
+					}
+					trim(quotient);
+					set_uint64(remainder, rest);
+					return;
+				}
+				// binary long division, values are at most a few hundred bits
+				remainder->size = 0;
+				for (size_t bit = a.size * 32; bit > 0; bit--)
+				{
+					// remainder = remainder << 1 | next bit of a
+					uint32_t carry = (a.limbs[(bit - 1) / 32] >> ((bit - 1) % 32)) & 1;
+					for (size_t i = 0; i < remainder->size; i++)
+					{
+						uint32_t next = remainder->limbs[i] >> 31;
+						remainder->limbs[i] = (remainder->limbs[i] << 1) | carry;
+						carry = next;
+					}
+					if (carry)
+						remainder->limbs[remainder->size++] = carry;
+					if (compare_magnitude(remainder->limbs, remainder->size, b.limbs, b.size) >= 0)
+					{
+						subtract_magnitude(*remainder, b, remainder);
+						quotient->limbs[(bit - 1) / 32] |= 1u << ((bit - 1) % 32);
+					}
+				}
+				trim(quotient);
+			}
+
+			// two's complement of a magnitude in TWOS_LIMBS limbs
+			void to_twos_complement(const Magnitude &m, uint32_t *twos)
+			{
+				if (m.size > TWOS_LIMBS)
+					throw NeoVmException("integer overflow", ErrorCode::INVALID_OPERAND);
+				for (size_t i = 0; i < TWOS_LIMBS; i++)
+					twos[i] = i < m.size ? m.limbs[i] : 0;
+				if (m.negative)
+				{
+					uint64_t carry = 1;
+					for (size_t i = 0; i < TWOS_LIMBS; i++)
+					{
+						uint64_t value = (uint64_t)(uint32_t)~twos[i] + carry;
+						twos[i] = (uint32_t)value;
+						carry = value >> 32;
+					}
+				}
+			}
+
+			void from_twos_complement(const uint32_t *twos, Magnitude *m)
+			{
+				m->negative = (twos[TWOS_LIMBS - 1] >> 31) != 0;
+				for (size_t i = 0; i < TWOS_LIMBS; i++)
+					m->limbs[i] = twos[i];
+				m->size = TWOS_LIMBS;
+				if (m->negative)
+				{
+					uint64_t carry = 1;
+					for (size_t i = 0; i < TWOS_LIMBS; i++)
+					{
+						uint64_t value = (uint64_t)(uint32_t)~m->limbs[i] + carry;
+						m->limbs[i] = (uint32_t)value;
+						carry = value >> 32;
+					}
+				}
+				trim(m);
+			}
+
+			void load(const BigInteger &value, Magnitude *m)
+			{
+				m->size = value.magnitude(m->limbs, &m->negative);
+			}
+		}
+
+		BigInteger BigInteger::from_magnitude(const uint32_t *limbs, size_t size, bool negative)
+		{
+			while (size > 0 && limbs[size - 1] == 0)
+				size--;
+			if (size <= 2)
+			{
+				uint64_t magnitude = size == 0 ? 0 : (size == 1 ? limbs[0] : ((uint64_t)limbs[1] << 32) | limbs[0]);
+				if (magnitude <= (uint64_t)INT64_MAX)
+					return BigInteger(negative ? -(int64_t)magnitude : (int64_t)magnitude);
+				if (negative && magnitude == (uint64_t)INT64_MAX + 1)
+					return BigInteger(INT64_MIN);
+			}
+			if (size > MAX_LIMBS)
+				throw NeoVmException("integer overflow", ErrorCode::INVALID_OPERAND);
+			BigInteger result;
+			result._size = (uint32_t)size;
+			result._negative = negative;
+			std::copy(limbs, limbs + size, result._limbs);
+			return result;
+		}
+
+		BigInteger BigInteger::from_uint64(uint64_t value)
+		{
+			uint32_t limbs[2] = { (uint32_t)value, (uint32_t)(value >> 32) };
+			return from_magnitude(limbs, 2, false);
+		}
+
+		size_t BigInteger::magnitude(uint32_t *limbs, bool *negative) const
+		{
+			if (!is_small())
+			{
+				std::copy(_limbs, _limbs + _size, limbs);
+				*negative = _negative;
+				return _size;
+			}
+			*negative = _small < 0;
+			uint64_t value = _small < 0 ? (uint64_t)0 - (uint64_t)_small : (uint64_t)_small;
+			limbs[0] = (uint32_t)value;
+			limbs[1] = (uint32_t)(value >> 32);
+			return limbs[1] ? 2 : (limbs[0] ? 1 : 0);
+		}
+
+		int64_t BigInteger::to_int64() const
+		{
+			if (is_small())
+				return _small;
+			return _negative ? INT64_MIN : INT64_MAX;
+		}
+
+		std::vector<char> BigInteger::to_byte_array() const
+		{
+			std::vector<char> bytes;
+			if (is_small())
+			{
+				if (_small == 0)
+					return bytes;
+				bytes.resize(8);
+				for (int i = 0; i < 8; i++)
+					bytes[i] = (char)(_small >> (i * 8));
+			}
+			else
+			{
+				Magnitude m;
+				load(*this, &m);
+				uint32_t twos[TWOS_LIMBS];
+				to_twos_complement(m, twos);
+				bytes.resize(TWOS_LIMBS * 4);
+				for (size_t i = 0; i < bytes.size(); i++)
+					bytes[i] = (char)(twos[i / 4] >> ((i % 4) * 8));
+			}
+			// drop the sign extension bytes the sign bit of the byte below already implies
+			char extension = sign() < 0 ? (char)0xff : 0;
+			size_t size = bytes.size();
+			while (size > 1 && bytes[size - 1] == extension && ((bytes[size - 2] ^ extension) & 0x80) == 0)
+				size--;
+			bytes.resize(size);
+			return bytes;
+		}
+
+		size_t BigInteger::byte_size() const
+		{
+			return to_byte_array().size();
+		}
+
+		BigInteger BigInteger::from_byte_array(const char *data, size_t size)
+		{
+			if (size == 0)
+				return BigInteger();
+			bool negative = (data[size - 1] & 0x80) != 0;
+			if (size <= 8)
+			{
+				uint64_t value = negative ? ~(uint64_t)0 : 0;
+				for (size_t i = 0; i < size; i++)
+				{
+					value &= ~((uint64_t)0xff << (i * 8));
+					value |= (uint64_t)(VMByte)data[i] << (i * 8);
+				}
+				return BigInteger((int64_t)value);
+			}
+			if (size > TWOS_LIMBS * 4)
+				throw NeoVmException("integer overflow", ErrorCode::INVALID_OPERAND);
+			uint32_t twos[TWOS_LIMBS];
+			for (size_t i = 0; i < TWOS_LIMBS; i++)
+				twos[i] = negative ? 0xffffffffu : 0;
+			for (size_t i = 0; i < size; i++)
+			{
+				twos[i / 4] &= ~(0xffu << ((i % 4) * 8));
+				twos[i / 4] |= (uint32_t)(VMByte)data[i] << ((i % 4) * 8);
+			}
+			Magnitude m;
+			from_twos_complement(twos, &m);
+			return from_magnitude(m.limbs, m.size, m.negative);
+		}
+
+		std::string BigInteger::to_string() const
+		{
+			if (is_small())
+				return std::to_string(_small);
+			Magnitude m;
+			load(*this, &m);
+			// peel off 9 decimal digits at a time
+			std::vector<uint32_t> chunks;
+			while (m.size > 0)
+			{
+				uint64_t rest = 0;
+				for (size_t i = m.size; i > 0; i--)
+				{
+					uint64_t current = (rest << 32) | m.limbs[i - 1];
+					m.limbs[i - 1] = (uint32_t)(current / 1000000000u);
+					rest = current % 1000000000u;
+				}
+				trim(&m);
+				chunks.push_back((uint32_t)rest);
+			}
+			std::string result = _negative ? "-" : "";
+			result += std::to_string(chunks.back());
+			for (size_t i = chunks.size() - 1; i > 0; i--)
+			{
+				auto chunk = std::to_string(chunks[i - 1]);
+				result.append(9 - chunk.size(), '0');
+				result += chunk;
+			}
+			return result;
+		}
+
+		BigInteger BigInteger::add(const BigInteger &a, const BigInteger &b)
+		{
+			Magnitude x, y, r;
+			load(a, &x);
+			load(b, &y);
+			add_signed(x, y, &r);
+			return from_magnitude(r.limbs, r.size, r.negative);
+		}
+
+		BigInteger BigInteger::subtract(const BigInteger &a, const BigInteger &b)
+		{
+			Magnitude x, y, r;
+			load(a, &x);
+			load(b, &y);
+			y.negative = !y.negative;
+			add_signed(x, y, &r);
+			return from_magnitude(r.limbs, r.size, r.negative);
+		}
+
+		BigInteger BigInteger::multiply(const BigInteger &a, const BigInteger &b)
+		{
+			Magnitude x, y, r;
+			load(a, &x);
+			load(b, &y);
+			r.size = x.size + y.size;
+			std::fill(r.limbs, r.limbs + r.size, 0);
+			for (size_t i = 0; i < x.size; i++)
+			{
+				uint64_t carry = 0;
+				for (size_t j = 0; j < y.size; j++)
+				{
+					uint64_t current = (uint64_t)x.limbs[i] * y.limbs[j] + r.limbs[i + j] + carry;
+					r.limbs[i + j] = (uint32_t)current;
+					carry = current >> 32;
+				}
+				r.limbs[i + y.size] = (uint32_t)carry;
+			}
+			trim(&r);
+			return from_magnitude(r.limbs, r.size, x.negative != y.negative);
+		}
+
+		BigInteger BigInteger::divide(const BigInteger &a, const BigInteger &b)
+		{
+			Magnitude x, y, q, r;
+			load(a, &x);
+			load(b, &y);
+			if (y.size == 0)
+				throw NeoVmException("division by zero", ErrorCode::INVALID_OPERAND);
+			divide_magnitude(x, y, &q, &r);
+			// truncated toward zero
+			return from_magnitude(q.limbs, q.size, x.negative != y.negative);
+		}
+
+		BigInteger BigInteger::remainder(const BigInteger &a, const BigInteger &b)
+		{
+			Magnitude x, y, q, r;
+			load(a, &x);
+			load(b, &y);
+			if (y.size == 0)
+				throw NeoVmException("division by zero", ErrorCode::INVALID_OPERAND);
+			divide_magnitude(x, y, &q, &r);
+			// has the sign of the dividend
+			return from_magnitude(r.limbs, r.size, x.negative);
+		}
+
+		BigInteger BigInteger::negate(const BigInteger &a)
+		{
+			Magnitude x;
+			load(a, &x);
+			return from_magnitude(x.limbs, x.size, !x.negative);
+		}
+
+		enum BitwiseOperator
+		{
+			BITWISE_AND,
+			BITWISE_OR,
+			BITWISE_XOR
+		};
+
+		// applies a bitwise operator to the two's complement forms of x and y
+		static void bitwise(const Magnitude &x, const Magnitude &y, BitwiseOperator op, Magnitude *result)
+		{
+			uint32_t a[TWOS_LIMBS], b[TWOS_LIMBS];
+			to_twos_complement(x, a);
+			to_twos_complement(y, b);
+			for (size_t i = 0; i < TWOS_LIMBS; i++)
+			{
+				switch (op)
+				{
+				case BITWISE_AND: a[i] &= b[i]; break;
+				case BITWISE_OR: a[i] |= b[i]; break;
+				default: a[i] ^= b[i]; break;
+				}
+			}
+			from_twos_complement(a, result);
+		}
+
+		BigInteger BigInteger::bitwise_and(const BigInteger &a, const BigInteger &b)
+		{
+			Magnitude x, y, r;
+			load(a, &x);
+			load(b, &y);
+			bitwise(x, y, BITWISE_AND, &r);
+			return from_magnitude(r.limbs, r.size, r.negative);
+		}
+
+		BigInteger BigInteger::bitwise_or(const BigInteger &a, const BigInteger &b)
+		{
+			Magnitude x, y, r;
+			load(a, &x);
+			load(b, &y);
+			bitwise(x, y, BITWISE_OR, &r);
+			return from_magnitude(r.limbs, r.size, r.negative);
+		}
+
+		BigInteger BigInteger::bitwise_xor(const BigInteger &a, const BigInteger &b)
+		{
+			Magnitude x, y, r;
+			load(a, &x);
+			load(b, &y);
+			bitwise(x, y, BITWISE_XOR, &r);
+			return from_magnitude(r.limbs, r.size, r.negative);
+		}
+
+		BigInteger BigInteger::shift_left(const BigInteger &a, int n)
+		{
+			Magnitude x, r;
+			load(a, &x);
+			if (x.size == 0 || n == 0)
+				return a;
+			if (n > 0)
+			{
+				size_t limbs = (size_t)n / 32, bits = (size_t)n % 32;
+				if (x.size + limbs + 1 > WORK_LIMBS)
+					throw NeoVmException("integer overflow", ErrorCode::INVALID_OPERAND);
+				std::fill(r.limbs, r.limbs + x.size + limbs + 1, 0);
+				for (size_t i = 0; i < x.size; i++)
+				{
+					uint64_t shifted = (uint64_t)x.limbs[i] << bits;
+					r.limbs[i + limbs] |= (uint32_t)shifted;
+					r.limbs[i + limbs + 1] |= (uint32_t)(shifted >> 32);
+				}
+				r.size = x.size + limbs + 1;
+				trim(&r);
+				return from_magnitude(r.limbs, r.size, x.negative);
+			}
+			// right shift rounds toward negative infinity: -x >> n == -(((x - 1) >> n) + 1)
+			Magnitude one;
+			set_uint64(&one, 1);
+			if (x.negative)
+				subtract_magnitude(x, one, &x);
+			size_t limbs = (size_t)-(int64_t)n / 32, bits = (size_t)-(int64_t)n % 32;
+			r.size = x.size > limbs ? x.size - limbs : 0;
+			for (size_t i = 0; i < r.size; i++)
+			{
+				uint64_t pair = x.limbs[i + limbs] | (i + limbs + 1 < x.size ? (uint64_t)x.limbs[i + limbs + 1] << 32 : 0);
+				r.limbs[i] = (uint32_t)(pair >> bits);
+			}
+			trim(&r);
+			if (x.negative)
+				add_magnitude(r, one, &r);
+			return from_magnitude(r.limbs, r.size, x.negative);
+		}
+
+		int BigInteger::compare(const BigInteger &a, const BigInteger &b)
+		{
+			int a_sign = a.sign(), b_sign = b.sign();
+			if (a_sign != b_sign)
+				return a_sign < b_sign ? -1 : 1;
+			Magnitude x, y;
+			load(a, &x);
+			load(b, &y);
+			int result = compare_magnitude(x.limbs, x.size, y.limbs, y.size);
+			return a_sign < 0 ? -result : result;
+		}
+
+		bool BigInteger::equals(const BigInteger &a, const BigInteger &b)
+		{
+			return compare(a, b) == 0;
+		}
+
+	}
+}
@@ -0,0 +1,165 @@
+#include <neovm/engine_pool.hpp>
+#include <neovm/serialization.hpp>
+
+namespace neo
+{
+	namespace vm
+	{
+		EnginePool::EnginePool(size_t workers, ICrypto *crypto, IScriptTable *table, InteropService *service,
+			ScriptCache *script_cache, size_t queue_capacity)
+			: _queue(queue_capacity), _pending(0), _unfinished(0), _sleeping(0), _stopping(false)
+		{
+			if (!service)
+			{
+				_own_service.reset(new InteropService());
+				service = _own_service.get();
+			}
+			service->freeze();
+			_service = service;
+			if (workers == 0)
+			{
+				workers = std::thread::hardware_concurrency();
+				if (workers == 0)
+					workers = 1;
+			}
+			for (size_t i = 0; i < workers; i++)
+			{
+				_engines.emplace_back(new ExecutionEngine(nullptr, crypto, table, _service));
+				_engines.back()->set_script_cache(script_cache);
+			}
+			_caller_engine.reset(new ExecutionEngine(nullptr, crypto, table, _service));
+			_caller_engine->set_script_cache(script_cache);
+			for (size_t i = 0; i < workers; i++)
+				_workers.emplace_back(&EnginePool::worker_loop, this, _engines[i].get());
+		}
+
+		EnginePool::~EnginePool()
+		{
+			{
+				std::lock_guard<std::mutex> lock(_mutex);
+				_stopping = true;
+			}
+			_job_ready.notify_all();
+			for (auto &worker : _workers)
+				worker.join();
+		}
+
+		size_t EnginePool::workers() const
+		{
+			return _workers.size();
+		}
+
+		void EnginePool::submit(Job job)
+		{
+			++_unfinished;
+			++_pending;
+			while (!_queue.try_push(job))
+			{
+				std::unique_lock<std::mutex> lock(_mutex);
+				_space_ready.wait_for(lock, std::chrono::milliseconds(1));
+			}
+			if (_sleeping.load() > 0)
+			{
+				std::lock_guard<std::mutex> lock(_mutex);
+				_job_ready.notify_one();
+			}
+		}
+
+		std::future<EngineJobResult> EnginePool::execute(std::vector<char> script, std::vector<char> script_id, IScriptContainer *container, int64_t gas_limit)
+		{
+			auto shared_script = std::make_shared<std::vector<char>>(std::move(script));
+			auto shared_id = std::make_shared<std::vector<char>>(std::move(script_id));
+			return run([shared_script, shared_id, container, gas_limit](ExecutionEngine *engine) {
+				return run_script(engine, *shared_script, *shared_id, container, gas_limit);
+			});
+		}
+
+		void EnginePool::execute(std::vector<char> script, std::vector<char> script_id, IScriptContainer *container, int64_t gas_limit,
+			std::function<void(EngineJobResult)> callback)
+		{
+			auto shared_script = std::make_shared<std::vector<char>>(std::move(script));
+			auto shared_id = std::make_shared<std::vector<char>>(std::move(script_id));
+			submit([shared_script, shared_id, container, gas_limit, callback](ExecutionEngine *engine) {
+				callback(run_script(engine, *shared_script, *shared_id, container, gas_limit));
+			});
+		}
+
+		void EnginePool::wait_idle()
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			_idle.wait(lock, [this] { return _unfinished.load() == 0; });
+		}
+
+		void EnginePool::prepare(ExecutionEngine *engine)
+		{
+			engine->set_script_container(nullptr);
+			engine->set_storage(nullptr);
+			engine->set_no_gas_limit();
+		}
+
+		void EnginePool::worker_loop(ExecutionEngine *engine)
+		{
+			Job job;
+			for (;;)
+			{
+				if (!_queue.try_pop(&job))
+				{
+					std::unique_lock<std::mutex> lock(_mutex);
+					++_sleeping;
+					_job_ready.wait(lock, [this] { return _pending.load() > 0 || _stopping.load(); });
+					--_sleeping;
+					if (_pending.load() == 0 && _stopping.load())
+						return;
+					continue;
+				}
+				--_pending;
+				_space_ready.notify_one();
+				prepare(engine);
+				try
+				{
+					job(engine);
+				}
+				catch (...)
+				{
+				}
+				job = nullptr;
+				engine->reset();
+				if (--_unfinished == 0)
+				{
+					std::lock_guard<std::mutex> lock(_mutex);
+					_idle.notify_all();
+				}
+			}
+		}
+
+		EngineJobResult EnginePool::run_script(ExecutionEngine *engine, const std::vector<char> &script, const std::vector<char> &script_id,
+			IScriptContainer *container, int64_t gas_limit)
+		{
+			engine->set_script_container(container);
+			if (gas_limit >= 0)
+				engine->set_gas_limit(gas_limit);
+			EngineJobResult result;
+			engine->load_script(script, script_id, false);
+			engine->execute();
+			result.state = engine->state();
+			result.exit_code = engine->exit_code();
+			result.fault_message = engine->fault_message();
+			result.gas_used = engine->gas_used();
+			auto stack = engine->evaluation_stack();
+			for (size_t i = 0; i < stack->size(); i++)
+			{
+				result.results.emplace_back();
+				try
+				{
+					serialize_stack_item(stack->peek(i), &result.results.back());
+				}
+				catch (const NeoVmException&)
+				{
+					// interop interfaces have no binary form, they are left empty
+					result.results.back().clear();
+				}
+			}
+			return result;
+		}
+	}
+}
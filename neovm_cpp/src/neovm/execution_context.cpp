@@ -4,67 +4,94 @@ namespace neo
 {
 	namespace vm
 	{
+		LoadedScript::LoadedScript(std::shared_ptr<DecodedScript> decoded_script, std::vector<char> script_id, bool push_only, std::set<uint64_t> break_points)
+			: decoded_script(std::move(decoded_script)), script_id(std::move(script_id)), push_only(push_only), break_points(std::move(break_points))
+		{
+		}
+
 		ExecutionContext::ExecutionContext(ExecutionEngineP engine, std::vector<char> script, std::vector<char> script_id, bool push_only, std::set<uint64_t> break_points)
 		{
 			this->_engine = engine;
-			this->_script = script;
-			this->_script_id = script_id;
-			this->_push_only = push_only;
-			this->_op_reader = new BinaryReader(script);
-			this->_break_points = break_points;
+			this->_script = std::make_shared<LoadedScript>(std::make_shared<DecodedScript>(std::move(script), engine->is_neo_mode()), std::move(script_id), push_only, std::move(break_points));
+			this->_decoded_script = _script->decoded_script.get();
+			this->_instruction_index = 0;
+		}
+
+		ExecutionContext::ExecutionContext(ExecutionEngineP engine, std::shared_ptr<DecodedScript> decoded_script, std::vector<char> script_id, bool push_only, std::set<uint64_t> break_points)
+		{
+			this->_engine = engine;
+			this->_script = std::make_shared<LoadedScript>(std::move(decoded_script), std::move(script_id), push_only, std::move(break_points));
+			this->_decoded_script = _script->decoded_script.get();
+			this->_instruction_index = 0;
+		}
+
+		ExecutionContext::ExecutionContext(ExecutionEngineP engine, std::shared_ptr<LoadedScript> script, uint32_t instruction_index)
+		{
+			this->_engine = engine;
+			this->_script = std::move(script);
+			this->_decoded_script = _script->decoded_script.get();
+			this->_instruction_index = instruction_index;
+		}
+
+		void ExecutionContext::reuse(const std::shared_ptr<LoadedScript> &script, uint32_t instruction_index)
+		{
+			_script = script;
+			_decoded_script = _script->decoded_script.get();
+			_instruction_index = instruction_index;
+		}
+
+		void ExecutionContext::release()
+		{
+			_script.reset();
+			_decoded_script = nullptr;
 		}
 
 		void ExecutionContext::set_instruction_pointer(int value)
 		{
-			_op_reader->Seek(value, BinaryReader::BEGIN);
+			auto index = _decoded_script->index_of((size_t)value);
+			if (value < 0 || index < 0)
+				throw NeoVmException("instruction pointer is not at an instruction boundary");
+			_instruction_index = (uint32_t)index;
 		}
 
 		int ExecutionContext::get_instruction_pointer()
 		{
-			return (int)_op_reader->position();
+			return (int)_decoded_script->instructions()[_instruction_index].offset;
 		}
 
 		std::set<uint64_t>* ExecutionContext::break_points()
 		{
-			return &_break_points;
+			return &_script->break_points;
 		}
 
 		std::vector<char> ExecutionContext::script_id() const
 		{
-			return _script_id;
+			return _script->script_id;
 		}
 
 		bool ExecutionContext::push_only() const
 		{
-			return _push_only;
-		}
-
-		BinaryReader* ExecutionContext::op_reader() const
-		{
-			return _op_reader;
+			return _script->push_only;
 		}
 
-		std::vector<char>* ExecutionContext::script()
+		const std::vector<char>* ExecutionContext::script() const
 		{
-			return &_script;
+			return &_decoded_script->script();
 		}
 
 		OpCode ExecutionContext::next_instruction() 
 		{ 
-			return (OpCode)((VMByte)_script[_op_reader->position()]);
+			return (OpCode)_decoded_script->instructions()[_instruction_index].opcode;
 		}
 
 		ExecutionContext* ExecutionContext::clone()
 		{
-			auto other = new ExecutionContext(_engine, _script, _script_id, _push_only, _break_points);
-			other->set_instruction_pointer(get_instruction_pointer());
-			return other;
+			return new ExecutionContext(_engine, _script, _instruction_index);
 		}
 
 		ExecutionContext::~ExecutionContext()
 		{
-			// _op_reader->Dispose();
 		}
 
 	}
-}
\ No newline at end of file
+}
@@ -1,27 +1,42 @@
 #include <neovm/execution_engine.hpp>
 #include <neovm/execution_context.hpp>
+#include <neovm/instruction.hpp>
 #include <neovm/types.hpp>
 #include <neovm/stack_item.hpp>
 #include <neovm/exceptions.hpp>
 #include <neovm/script_builder.hpp>
+#include <neovm/hash.hpp>
 
+#include <algorithm>
 #include <math.h>
 
 namespace neo
 {
 	namespace vm
 	{
-		ExecutionEngine::ExecutionEngine(IScriptContainer *container, ICrypto *crypto, IScriptTable *table, InteropService *service)
+		ExecutionEngine::ExecutionEngine(IScriptContainer *container, ICrypto *crypto, IScriptTable *table, InteropService *service, MemoryResource *resource)
+			: _invocation_stack(NEOVM_INVOCATION_STACK_INITIAL_CAPACITY, NEOVM_MAX_INVOCATION_DEPTH),
+			// the interpreter checks the total size of both stacks itself, see NEOVM_MAX_STACK_SIZE
+			_evaluation_stack(NEOVM_STACK_INITIAL_CAPACITY, SIZE_MAX), _alt_stack(NEOVM_STACK_INITIAL_CAPACITY, SIZE_MAX),
+			_resource(resource ? resource : &_arena), _gc(_resource)
 		{
 			_script_container = container;
 			_crypto = crypto;
+			_storage = nullptr;
+			_storage_frames_enabled = false;
 			_table = table;
+			_script_cache = nullptr;
+			_owns_service = service == nullptr;
 			_service = service ? service : new InteropService();
 			_state = VMState::BREAK;
 			_exit_code = ErrorCode::OK;
+			_fault_message = nullptr;
+			_throw_on_fault = false;
 			_debug_mode = false;
 			_gas_limit = -1;
 			_gas_used = 0;
+			_gas_costs = GasCostTable::default_table();
+			_stopped = false;
 			_is_neo_mode = true; // Ĭneo vmģʽ
 		}
 
@@ -45,6 +60,21 @@ namespace neo
 			return _exit_code;
 		}
 
+		std::string ExecutionEngine::fault_message() const
+		{
+			return _fault_message ? std::string(_fault_message) : std::string();
+		}
+
+		void ExecutionEngine::set_throw_on_fault(bool throw_on_fault)
+		{
+			_throw_on_fault = throw_on_fault;
+		}
+
+		bool ExecutionEngine::throw_on_fault() const
+		{
+			return _throw_on_fault;
+		}
+
 		void ExecutionEngine::open_debug_mode()
 		{
 			_debug_mode = true;
@@ -73,10 +103,12 @@ namespace neo
 		void ExecutionEngine::set_gas_limit(int64_t gas_limit)
 		{
 			_gas_limit = gas_limit;
+			_stopped = false;
 		}
 		void ExecutionEngine::set_no_gas_limit()
 		{
 			_gas_limit = -1;
+			_stopped = false;
 		}
 		void ExecutionEngine::set_gas_used(int64_t gas_used)
 		{
@@ -86,6 +118,14 @@ namespace neo
 		{
 			_gas_used += delta_used;
 		}
+		void ExecutionEngine::set_gas_cost_table(const GasCostTable *gas_costs)
+		{
+			_gas_costs = gas_costs ? gas_costs : GasCostTable::default_table();
+		}
+		const GasCostTable* ExecutionEngine::gas_cost_table() const
+		{
+			return _gas_costs;
+		}
 
 		void ExecutionEngine::set_neo_mode(bool neo_mode)
 		{
@@ -99,52 +139,134 @@ namespace neo
 		void ExecutionEngine::stop()
 		{
 			set_gas_limit(0); // 0 is don't exeucte any script op
+			_stopped = true;
 		}
 
 		ExecutionEngine::~ExecutionEngine()
 		{
 			while (_invocation_stack.size() > 0)
 			{
-				auto last = _invocation_stack.peek();
-				delete last;
-				_invocation_stack.pop();
+				delete _invocation_stack.pop();
+			}
+			for (auto context : _free_contexts)
+			{
+				delete context;
 			}
+			_free_contexts.clear();
 
 			for (const auto &cb : _pre_close_callbacks)
 			{
 				cb(this);
 			}
 			_pre_close_callbacks.clear();
+			if (_owns_service)
+				delete _service;
+			// the stack items are dropped by _gc, their memory goes away with _arena
+		}
 
-			auto &pool = _stack_items_pool.pool();
-			for (auto &item : pool)
+		void ExecutionEngine::reset()
+		{
+			while (_invocation_stack.size() > 0)
+			{
+				free_context(_invocation_stack.pop());
+			}
+			_evaluation_stack.clear();
+			_alt_stack.clear();
+			_storage_frames.clear();
+
+			for (const auto &cb : _pre_close_callbacks)
 			{
-				delete item;
+				cb(this);
 			}
-			pool.clear();
+			_pre_close_callbacks.clear();
+
+			_global_env.clear();
+			_container_values.clear();
+			_gc.clear();
+			if (_resource->is_arena())
+				_resource->reset();
+
+			_state = VMState::BREAK;
+			_exit_code = ErrorCode::OK;
+			_fault_message = nullptr;
+			_fault_what.clear();
+			_gas_used = 0;
 		}
 
 		void ExecutionEngine::execute()
 		{
 			_state = (VMState) (_state & ~VMState::BREAK);
-			auto i = 0;
-			while (!Helper::enum_has_flag(_state, VMState::HALT) && !Helper::enum_has_flag(_state, VMState::FAULT) && !Helper::enum_has_flag(_state, VMState::BREAK))
+			if (Helper::enum_has_flag(_state, VMState::HALT) || Helper::enum_has_flag(_state, VMState::FAULT)) return;
+			execute_steps(SIZE_MAX);
+		}
+
+		void ExecutionEngine::load_script(std::vector<char> script, std::vector<char> script_id, bool push_only = false)
+		{
+			if (_invocation_stack.size() >= NEOVM_MAX_INVOCATION_DEPTH)
 			{
-				if (in_debug_mode())
-				{
-					std::cout << (i++) << ":";
-				}
-				step_into();
+				throw NeoVmException("invocation over limit");
 			}
+			load_script(std::make_shared<DecodedScript>(std::move(script), is_neo_mode(), _gas_costs), std::move(script_id), push_only);
 		}
 
-		void ExecutionEngine::load_script(std::vector<char> script, std::vector<char> script_id, bool push_only = false)
+		void ExecutionEngine::load_script(std::shared_ptr<DecodedScript> script, std::vector<char> script_id, bool push_only)
 		{
-			_invocation_stack.push(new ExecutionContext(this, script, script_id, push_only, std::set<uint64_t>()));
-			if (_invocation_stack.size() > NEOVM_MAX_INVOCATION_DEPTH)
+			if (_invocation_stack.size() >= NEOVM_MAX_INVOCATION_DEPTH)
 			{
 				throw NeoVmException("invocation over limit");
 			}
+			if (script->gas_table_version() != _gas_costs->version())
+			{
+				// priced with another gas table
+				script = std::make_shared<DecodedScript>(script->script(), is_neo_mode(), _gas_costs);
+			}
+			auto loaded_script = std::make_shared<LoadedScript>(std::move(script), std::move(script_id), push_only, std::set<uint64_t>());
+			_invocation_stack.push(new_context(loaded_script, 0));
+		}
+
+		void ExecutionEngine::set_script_cache(ScriptCache *cache)
+		{
+			_script_cache = cache;
+		}
+
+		ScriptCache* ExecutionEngine::script_cache() const
+		{
+			return _script_cache;
+		}
+
+		std::shared_ptr<DecodedScript> ExecutionEngine::get_decoded_script(const char *script_id, size_t size)
+		{
+			if (_script_cache)
+			{
+				auto cached = _script_cache->find(script_id, size, _is_neo_mode, _gas_costs->version());
+				if (cached)
+					return cached;
+			}
+			if (_table == nullptr)
+				return nullptr;
+			auto script = _table->get_script(Helper::bytes_to_string(script_id, size));
+			if (script.size() < 1)
+				return nullptr;
+			auto decoded = std::make_shared<DecodedScript>(std::move(script), _is_neo_mode, _gas_costs);
+			if (_script_cache)
+				_script_cache->insert(script_id, size, _is_neo_mode, decoded);
+			return decoded;
+		}
+
+		ExecutionContext* ExecutionEngine::new_context(const std::shared_ptr<LoadedScript> &script, uint32_t instruction_index)
+		{
+			if (_free_contexts.empty())
+				return new ExecutionContext(this, script, instruction_index);
+			auto context = _free_contexts.back();
+			_free_contexts.pop_back();
+			context->reuse(script, instruction_index);
+			return context;
+		}
+
+		void ExecutionEngine::free_context(ExecutionContext *context)
+		{
+			context->release();
+			_free_contexts.push_back(context);
 		}
 
 		bool ExecutionEngine::remove_break_point(uint64_t position)
@@ -161,23 +283,55 @@ namespace neo
 		{
 			if (_invocation_stack.size() == 0) _state = (VMState)(_state | VMState::HALT);
 			if (Helper::enum_has_flag(_state, VMState::HALT) || Helper::enum_has_flag(_state, VMState::FAULT)) return;
-			OpCode opcode = current_context()->get_instruction_pointer() >= current_context()->script()->size() ? OpCode::OP_RET : (OpCode)((VMByte)current_context()->op_reader()->ReadByte());
+			execute_steps(1);
+		}
+
+		bool ExecutionEngine::needs_inspection() const
+		{
+			for (size_t i = 0; i < _invocation_stack.size(); i++)
+			{
+				auto loaded = _invocation_stack.peek(i)->loaded_script().get();
+				if (loaded->push_only || !loaded->break_points.empty())
+					return true;
+			}
+			return false;
+		}
+
+		void ExecutionEngine::execute_steps(size_t max_steps)
+		{
+			typedef void (ExecutionEngine::*ExecuteOpsFunction)(size_t);
+			// indexed by trace << 2 | limit_gas << 1 | inspect
+			static const ExecuteOpsFunction execute_ops[8] = {
+				&ExecutionEngine::ExecuteOps<ExecutionPolicy<false, false, false> >,
+				&ExecutionEngine::ExecuteOps<ExecutionPolicy<false, false, true> >,
+				&ExecutionEngine::ExecuteOps<ExecutionPolicy<false, true, false> >,
+				&ExecutionEngine::ExecuteOps<ExecutionPolicy<false, true, true> >,
+				&ExecutionEngine::ExecuteOps<ExecutionPolicy<true, false, false> >,
+				&ExecutionEngine::ExecuteOps<ExecutionPolicy<true, false, true> >,
+				&ExecutionEngine::ExecuteOps<ExecutionPolicy<true, true, false> >,
+				&ExecutionEngine::ExecuteOps<ExecutionPolicy<true, true, true> >
+			};
+			// settings are read once per run: breakpoints, push-only scripts and debug mode changed by a syscall take effect at the next run.
+			// scripts loaded by APPCALL/TAILCALL never have breakpoints and are never push-only
+			bool inspect = max_steps != SIZE_MAX || needs_inspection();
+			auto run = execute_ops[(in_debug_mode() ? 4 : 0) | (has_gas_limit() ? 2 : 0) | (inspect ? 1 : 0)];
 			try
 			{
-				ExecuteOp(opcode, current_context());
+				(this->*run)(max_steps);
 			}
 			catch (NeoVmException &e)
 			{
-				_exit_code = e.code();
-				union_change_state(VMState::FAULT);
-				throw e;
+				// stack item conversions, heap limit and syscalls still report errors by exceptions
+				_fault_what = e.what();
+				fault(e.code(), _fault_what.c_str());
 			}
 			catch (std::exception &e)
 			{
-				_exit_code = ErrorCode::SIMPLE_ERROR;
-				union_change_state(VMState::FAULT);
-				throw e;
+				_fault_what = e.what();
+				fault(ErrorCode::SIMPLE_ERROR, _fault_what.c_str());
 			}
+			if (_throw_on_fault && Helper::enum_has_flag(_state, VMState::FAULT))
+				throw NeoVmException(fault_message(), _exit_code);
 		}
 
 		void ExecutionEngine::step_out()
@@ -232,7 +386,7 @@ namespace neo
 			return _crypto;
 		}
 
-		RandomAccessStack<StackItem*>* ExecutionEngine::evaluation_stack()
+		RandomAccessStack<StackValue>* ExecutionEngine::evaluation_stack()
 		{
 			return &_evaluation_stack;
 		}
@@ -242,9 +396,72 @@ namespace neo
 			return _script_container;
 		}
 
+		void ExecutionEngine::set_script_container(IScriptContainer *container)
+		{
+			_script_container = container;
+		}
+
+		IStorage *ExecutionEngine::storage() const
+		{
+			return _storage_frames.empty() ? _storage : _storage_frames.back().overlay.get();
+		}
+
+		void ExecutionEngine::set_storage(IStorage *storage)
+		{
+			_storage_frames.clear();
+			_storage = storage;
+		}
+
+		void ExecutionEngine::set_storage_frames(bool enabled)
+		{
+			_storage_frames_enabled = enabled;
+		}
+
+		bool ExecutionEngine::storage_frames() const
+		{
+			return _storage_frames_enabled;
+		}
+
 		void ExecutionEngine::add_stack_item_to_pool(StackItem *obj)
 		{
-			_stack_items_pool.add(obj);
+			_gc.add(obj);
+		}
+
+		MemoryResource* ExecutionEngine::memory_resource() const
+		{
+			return _resource;
+		}
+
+		GarbageCollector* ExecutionEngine::garbage_collector()
+		{
+			return &_gc;
+		}
+
+		void ExecutionEngine::collect_garbage()
+		{
+			std::vector<StackItem*> roots;
+			roots.reserve(_evaluation_stack.size() + _alt_stack.size() + _global_env.size() + _container_values.size());
+			for (size_t i = 0; i < _evaluation_stack.size(); i++)
+			{
+				auto item = _evaluation_stack.peek(i).item();
+				if (item)
+					roots.push_back(item);
+			}
+			for (size_t i = 0; i < _alt_stack.size(); i++)
+			{
+				auto item = _alt_stack.peek(i).item();
+				if (item)
+					roots.push_back(item);
+			}
+			for (const auto &pair : _global_env)
+			{
+				roots.push_back(pair.second);
+			}
+			for (const auto &pair : _container_values)
+			{
+				roots.push_back(pair.second);
+			}
+			_gc.collect(roots);
 		}
 
 		void ExecutionEngine::union_change_state(VMState other)
@@ -252,6 +469,18 @@ namespace neo
 			_state = (VMState)(_state | other);
 		}
 
+		void ExecutionEngine::fault(ErrorCode code, const char *message)
+		{
+			_exit_code = code;
+			_fault_message = message;
+			union_change_state(VMState::FAULT);
+			while (_invocation_stack.size() > 0)
+			{
+				free_context(_invocation_stack.pop());
+			}
+			_storage_frames.clear();
+		}
+
 		void ExecutionEngine::register_global_variable(std::string name, StackItem *value)
 		{
 			_global_env[name] = value;
@@ -285,264 +514,326 @@ namespace neo
 				return nullptr;
 		}
 
-		void ExecutionEngine::ExecuteOp(OpCode opcode, ExecutionContext *context)
+		template <class Policy>
+		void ExecutionEngine::ExecuteOps(size_t max_steps)
 		{
-			if (opcode > OpCode::OP_PUSH16 && opcode != OpCode::OP_RET && context->push_only())
+#ifdef NEOVM_THREADED_DISPATCH
+#define NEOVM_INSTRUCTION_HANDLER_LABEL(name) &&op_##name,
+			static void *const dispatch_table[IH_COUNT] = { NEOVM_INSTRUCTION_HANDLERS(NEOVM_INSTRUCTION_HANDLER_LABEL) };
+#undef NEOVM_INSTRUCTION_HANDLER_LABEL
+#endif
+			if (_invocation_stack.size() == 0)
 			{
-				_state = (VMState) (_state | VMState::FAULT);
+				union_change_state(VMState::HALT);
 				return;
 			}
-			if (in_debug_mode())
-			{
-				std::cout << "op: " << op_code_to_str(opcode) << " before eval stack size is: " << std::to_string(evaluation_stack()->size()) << std::endl;
+			ExecutionContext *context = current_context();
+			const LoadedScript *loaded = context->loaded_script().get();
+			const DecodedScript *decoded = context->decoded_script();
+			const Instruction *instructions = decoded->instructions();
+			const Instruction *instr = nullptr;
+			size_t remaining = max_steps;
+
+			// faults don't throw, a faulting script is as common as a halting one
+#define NEOVM_FAULT(code, message) do { fault(ErrorCode::code, message); return; } while (0)
+
+			// ops that change the invocation stack must reload the cached context before the next instruction
+#define NEOVM_RELOAD_CONTEXT() \
+			if (_invocation_stack.size() > 0) \
+			{ \
+				context = current_context(); \
+				loaded = context->loaded_script().get(); \
+				decoded = context->decoded_script(); \
+				instructions = decoded->instructions(); \
 			}
-			if (has_gas_limit() && _gas_used >= _gas_limit)
-			{
-				throw NeoVmException("gas used out of limit");
+
+#define NEOVM_CHARGE_GAS(gas) \
+			if (Policy::limit_gas) \
+			{ \
+				if (!charge_gas(gas)) \
+					NEOVM_FAULT(OVER_GAS_LIMIT, "gas used out of limit"); \
+			} \
+			else \
+				_gas_used += (gas);
+
+#define NEOVM_FETCH() \
+			instr = &instructions[context->instruction_index()]; \
+			context->set_instruction_index(instr->next); \
+			if (Policy::inspect && instr->opcode > OpCode::OP_PUSH16 && instr->opcode != OpCode::OP_RET && loaded->push_only) \
+				NEOVM_FAULT(BAD_SCRIPT, "non-push instruction in a push-only script"); \
+			if (_evaluation_stack.size() < instr->stack_inputs) \
+				NEOVM_FAULT(STACK_UNDERFLOW, "stack underflow"); \
+			if (Policy::trace) \
+			{ \
+				std::cout << (max_steps - remaining) << ":" << "op: " << op_code_to_str((OpCode)instr->opcode) << " before eval stack size is: " << std::to_string(evaluation_stack()->size()) << std::endl; \
+			} \
+			if (instr->block_gas != 0) \
+			{ \
+				NEOVM_CHARGE_GAS(instr->block_gas); \
 			}
-			++_gas_used;
 
-			if (opcode >= OpCode::OP_PUSHBYTES1 && opcode <= OpCode::OP_PUSHBYTES75)
-				_evaluation_stack.push(StackItem::to_stack_item(this, context->op_reader()->ReadBytes((char)opcode)));
-			else
-			{ 
-				switch (opcode)
+			// integers are inline when they fit in 64 bits, larger results are limited to NEOVM_MAX_BIGINTEGER_SIZE bytes like NEO
+#define NEOVM_PUSH_INTEGER(value) \
+			do \
+			{ \
+				VMBigInteger integer_value = (value); \
+				if (!integer_value.is_small() && integer_value.byte_size() > NEOVM_MAX_BIGINTEGER_SIZE) \
+					NEOVM_FAULT(INVALID_OPERAND, "integer too large"); \
+				_evaluation_stack.push_back(StackValue::from_integer(this, integer_value)); \
+			} while (0)
+
+			// between two instructions every live item is reachable from the engine roots, so it is the only place to collect
+#define NEOVM_END_OF_INSTRUCTION() \
+			if (_gc.should_collect()) \
+				collect_garbage(); \
+			if (_evaluation_stack.size() + _alt_stack.size() > NEOVM_MAX_STACK_SIZE) \
+				NEOVM_FAULT(STACK_OVERFLOW, "stack overflow"); \
+			if (_state & (VMState::HALT | VMState::FAULT | VMState::BREAK)) \
+				return; \
+			if (_stopped) \
+				NEOVM_FAULT(OVER_GAS_LIMIT, "gas used out of limit"); \
+			if (Policy::inspect && !loaded->break_points.empty() \
+				&& loaded->break_points.find((uint64_t)instructions[context->instruction_index()].offset) != loaded->break_points.end()) \
+			{ \
+				union_change_state(VMState::BREAK); \
+				return; \
+			} \
+			if ((Policy::inspect || Policy::trace) && --remaining == 0) \
+				return;
+
+#ifdef NEOVM_THREADED_DISPATCH
+			// direct threading: every handler fetches and jumps to the next handler itself
+#define NEOVM_CASE(name) op_##name:
+#define NEOVM_DISPATCH() goto *dispatch_table[instr->handler]
+#define NEOVM_NEXT() do { NEOVM_END_OF_INSTRUCTION(); NEOVM_FETCH(); NEOVM_DISPATCH(); } while (0)
+
+			NEOVM_FETCH();
+			NEOVM_DISPATCH();
+#else
+#define NEOVM_CASE(name) case IH_##name:
+#define NEOVM_NEXT() goto end_of_instruction
+
+			for (;;)
+			{
+				NEOVM_FETCH();
+				switch (instr->handler)
 				{
-					// Push value
-				case OpCode::OP_PUSH0:
-					_evaluation_stack.push(StackItem::to_stack_item(this, std::vector<char>()));
-					break;
-				case OpCode::OP_PUSHDATA1:
-					_evaluation_stack.push(StackItem::to_stack_item(this, context->op_reader()->ReadBytes(context->op_reader()->ReadByte())));
-					break;
-				case OpCode::OP_PUSHDATA2:
-					_evaluation_stack.push(StackItem::to_stack_item(this, context->op_reader()->ReadBytes(context->op_reader()->ReadUInt16())));
-					break;
-				case OpCode::OP_PUSHDATA4:
-					_evaluation_stack.push(StackItem::to_stack_item(this, context->op_reader()->ReadBytes(context->op_reader()->ReadInt32())));
-					break;
-				case OpCode::OP_PUSHM1:
-				case OpCode::OP_PUSH1:
-				case OpCode::OP_PUSH2:
-				case OpCode::OP_PUSH3:
-				case OpCode::OP_PUSH4:
-				case OpCode::OP_PUSH5:
-				case OpCode::OP_PUSH6:
-				case OpCode::OP_PUSH7:
-				case OpCode::OP_PUSH8:
-				case OpCode::OP_PUSH9:
-				case OpCode::OP_PUSH10:
-				case OpCode::OP_PUSH11:
-				case OpCode::OP_PUSH12:
-				case OpCode::OP_PUSH13:
-				case OpCode::OP_PUSH14:
-				case OpCode::OP_PUSH15:
-				case OpCode::OP_PUSH16:
-					_evaluation_stack.push(StackItem::to_stack_item(this, (int)opcode - (int)OpCode::OP_PUSH1 + 1));
-					break;
-
-					// Control
-				case OpCode::OP_NOP:
-					break;
-				case OpCode::OP_JMP:
-				case OpCode::OP_JMPIF:
-				case OpCode::OP_JMPIFNOT:
-				{
-					int offset = context->op_reader()->ReadInt16();
-					offset = context->get_instruction_pointer() + offset - 3;
-					if (offset < 0 || offset > context->script()->size())
-					{
-						union_change_state(VMState::FAULT);
-						return;
-					}
-					bool fValue = true;
-					if (opcode > OpCode::OP_JMP)
-					{
-						fValue = _evaluation_stack.pop()->GetBoolean();
-						if (opcode == OpCode::OP_JMPIFNOT)
-							fValue = !fValue;
-					}
-					if (fValue)
-						context->set_instruction_pointer(offset);
+#endif
+				// Push value
+				NEOVM_CASE(PUSHBYTES)
+				{
+					auto data = decoded->data(*instr);
+					_evaluation_stack.push(StackItem::to_stack_item(this, std::vector<char>(data, data + instr->data_size)));
 				}
-				break;
+				NEOVM_NEXT();
+				NEOVM_CASE(PUSH0)
+					_evaluation_stack.push(StackItem::to_stack_item(this, std::vector<char>()));
+					NEOVM_NEXT();
+				NEOVM_CASE(PUSHINT)
+					_evaluation_stack.push(StackValue::from_integer(instr->value));
+					NEOVM_NEXT();
 
-				case OpCode::OP_CALL:
-					_invocation_stack.push(context->clone());
-					context->set_instruction_pointer(context->get_instruction_pointer() + 2);
-					ExecuteOp(OpCode::OP_JMP, current_context());
-					break;
-				case OpCode::OP_RET:
-				{
-					if (_invocation_stack.size() < 1)
+				// Control
+				NEOVM_CASE(NOP)
+					NEOVM_NEXT();
+				NEOVM_CASE(JMP)
+				{
+					if (instr->target < 0)
+						NEOVM_FAULT(INVALID_JUMP, "jump out of the script");
+					context->set_instruction_index((uint32_t)instr->target);
+				}
+				NEOVM_NEXT();
+				NEOVM_CASE(JMPIF)
+				{
+					if (instr->target < 0)
+						NEOVM_FAULT(INVALID_JUMP, "jump out of the script");
+					if (_evaluation_stack.pop().GetBoolean())
+						context->set_instruction_index((uint32_t)instr->target);
+				}
+				NEOVM_NEXT();
+				NEOVM_CASE(JMPIFNOT)
+				{
+					if (instr->target < 0)
+						NEOVM_FAULT(INVALID_JUMP, "jump out of the script");
+					if (!_evaluation_stack.pop().GetBoolean())
+						context->set_instruction_index((uint32_t)instr->target);
+				}
+				NEOVM_NEXT();
+				NEOVM_CASE(CALL)
+				{
+					if (instr->target < 0)
+						NEOVM_FAULT(INVALID_JUMP, "jump out of the script");
+					if (_invocation_stack.size() >= NEOVM_MAX_INVOCATION_DEPTH)
+						NEOVM_FAULT(INVOCATION_OVER_LIMIT, "invocation over limit");
+					_invocation_stack.push(new_context(context->loaded_script(), (uint32_t)instr->target));
+					NEOVM_RELOAD_CONTEXT();
+				}
+				NEOVM_NEXT();
+				NEOVM_CASE(RET)
+				{
+					free_context(_invocation_stack.pop());
+					if (!_storage_frames.empty() && _invocation_stack.size() < _storage_frames.back().depth)
 					{
-						throw NeoVmException("empty invocation stack to pop");
+						// the called contract returned
+						_storage_frames.back().overlay->commit();
+						_storage_frames.pop_back();
 					}
-					delete _invocation_stack.pop();
 					if (_invocation_stack.size() == 0)
 						union_change_state(VMState::HALT);
+					NEOVM_RELOAD_CONTEXT();
 				}
-					break;
-				case OpCode::OP_APPCALL:
-				case OpCode::OP_TAILCALL:
+				NEOVM_NEXT();
+				NEOVM_CASE(APPCALL)
+				NEOVM_CASE(TAILCALL)
 				{
 					if (_table == nullptr)
+						NEOVM_FAULT(SCRIPT_NOT_FOUND, "no script table");
+					// the raw operand bytes, a script hash can hold zero bytes. only the script table sees it as a string
+					std::vector<char> script_id(decoded->data(*instr), decoded->data(*instr) + instr->data_size);
+					auto script = get_decoded_script(decoded->data(*instr), instr->data_size);
+					if (!script)
+						NEOVM_FAULT(SCRIPT_NOT_FOUND, "script not found");
+					// instr points into the caller's script, which a tail call may free with the caller's frame
+					bool is_appcall = instr->handler == IH_APPCALL;
+					if (!is_appcall)
+						free_context(_invocation_stack.pop());
+					else if (_invocation_stack.size() >= NEOVM_MAX_INVOCATION_DEPTH)
+						NEOVM_FAULT(INVOCATION_OVER_LIMIT, "invocation over limit");
+					load_script(std::move(script), std::move(script_id), false);
+					// a tail call keeps the frame of the contract it replaces
+					if (_storage_frames_enabled && _storage && is_appcall)
+						_storage_frames.push_back(StorageFrame{ std::unique_ptr<StorageOverlay>(new StorageOverlay(storage())), _invocation_stack.size() });
+					NEOVM_RELOAD_CONTEXT();
+				}
+				NEOVM_NEXT();
+				NEOVM_CASE(SYSCALL)
+				{
+					auto service_id = instr->service_id;
+					if (service_id == NEOVM_UNKNOWN_SERVICE_ID)
 					{
-						union_change_state(VMState::FAULT);
-						return;
+						// the service may have been registered after the script was decoded
+						service_id = find_service_id(Helper::bytes_to_string(decoded->data(*instr), instr->data_size));
+						NEOVM_CHARGE_GAS(_gas_costs->service_cost(service_id));
 					}
-					std::string script_id;
-					if (is_neo_mode())
+					if (Policy::trace)
 					{
-						script_id = Helper::bytes_to_string(context->op_reader()->ReadBytes(20));
+						std::cout << "syscall " << Helper::bytes_to_string(decoded->data(*instr), instr->data_size) << std::endl;
 					}
-					else
-					{
-						uint32_t script_id_length = context->op_reader()->ReadUInt32();
-						script_id = Helper::bytes_to_string(context->op_reader()->ReadBytes(script_id_length));
-					}
-					auto script = _table->get_script(script_id);
-					if (script.size() < 1)
-					{
-						union_change_state(VMState::FAULT);
-						return;
-					}
-					if (opcode == OpCode::OP_TAILCALL)
-						delete _invocation_stack.pop();
-					load_script(script, Helper::string_content_to_chars(script_id));
-				}
-				break;
-				case OpCode::OP_SYSCALL:
-				{
-					auto bytes = Helper::ReadVarBytes(context->op_reader(), 252);
-					auto func_name = Helper::bytes_to_string(bytes);
-					if (in_debug_mode())
+					if (!_service->invoke(service_id, this))
 					{
-						std::cout << "syscall " << func_name << std::endl;
-					}
-					if (!_service->invoke(func_name, this))
-					{
-						if (in_debug_mode())
+						if (Policy::trace)
 						{
-							std::cout << "Can't find syscall " + func_name << std::endl;
+							std::cout << "Can't find syscall " + Helper::bytes_to_string(decoded->data(*instr), instr->data_size) << std::endl;
 						}
-						union_change_state(VMState::FAULT);
+						NEOVM_FAULT(SYSCALL_FAILED, "syscall failed");
 					}
-					break;
+					NEOVM_RELOAD_CONTEXT();
 				}
+				NEOVM_NEXT();
 
-					// Stack ops
-				case OpCode::OP_DUPFROMALTSTACK:
-					_evaluation_stack.push_back(Helper::peek(_alt_stack));
-					break;
-				case OpCode::OP_TOALTSTACK:
+				// Stack ops
+				NEOVM_CASE(DUPFROMALTSTACK)
+					if (_alt_stack.size() < 1)
+						NEOVM_FAULT(STACK_UNDERFLOW, "alt stack underflow");
+					_evaluation_stack.push_back(_alt_stack.peek());
+					NEOVM_NEXT();
+				NEOVM_CASE(TOALTSTACK)
 					_alt_stack.push_back(_evaluation_stack.pop());
-					break;
-				case OpCode::OP_FROMALTSTACK:
-					_evaluation_stack.push(Helper::pop(_alt_stack));
-					break;
-				case OpCode::OP_XDROP:
-				{
-					int n = (int)(_evaluation_stack.pop()->GetBigInteger());
-					if (n < 0)
-					{
-						union_change_state(VMState::FAULT);
-						return;
-					}
+					NEOVM_NEXT();
+				NEOVM_CASE(FROMALTSTACK)
+					if (_alt_stack.size() < 1)
+						NEOVM_FAULT(STACK_UNDERFLOW, "alt stack underflow");
+					_evaluation_stack.push(_alt_stack.pop());
+					NEOVM_NEXT();
+				NEOVM_CASE(XDROP)
+				{
+					int n = (int)_evaluation_stack.pop().GetInt64();
+					if (n < 0 || n >= (int)_evaluation_stack.size())
+						NEOVM_FAULT(INVALID_OPERAND, "stack index out of range");
 					_evaluation_stack.remove(n);
 				}
-				break;
-				case OpCode::OP_XSWAP:
+				NEOVM_NEXT();
+				NEOVM_CASE(XSWAP)
 				{
-					int n = (int)_evaluation_stack.pop()->GetBigInteger();
-					if (n < 0)
+					int n = (int)_evaluation_stack.pop().GetInt64();
+					if (n < 0 || n >= (int)_evaluation_stack.size())
+						NEOVM_FAULT(INVALID_OPERAND, "stack index out of range");
+					if (n > 0)
 					{
-						union_change_state(VMState::FAULT);
-						return;
+						auto xn = _evaluation_stack.peek(n);
+						_evaluation_stack.set(n, _evaluation_stack.peek());
+						_evaluation_stack.set(0, xn);
 					}
-					if (n == 0) break;
-					auto xn = _evaluation_stack.peek(n);
-					_evaluation_stack.set(n, _evaluation_stack.peek());
-					_evaluation_stack.set(0, xn);
 				}
-				break;
-				case OpCode::OP_XTUCK:
+				NEOVM_NEXT();
+				NEOVM_CASE(XTUCK)
 				{
-					int n = (int)_evaluation_stack.pop()->GetBigInteger();
-					if (n <= 0)
-					{
-						union_change_state(VMState::FAULT);
-						return;
-					}
+					int n = (int)_evaluation_stack.pop().GetInt64();
+					if (n <= 0 || n > (int)_evaluation_stack.size())
+						NEOVM_FAULT(INVALID_OPERAND, "stack index out of range");
 					_evaluation_stack.insert(n, _evaluation_stack.peek());
 				}
-				break;
-				case OpCode::OP_DEPTH:
-					_evaluation_stack.push_back(StackItem::to_stack_item(this, _evaluation_stack.size()));
-					break;
-				case OpCode::OP_DROP:
+				NEOVM_NEXT();
+				NEOVM_CASE(DEPTH)
+					_evaluation_stack.push_back(StackValue::from_integer((int64_t)_evaluation_stack.size()));
+					NEOVM_NEXT();
+				NEOVM_CASE(DROP)
 					_evaluation_stack.pop();
-					break;
-				case OpCode::OP_DUP:
+					NEOVM_NEXT();
+				NEOVM_CASE(DUP)
 					_evaluation_stack.push_back(_evaluation_stack.peek());
-					break;
-				case OpCode::OP_NIP:
+					NEOVM_NEXT();
+				NEOVM_CASE(NIP)
 				{
 					auto x2 = _evaluation_stack.pop();
 					_evaluation_stack.pop();
 					_evaluation_stack.push_back(x2);
 				}
-				break;
-				case OpCode::OP_OVER:
+				NEOVM_NEXT();
+				NEOVM_CASE(OVER)
 				{
 					auto x2 = _evaluation_stack.pop();
 					auto x1 = _evaluation_stack.peek();
 					_evaluation_stack.push_back(x2);
 					_evaluation_stack.push_back(x1);
 				}
-				break;
-				case OpCode::OP_PICK:
+				NEOVM_NEXT();
+				NEOVM_CASE(PICK)
 				{
-					int n = (int)_evaluation_stack.pop()->GetBigInteger();
-					if (n < 0)
-					{
-						union_change_state(VMState::FAULT);
-						return;
-					}
+					int n = (int)_evaluation_stack.pop().GetInt64();
+					if (n < 0 || n >= (int)_evaluation_stack.size())
+						NEOVM_FAULT(INVALID_OPERAND, "stack index out of range");
 					_evaluation_stack.push(_evaluation_stack.peek(n));
 				}
-				break;
-				case OpCode::OP_ROLL:
+				NEOVM_NEXT();
+				NEOVM_CASE(ROLL)
 				{
-					int n = (int)_evaluation_stack.pop()->GetBigInteger();
-					if (n < 0)
-					{
-						union_change_state(VMState::FAULT);
-						return;
-					}
-					if (n == 0) break;
-					_evaluation_stack.push_back(_evaluation_stack.remove(n));
+					int n = (int)_evaluation_stack.pop().GetInt64();
+					if (n < 0 || n >= (int)_evaluation_stack.size())
+						NEOVM_FAULT(INVALID_OPERAND, "stack index out of range");
+					if (n > 0)
+						_evaluation_stack.push_back(_evaluation_stack.remove(n));
 				}
-				break;
-				case OpCode::OP_ROT:
+				NEOVM_NEXT();
+				NEOVM_CASE(ROT)
 				{
-					auto x3 =_evaluation_stack.pop();
+					auto x3 = _evaluation_stack.pop();
 					auto x2 = _evaluation_stack.pop();
 					auto x1 = _evaluation_stack.pop();
 					_evaluation_stack.push_back(x2);
 					_evaluation_stack.push_back(x3);
 					_evaluation_stack.push_back(x1);
 				}
-				break;
-				case OpCode::OP_SWAP:
+				NEOVM_NEXT();
+				NEOVM_CASE(SWAP)
 				{
 					auto x2 = _evaluation_stack.pop();
 					auto x1 = _evaluation_stack.pop();
 					_evaluation_stack.push_back(x2);
 					_evaluation_stack.push_back(x1);
 				}
-				break;
-				case OpCode::OP_TUCK:
+				NEOVM_NEXT();
+				NEOVM_CASE(TUCK)
 				{
 					auto x2 = _evaluation_stack.pop();
 					auto x1 = _evaluation_stack.pop();
@@ -550,453 +841,474 @@ namespace neo
 					_evaluation_stack.push_back(x1);
 					_evaluation_stack.push_back(x2);
 				}
-				break;
-				case OpCode::OP_CAT:
+				NEOVM_NEXT();
+
+				// Splice
+				NEOVM_CASE(CAT)
 				{
-					auto x2 = _evaluation_stack.pop()->GetByteArray();
-					auto x1 = _evaluation_stack.pop()->GetByteArray();
+					auto x2 = _evaluation_stack.pop().GetByteArray();
+					auto x1 = _evaluation_stack.pop().GetByteArray();
 					_evaluation_stack.push_back(StackItem::to_stack_item(this, Helper::concat_vector(x1, x2)));
 				}
-				break;
-				case OpCode::OP_SUBSTR:
+				NEOVM_NEXT();
+				NEOVM_CASE(SUBSTR)
 				{
-					int count = (int)_evaluation_stack.pop()->GetBigInteger();
+					int count = (int)_evaluation_stack.pop().GetInt64();
 					if (count < 0)
-					{
-						union_change_state(VMState::FAULT);
-						return;
-					}
-					int index = (int)_evaluation_stack.pop()->GetBigInteger();
+						NEOVM_FAULT(INVALID_OPERAND, "negative count");
+					int index = (int)_evaluation_stack.pop().GetInt64();
 					if (index < 0)
-					{
-						union_change_state(VMState::FAULT);
-						return;
-					}
-					auto x = _evaluation_stack.pop()->GetByteArray();
+						NEOVM_FAULT(INVALID_OPERAND, "negative index");
+					auto x = _evaluation_stack.pop().GetByteArray();
+					if ((size_t)index > x.size())
+						index = (int)x.size();
+					if ((size_t)count > x.size() - index)
+						count = (int)(x.size() - index);
 					std::vector<char> result(count);
 					memcpy(result.data(), x.data() + index, sizeof(char) * count);
 					_evaluation_stack.push_back(StackItem::to_stack_item(this, result));
 				}
-				break;
-				case OpCode::OP_LEFT:
+				NEOVM_NEXT();
+				NEOVM_CASE(LEFT)
 				{
-					int count = (int)_evaluation_stack.pop()->GetBigInteger();
+					int count = (int)_evaluation_stack.pop().GetInt64();
 					if (count < 0)
-					{
-						union_change_state(VMState::FAULT);
-						return;
-					}
-					auto x = _evaluation_stack.pop()->GetByteArray();
+						NEOVM_FAULT(INVALID_OPERAND, "negative count");
+					auto x = _evaluation_stack.pop().GetByteArray();
+					if ((size_t)count > x.size())
+						count = (int)x.size();
 					std::vector<char> result(count);
 					memcpy(result.data(), x.data(), sizeof(char) * count);
 					_evaluation_stack.push_back(StackItem::to_stack_item(this, result));
 				}
-				break;
-				case OpCode::OP_RIGHT:
+				NEOVM_NEXT();
+				NEOVM_CASE(RIGHT)
 				{
-					int count = (int)_evaluation_stack.pop()->GetBigInteger();
+					int count = (int)_evaluation_stack.pop().GetInt64();
 					if (count < 0)
-					{
-						union_change_state(VMState::FAULT);
-						return;
-					}
-					auto x = _evaluation_stack.pop()->GetByteArray();
+						NEOVM_FAULT(INVALID_OPERAND, "negative count");
+					auto x = _evaluation_stack.pop().GetByteArray();
 					if (x.size() < count)
-					{
-						union_change_state(VMState::FAULT);
-						return;
-					}
+						NEOVM_FAULT(INVALID_OPERAND, "count out of range");
 					std::vector<char> result(count);
 					memcpy(result.data(), x.data() + x.size() - count, sizeof(char) * count);
 					_evaluation_stack.push_back(StackItem::to_stack_item(this, result));
 				}
-				break;
-				case OpCode::OP_SIZE:
+				NEOVM_NEXT();
+				NEOVM_CASE(SIZE)
 				{
-					auto x = _evaluation_stack.pop()->GetByteArray();
-					_evaluation_stack.push_back(StackItem::to_stack_item(this, x.size()));
+					auto x = _evaluation_stack.pop().GetByteArray();
+					_evaluation_stack.push_back(StackValue::from_integer((int64_t)x.size()));
 				}
-				break;
+				NEOVM_NEXT();
 
 				// Bitwise logic
-				case OpCode::OP_INVERT:
+				NEOVM_CASE(INVERT)
 				{
-					VMBigInteger x = _evaluation_stack.pop()->GetBigInteger();
-					_evaluation_stack.push_back(StackItem::to_stack_item(this, ~x));
+					VMBigInteger x = _evaluation_stack.pop().GetBigInteger();
+					NEOVM_PUSH_INTEGER(~x);
 				}
-				break;
-				case OpCode::BIT_AND:
+				NEOVM_NEXT();
+				NEOVM_CASE(AND)
 				{
-					VMBigInteger x2 = _evaluation_stack.pop()->GetBigInteger();
-					VMBigInteger x1 = _evaluation_stack.pop()->GetBigInteger();
-					_evaluation_stack.push_back(StackItem::to_stack_item(this, x1 & x2));
+					VMBigInteger x2 = _evaluation_stack.pop().GetBigInteger();
+					VMBigInteger x1 = _evaluation_stack.pop().GetBigInteger();
+					NEOVM_PUSH_INTEGER(x1 & x2);
 				}
-				break;
-				case OpCode::BIT_OR:
+				NEOVM_NEXT();
+				NEOVM_CASE(OR)
 				{
-					VMBigInteger x2 = _evaluation_stack.pop()->GetBigInteger();
-					VMBigInteger x1 = _evaluation_stack.pop()->GetBigInteger();
-					_evaluation_stack.push_back(StackItem::to_stack_item(this, x1 | x2));
+					VMBigInteger x2 = _evaluation_stack.pop().GetBigInteger();
+					VMBigInteger x1 = _evaluation_stack.pop().GetBigInteger();
+					NEOVM_PUSH_INTEGER(x1 | x2);
 				}
-				break;
-				case OpCode::BIT_XOR:
+				NEOVM_NEXT();
+				NEOVM_CASE(XOR)
 				{
-					VMBigInteger x2 = _evaluation_stack.pop()->GetBigInteger();
-					VMBigInteger x1 = _evaluation_stack.pop()->GetBigInteger();
-					_evaluation_stack.push_back(StackItem::to_stack_item(this, x1 ^ x2));
+					VMBigInteger x2 = _evaluation_stack.pop().GetBigInteger();
+					VMBigInteger x1 = _evaluation_stack.pop().GetBigInteger();
+					NEOVM_PUSH_INTEGER(x1 ^ x2);
 				}
-				break;
-				case OpCode::OP_EQUAL:
+				NEOVM_NEXT();
+				NEOVM_CASE(EQUAL)
 				{
 					auto x2 = _evaluation_stack.pop();
 					auto x1 = _evaluation_stack.pop();
-					_evaluation_stack.push_back(StackItem::to_stack_item_from_bool(this, x1->Equals(x2)));
+					_evaluation_stack.push_back(StackValue::from_bool(x1.Equals(x2)));
 				}
-				break;
+				NEOVM_NEXT();
 
 				// Numeric
-				case OpCode::OP_INC:
+				NEOVM_CASE(INC)
 				{
-					VMBigInteger x = _evaluation_stack.pop()->GetBigInteger();
-					_evaluation_stack.push_back(StackItem::to_stack_item(this, x + 1));
+					VMBigInteger x = _evaluation_stack.pop().GetBigInteger();
+					NEOVM_PUSH_INTEGER(x + 1);
 				}
-				break;
-				case OpCode::OP_DEC:
+				NEOVM_NEXT();
+				NEOVM_CASE(DEC)
 				{
-					VMBigInteger x = _evaluation_stack.pop()->GetBigInteger();
-					_evaluation_stack.push_back(StackItem::to_stack_item(this, x - 1));
+					VMBigInteger x = _evaluation_stack.pop().GetBigInteger();
+					NEOVM_PUSH_INTEGER(x - 1);
 				}
-				break;
-				case OpCode::OP_SIGN:
+				NEOVM_NEXT();
+				NEOVM_CASE(SIGN)
 				{
-					VMBigInteger x = _evaluation_stack.pop()->GetBigInteger();
-					// FIXME: ĳ _evaluation_stack.push_back(x.Sign);
-					_evaluation_stack.push_back(StackItem::to_stack_item(this, x));
+					VMBigInteger x = _evaluation_stack.pop().GetBigInteger();
+					_evaluation_stack.push_back(StackValue::from_integer((int64_t)x.sign()));
 				}
-				break;
-				case OpCode::OP_NEGATE:
+				NEOVM_NEXT();
+				NEOVM_CASE(NEGATE)
 				{
-					VMBigInteger x = _evaluation_stack.pop()->GetBigInteger();
-					_evaluation_stack.push_back(StackItem::to_stack_item(this, -x));
+					VMBigInteger x = _evaluation_stack.pop().GetBigInteger();
+					NEOVM_PUSH_INTEGER(-x);
 				}
-				break;
-				case OpCode::OP_ABS:
+				NEOVM_NEXT();
+				NEOVM_CASE(ABS)
 				{
-					VMBigInteger x = _evaluation_stack.pop()->GetBigInteger();
-					_evaluation_stack.push_back(StackItem::to_stack_item(this, std::abs(x)));
+					VMBigInteger x = _evaluation_stack.pop().GetBigInteger();
+					NEOVM_PUSH_INTEGER(abs(x));
 				}
-				break;
-				case OpCode::OP_NOT:
+				NEOVM_NEXT();
+				NEOVM_CASE(NOT)
 				{
-					bool x = _evaluation_stack.pop()->GetBoolean();
-					_evaluation_stack.push_back(StackItem::to_stack_item(this, !x));
+					bool x = _evaluation_stack.pop().GetBoolean();
+					_evaluation_stack.push_back(StackValue::from_integer((int64_t)!x));
 				}
-				break;
-				case OpCode::OP_NZ:
+				NEOVM_NEXT();
+				NEOVM_CASE(NZ)
 				{
-					VMBigInteger x = _evaluation_stack.pop()->GetBigInteger();
-					_evaluation_stack.push_back(StackItem::to_stack_item_from_bool(this, x != 0));
+					VMBigInteger x = _evaluation_stack.pop().GetBigInteger();
+					_evaluation_stack.push_back(StackValue::from_bool(x != 0));
 				}
-				break;
-				case OpCode::OP_ADD:
+				NEOVM_NEXT();
+				NEOVM_CASE(ADD)
 				{
-					VMBigInteger x2 = _evaluation_stack.pop()->GetBigInteger();
-					VMBigInteger x1 = _evaluation_stack.pop()->GetBigInteger();
-					_evaluation_stack.push_back(StackItem::to_stack_item(this, x1 + x2));
+					VMBigInteger x2 = _evaluation_stack.pop().GetBigInteger();
+					VMBigInteger x1 = _evaluation_stack.pop().GetBigInteger();
+					NEOVM_PUSH_INTEGER(x1 + x2);
 				}
-				break;
-				case OpCode::OP_SUB:
+				NEOVM_NEXT();
+				NEOVM_CASE(SUB)
 				{
-					VMBigInteger x2 = _evaluation_stack.pop()->GetBigInteger();
-					VMBigInteger x1 = _evaluation_stack.pop()->GetBigInteger();
-					_evaluation_stack.push_back(StackItem::to_stack_item(this, x1 - x2));
+					VMBigInteger x2 = _evaluation_stack.pop().GetBigInteger();
+					VMBigInteger x1 = _evaluation_stack.pop().GetBigInteger();
+					NEOVM_PUSH_INTEGER(x1 - x2);
 				}
-				break;
-				case OpCode::OP_MUL:
+				NEOVM_NEXT();
+				NEOVM_CASE(MUL)
 				{
-					VMBigInteger x2 =_evaluation_stack.pop()->GetBigInteger();
-					VMBigInteger x1 = _evaluation_stack.pop()->GetBigInteger();
-					_evaluation_stack.push_back(StackItem::to_stack_item(this, x1 * x2));
+					VMBigInteger x2 = _evaluation_stack.pop().GetBigInteger();
+					VMBigInteger x1 = _evaluation_stack.pop().GetBigInteger();
+					NEOVM_PUSH_INTEGER(x1 * x2);
 				}
-				break;
-				case OpCode::OP_DIV:
+				NEOVM_NEXT();
+				NEOVM_CASE(DIV)
 				{
-					VMBigInteger x2 = _evaluation_stack.pop()->GetBigInteger();
-					VMBigInteger x1 = _evaluation_stack.pop()->GetBigInteger();
-					_evaluation_stack.push_back(StackItem::to_stack_item(this, x1 / x2));
+					VMBigInteger x2 = _evaluation_stack.pop().GetBigInteger();
+					if (x2 == 0)
+						NEOVM_FAULT(INVALID_OPERAND, "division by zero");
+					VMBigInteger x1 = _evaluation_stack.pop().GetBigInteger();
+					NEOVM_PUSH_INTEGER(x1 / x2);
 				}
-				break;
-				case OpCode::OP_MOD:
+				NEOVM_NEXT();
+				NEOVM_CASE(MOD)
 				{
-					VMBigInteger x2 = _evaluation_stack.pop()->GetBigInteger();
-					VMBigInteger x1 = _evaluation_stack.pop()->GetBigInteger();
-					_evaluation_stack.push_back(StackItem::to_stack_item(this, x1 % x2));
+					VMBigInteger x2 = _evaluation_stack.pop().GetBigInteger();
+					if (x2 == 0)
+						NEOVM_FAULT(INVALID_OPERAND, "division by zero");
+					VMBigInteger x1 = _evaluation_stack.pop().GetBigInteger();
+					NEOVM_PUSH_INTEGER(x1 % x2);
 				}
-				break;
-				case OpCode::OP_SHL:
+				NEOVM_NEXT();
+				NEOVM_CASE(SHL)
 				{
-					int n = (int)_evaluation_stack.pop()->GetBigInteger();
-					VMBigInteger x = _evaluation_stack.pop()->GetBigInteger();
-					_evaluation_stack.push_back(StackItem::to_stack_item(this, x << n));
+					int64_t n = _evaluation_stack.pop().GetInt64();
+					if (n < -NEOVM_MAX_SHIFT || n > NEOVM_MAX_SHIFT)
+						NEOVM_FAULT(INVALID_OPERAND, "shift out of range");
+					VMBigInteger x = _evaluation_stack.pop().GetBigInteger();
+					NEOVM_PUSH_INTEGER(x << (int)n);
 				}
-				break;
-				case OpCode::OP_SHR:
+				NEOVM_NEXT();
+				NEOVM_CASE(SHR)
 				{
-					int n = (int)_evaluation_stack.pop()->GetBigInteger();
-					VMBigInteger x = _evaluation_stack.pop()->GetBigInteger();
-					_evaluation_stack.push_back(StackItem::to_stack_item(this, x >> n));
+					int64_t n = _evaluation_stack.pop().GetInt64();
+					if (n < -NEOVM_MAX_SHIFT || n > NEOVM_MAX_SHIFT)
+						NEOVM_FAULT(INVALID_OPERAND, "shift out of range");
+					VMBigInteger x = _evaluation_stack.pop().GetBigInteger();
+					NEOVM_PUSH_INTEGER(x >> (int)n);
 				}
-				break;
-				case OpCode::OP_BOOLAND:
+				NEOVM_NEXT();
+				NEOVM_CASE(BOOLAND)
 				{
-					bool x2 = _evaluation_stack.pop()->GetBoolean();
-					bool x1 = _evaluation_stack.pop()->GetBoolean();
-					_evaluation_stack.push_back(StackItem::to_stack_item_from_bool(this, x1 && x2));
+					bool x2 = _evaluation_stack.pop().GetBoolean();
+					bool x1 = _evaluation_stack.pop().GetBoolean();
+					_evaluation_stack.push_back(StackValue::from_bool(x1 && x2));
 				}
-				break;
-				case OpCode::OP_BOOLOR:
+				NEOVM_NEXT();
+				NEOVM_CASE(BOOLOR)
 				{
-					bool x2 = _evaluation_stack.pop()->GetBoolean();
-					bool x1 = _evaluation_stack.pop()->GetBoolean();
-					_evaluation_stack.push_back(StackItem::to_stack_item_from_bool(this, x1 || x2));
+					bool x2 = _evaluation_stack.pop().GetBoolean();
+					bool x1 = _evaluation_stack.pop().GetBoolean();
+					_evaluation_stack.push_back(StackValue::from_bool(x1 || x2));
 				}
-				break;
-				case OpCode::OP_NUMEQUAL:
+				NEOVM_NEXT();
+				NEOVM_CASE(NUMEQUAL)
 				{
-					VMBigInteger x2 = _evaluation_stack.pop()->GetBigInteger();
-					VMBigInteger x1 = _evaluation_stack.pop()->GetBigInteger();
-					_evaluation_stack.push_back(StackItem::to_stack_item_from_bool(this, x1 == x2));
+					VMBigInteger x2 = _evaluation_stack.pop().GetBigInteger();
+					VMBigInteger x1 = _evaluation_stack.pop().GetBigInteger();
+					_evaluation_stack.push_back(StackValue::from_bool(x1 == x2));
 				}
-				break;
-				case OpCode::OP_NUMNOTEQUAL:
+				NEOVM_NEXT();
+				NEOVM_CASE(NUMNOTEQUAL)
 				{
-					VMBigInteger x2 = _evaluation_stack.pop()->GetBigInteger();
-					VMBigInteger x1 = _evaluation_stack.pop()->GetBigInteger();
-					_evaluation_stack.push_back(StackItem::to_stack_item_from_bool(this, x1 != x2));
+					VMBigInteger x2 = _evaluation_stack.pop().GetBigInteger();
+					VMBigInteger x1 = _evaluation_stack.pop().GetBigInteger();
+					_evaluation_stack.push_back(StackValue::from_bool(x1 != x2));
 				}
-				break;
-				case OpCode::OP_LT:
+				NEOVM_NEXT();
+				NEOVM_CASE(LT)
 				{
-					VMBigInteger x2 = _evaluation_stack.pop()->GetBigInteger();
-					VMBigInteger x1 = _evaluation_stack.pop()->GetBigInteger();
-					_evaluation_stack.push_back(StackItem::to_stack_item_from_bool(this, x1 < x2));
+					VMBigInteger x2 = _evaluation_stack.pop().GetBigInteger();
+					VMBigInteger x1 = _evaluation_stack.pop().GetBigInteger();
+					_evaluation_stack.push_back(StackValue::from_bool(x1 < x2));
 				}
-				break;
-				case OpCode::OP_GT:
+				NEOVM_NEXT();
+				NEOVM_CASE(GT)
 				{
-					VMBigInteger x2 = _evaluation_stack.pop()->GetBigInteger();
-					VMBigInteger x1 = _evaluation_stack.pop()->GetBigInteger();
-					_evaluation_stack.push_back(StackItem::to_stack_item_from_bool(this, x1 > x2));
+					VMBigInteger x2 = _evaluation_stack.pop().GetBigInteger();
+					VMBigInteger x1 = _evaluation_stack.pop().GetBigInteger();
+					_evaluation_stack.push_back(StackValue::from_bool(x1 > x2));
 				}
-				break;
-				case OpCode::OP_LTE:
+				NEOVM_NEXT();
+				NEOVM_CASE(LTE)
 				{
-					VMBigInteger x2 = _evaluation_stack.pop()->GetBigInteger();
-					VMBigInteger x1 = _evaluation_stack.pop()->GetBigInteger();
-					_evaluation_stack.push_back(StackItem::to_stack_item_from_bool(this, x1 <= x2));
+					VMBigInteger x2 = _evaluation_stack.pop().GetBigInteger();
+					VMBigInteger x1 = _evaluation_stack.pop().GetBigInteger();
+					_evaluation_stack.push_back(StackValue::from_bool(x1 <= x2));
 				}
-				break;
-				case OpCode::OP_GTE:
+				NEOVM_NEXT();
+				NEOVM_CASE(GTE)
 				{
-					VMBigInteger x2 = _evaluation_stack.pop()->GetBigInteger();
-					VMBigInteger x1 = _evaluation_stack.pop()->GetBigInteger();
-					_evaluation_stack.push_back(StackItem::to_stack_item_from_bool(this, x1 >= x2));
+					VMBigInteger x2 = _evaluation_stack.pop().GetBigInteger();
+					VMBigInteger x1 = _evaluation_stack.pop().GetBigInteger();
+					_evaluation_stack.push_back(StackValue::from_bool(x1 >= x2));
 				}
-				break;
-				case OpCode::OP_MIN:
+				NEOVM_NEXT();
+				NEOVM_CASE(MIN)
 				{
-					VMBigInteger x2 = _evaluation_stack.pop()->GetBigInteger();
-					VMBigInteger x1 = _evaluation_stack.pop()->GetBigInteger();
-					_evaluation_stack.push_back(StackItem::to_stack_item(this, x1 < x2 ? x1 : x2));
+					VMBigInteger x2 = _evaluation_stack.pop().GetBigInteger();
+					VMBigInteger x1 = _evaluation_stack.pop().GetBigInteger();
+					NEOVM_PUSH_INTEGER(x1 < x2 ? x1 : x2);
 				}
-				break;
-				case OpCode::OP_MAX:
+				NEOVM_NEXT();
+				NEOVM_CASE(MAX)
 				{
-					VMBigInteger x2 = _evaluation_stack.pop()->GetBigInteger();
-					VMBigInteger x1 = _evaluation_stack.pop()->GetBigInteger();
-					_evaluation_stack.push_back(StackItem::to_stack_item(this, x1 < x2 ? x2 : x1));
+					VMBigInteger x2 = _evaluation_stack.pop().GetBigInteger();
+					VMBigInteger x1 = _evaluation_stack.pop().GetBigInteger();
+					NEOVM_PUSH_INTEGER(x1 < x2 ? x2 : x1);
 				}
-				break;
-				case OpCode::OP_WITHIN:
+				NEOVM_NEXT();
+				NEOVM_CASE(WITHIN)
 				{
-					VMBigInteger b = _evaluation_stack.pop()->GetBigInteger();
-					VMBigInteger a = _evaluation_stack.pop()->GetBigInteger();
-					VMBigInteger x = _evaluation_stack.pop()->GetBigInteger();
-					_evaluation_stack.push_back(StackItem::to_stack_item_from_bool(this, a <= x && x < b));
+					VMBigInteger b = _evaluation_stack.pop().GetBigInteger();
+					VMBigInteger a = _evaluation_stack.pop().GetBigInteger();
+					VMBigInteger x = _evaluation_stack.pop().GetBigInteger();
+					_evaluation_stack.push_back(StackValue::from_bool(a <= x && x < b));
 				}
-				break;
+				NEOVM_NEXT();
 
-				/* TODO
 				// Crypto
-				case OpCode::SHA1:
-				using (SHA1 sha = SHA1.Create())
-				{
-				byte[] x = Helper::pop(_evaluation_stack)->GetByteArray();
-				_evaluation_stack.push_back(sha.ComputeHash(x));
-				}
-				break;
-				case OpCode::SHA256:
-				using (SHA256 sha = SHA256.Create())
-				{
-				byte[] x = Helper::pop(_evaluation_stack)->GetByteArray();
-				_evaluation_stack.push_back(sha.ComputeHash(x));
-				}
-				break;
-				case OpCode::HASH160:
-				{
-				byte[] x = Helper::pop(_evaluation_stack)->GetByteArray();
-				_evaluation_stack.push_back(Crypto.Hash160(x));
-				}
-				break;
-				case OpCode::HASH256:
-				{
-				byte[] x = Helper::pop(_evaluation_stack)->GetByteArray();
-				_evaluation_stack.push_back(Crypto.Hash256(x));
-				}
-				break;
-				case OpCode::CHECKSIG:
-				{
-				byte[] pubkey = Helper::pop(_evaluation_stack)->GetByteArray();
-				byte[] signature = Helper::pop(_evaluation_stack)->GetByteArray();
-				try
-				{
-				_evaluation_stack.push_back(Crypto.VerifySignature(ScriptContainer.GetMessage(), signature, pubkey));
-				}
-				catch (ArgumentException)
-				{
-				_evaluation_stack.push_back(false);
-				}
-				}
-				break;
-				case OpCode::CHECKMULTISIG:
-				{
-				int n = (int)Helper::pop(_evaluation_stack)->GetBigInteger();
-				if (n < 1)
-				{
-				union_change_state(VMState::FAULT);
-				return;
-				}
-				byte[][] pubkeys = new byte[n][];
-				for (int i = 0; i < n; i++)
-				pubkeys[i] = Helper::pop(_evaluation_stack)->GetByteArray();
-				int m = (int)Helper::pop(_evaluation_stack)->GetBigInteger();
-				if (m < 1 || m > n)
-				{
-				union_change_state(VMState::FAULT);
-				return;
-				}
-				byte[][] signatures = new byte[m][];
-				for (int i = 0; i < m; i++)
-				signatures[i] = Helper::pop(_evaluation_stack)->GetByteArray();
-				byte[] message = ScriptContainer.GetMessage();
-				bool fSuccess = true;
-				try
-				{
-				for (int i = 0, j = 0; fSuccess && i < m && j < n;)
-				{
-				if (Crypto.VerifySignature(message, signatures[i], pubkeys[j]))
-				i++;
-				j++;
-				if (m - i > n - j)
-				fSuccess = false;
-				}
-				}
-				catch (ArgumentException)
-				{
-				fSuccess = false;
-				}
-				_evaluation_stack.push_back(fSuccess);
+#define NEOVM_HASH_OP(name, hash_function, digest_size) \
+				NEOVM_CASE(name) \
+				{ \
+					auto x = _evaluation_stack.pop(); \
+					std::vector<char> digest(digest_size); \
+					if (x.type() == StackItemType::SIT_BYTE_ARRAY) \
+					{ \
+						auto span = ((ByteArray*)x.item())->span(); \
+						hash_function(span.data, span.size, digest.data()); \
+					} \
+					else \
+					{ \
+						auto bytes = x.GetByteArray(); \
+						hash_function(bytes.data(), bytes.size(), digest.data()); \
+					} \
+					_evaluation_stack.push_back(StackItem::to_stack_item(this, std::move(digest))); \
+				} \
+				NEOVM_NEXT();
+
+				NEOVM_HASH_OP(SHA1, sha1, NEOVM_SHA1_SIZE)
+				NEOVM_HASH_OP(SHA256, sha256, NEOVM_SHA256_SIZE)
+				NEOVM_HASH_OP(HASH160, hash160, NEOVM_HASH160_SIZE)
+				NEOVM_HASH_OP(HASH256, hash256, NEOVM_HASH256_SIZE)
+#undef NEOVM_HASH_OP
+				NEOVM_CASE(CHECKSIG)
+				{
+					auto pubkey = _evaluation_stack.pop().GetByteArray();
+					auto signature = _evaluation_stack.pop().GetByteArray();
+					if (!_script_container || !_crypto)
+						NEOVM_FAULT(INVALID_OPERAND, "no script container or crypto to check signatures");
+					_evaluation_stack.push_back(StackValue::from_bool(_crypto->VerifySignature(_script_container->get_message(), std::move(signature), std::move(pubkey))));
+				}
+				NEOVM_NEXT();
+				NEOVM_CASE(CHECKMULTISIG)
+				{
+					// pubkeys then signatures, each either an array or a count followed by that many items
+					std::vector<std::vector<char>> keys[2];
+					for (int list = 0; list < 2; list++)
+					{
+						if (_evaluation_stack.size() == 0)
+							NEOVM_FAULT(STACK_UNDERFLOW, "stack underflow");
+						auto top = _evaluation_stack.pop();
+						if (top.IsArray())
+						{
+							for (auto element : *top.item()->GetArray())
+								keys[list].push_back(element->GetByteArray());
+							if (keys[list].empty())
+								NEOVM_FAULT(INVALID_OPERAND, "empty pubkey or signature array");
+							continue;
+						}
+						int64_t count = top.GetInt64();
+						if (count < 1 || count > (int64_t)_evaluation_stack.size())
+							NEOVM_FAULT(INVALID_OPERAND, "count out of range");
+						keys[list].reserve((size_t)count);
+						for (int64_t i = 0; i < count; i++)
+							keys[list].push_back(_evaluation_stack.pop().GetByteArray());
+					}
+					auto &pubkeys = keys[0];
+					auto &signatures = keys[1];
+					size_t n = pubkeys.size();
+					size_t m = signatures.size();
+					if (m > n)
+						NEOVM_FAULT(INVALID_OPERAND, "more signatures than pubkeys");
+					if (!_script_container || !_crypto)
+						NEOVM_FAULT(INVALID_OPERAND, "no script container or crypto to check signatures");
+					// like NEO the opcode price is per pubkey, the block charged it once
+					NEOVM_CHARGE_GAS(_gas_costs->opcode_cost(OpCode::OP_CHECKMULTISIG) * (int64_t)(n - 1));
+					// signatures match pubkeys in order like NEO's serial walk. every round checks the current signature against a window
+					// of the keys it can still match in one batch, the window only reaches past the first match as far as the spare
+					// checks allow, so at most n + m signatures are verified in all
+					auto message = _script_container->get_message();
+					std::vector<SignatureCheck> checks;
+					std::unique_ptr<bool[]> verified(new bool[n]);
+					size_t spare = m;
+					bool success = true;
+					for (size_t i = 0, j = 0; success && i < m;)
+					{
+						size_t window = std::min(n - (m - i) - j + 1, spare + 1);
+						checks.resize(window);
+						for (size_t k = 0; k < window; k++)
+							checks[k] = SignatureCheck{ &message, &signatures[i], &pubkeys[j + k] };
+						_crypto->VerifySignatures(checks, verified.get());
+						size_t k = 0;
+						while (k < window && !verified[k])
+							k++;
+						if (k < window)
+						{
+							spare -= window - k - 1;
+							i++;
+							j += k + 1;
+						}
+						else
+						{
+							j += window;
+							if (m - i > n - j)
+								success = false;
+						}
+					}
+					_evaluation_stack.push_back(StackValue::from_bool(success));
 				}
-				break;
-				*/
+				NEOVM_NEXT();
 
 				// Array
-				case OpCode::OP_ARRAYSIZE:
+				NEOVM_CASE(ARRAYSIZE)
 				{
 					auto item = _evaluation_stack.pop();
-					if (!item->IsArray())
-						_evaluation_stack.push_back(StackItem::to_stack_item(this, item->GetByteArray().size()));
+					if (item.IsArray())
+						_evaluation_stack.push_back(StackValue::from_integer((int64_t)item.item()->GetArray()->size()));
+					else if (item.is_map())
+						_evaluation_stack.push_back(StackValue::from_integer((int64_t)((Map*)item.item())->count()));
 					else
-						_evaluation_stack.push_back(StackItem::to_stack_item(this, item->GetArray()->size()));
+						_evaluation_stack.push_back(StackValue::from_integer((int64_t)item.GetByteArray().size()));
 				}
-				break;
-				case OpCode::OP_PACK:
+				NEOVM_NEXT();
+				NEOVM_CASE(PACK)
 				{
-					int size = (int)_evaluation_stack.pop()->GetBigInteger();
+					int size = (int)_evaluation_stack.pop().GetInt64();
 					if (size < 0 || size > _evaluation_stack.size())
-					{
-						union_change_state(VMState::FAULT);
-						return;
-					}
+						NEOVM_FAULT(INVALID_OPERAND, "count out of range");
 					std::vector<StackItem*> items(size);
 					for (int i = 0; i < size; i++)
-						items[i] = _evaluation_stack.pop();
+						items[i] = _evaluation_stack.pop().to_stack_item(this);
 					_evaluation_stack.push_back(StackItem::to_stack_item(this, items));
 				}
-				break;
-				case OpCode::OP_UNPACK:
+				NEOVM_NEXT();
+				NEOVM_CASE(UNPACK)
 				{
 					auto item = _evaluation_stack.pop();
-					if (!item->IsArray())
-					{
-						union_change_state(VMState::FAULT);
-						return;
-					}
-					auto items = item->GetArray();
+					if (!item.IsArray())
+						NEOVM_FAULT(INVALID_OPERAND, "not an array");
+					auto items = item.item()->GetArray();
 					for (int i = items->size() - 1; i >= 0; i--)
 						_evaluation_stack.push_back((*items)[i]);
-					_evaluation_stack.push_back(StackItem::to_stack_item(this, items->size()));
+					_evaluation_stack.push_back(StackValue::from_integer((int64_t)items->size()));
 				}
-				break;
-				case OpCode::OP_PICKITEM:
+				NEOVM_NEXT();
+				NEOVM_CASE(PICKITEM)
 				{
-					int index = (int)_evaluation_stack.pop()->GetBigInteger();
-					if (index < 0)
-					{
-						union_change_state(VMState::FAULT);
-						return;
-					}
+					auto key = _evaluation_stack.pop();
 					auto item = _evaluation_stack.pop();
-					if (!item->IsArray())
+					if (item.is_map())
 					{
-						union_change_state(VMState::FAULT);
-						return;
+						if (!Map::is_valid_key(key))
+							NEOVM_FAULT(INVALID_OPERAND, "invalid map key");
+						auto value = ((Map*)item.item())->get(key);
+						if (!value)
+							NEOVM_FAULT(INVALID_OPERAND, "key not found in map");
+						_evaluation_stack.push_back(value);
+						NEOVM_NEXT();
 					}
-					auto items = item->GetArray();
+					int index = (int)key.GetInt64();
+					if (index < 0)
+						NEOVM_FAULT(INVALID_OPERAND, "index out of range");
+					if (!item.IsArray())
+						NEOVM_FAULT(INVALID_OPERAND, "not an array");
+					auto items = item.item()->GetArray();
 					if (index >= items->size())
-					{
-						union_change_state(VMState::FAULT);
-						return;
-					}
+						NEOVM_FAULT(INVALID_OPERAND, "index out of range");
 					_evaluation_stack.push_back((*items)[index]);
 				}
-				break;
-				case OpCode::OP_SETITEM:
+				NEOVM_NEXT();
+				NEOVM_CASE(SETITEM)
 				{
-					auto newItem = _evaluation_stack.pop();
+					auto newItem = _evaluation_stack.pop().to_stack_item(this);
 					if (newItem->IsStruct())
 					{
 						newItem = ((Struct*)newItem)->Clone(this);
 					}
-					int index = (int)_evaluation_stack.pop()->GetBigInteger();
+					auto key = _evaluation_stack.pop();
 					auto arrItem = _evaluation_stack.pop();
-					if (!arrItem->IsArray())
+					if (arrItem.is_map())
 					{
-						union_change_state(VMState::FAULT);
-						return;
+						if (!Map::is_valid_key(key))
+							NEOVM_FAULT(INVALID_OPERAND, "invalid map key");
+						((Map*)arrItem.item())->put(this, key, newItem);
+						NEOVM_NEXT();
 					}
-					auto items = arrItem->GetArray();
+					int index = (int)key.GetInt64();
+					if (!arrItem.IsArray())
+						NEOVM_FAULT(INVALID_OPERAND, "not an array");
+					auto items = arrItem.item()->GetArray();
 					if (index < 0 || index >= items->size())
-					{
-						union_change_state(VMState::FAULT);
-						return;
-					}
+						NEOVM_FAULT(INVALID_OPERAND, "index out of range");
 					(*items)[index] = newItem;
 				}
-				break;
-				case OpCode::OP_NEWARRAY:
+				NEOVM_NEXT();
+				NEOVM_CASE(NEWARRAY)
 				{
-					int count = (int)_evaluation_stack.pop()->GetBigInteger();
+					int count = (int)_evaluation_stack.pop().GetInt64();
+					if (count < 0 || count > NEOVM_MAX_STACK_SIZE)
+						NEOVM_FAULT(INVALID_OPERAND, "count out of range");
 					std::vector<StackItem*> items(count);
 					for (auto i = 0; i < count; i++)
 					{
@@ -1004,47 +1316,126 @@ namespace neo
 					}
 					_evaluation_stack.push_back(StackItem::to_stack_item(this, items));
 				}
-				break;
-				case OpCode::OP_NEWSTRUCT:
+				NEOVM_NEXT();
+				NEOVM_CASE(NEWSTRUCT)
 				{
-					int count = (int)_evaluation_stack.pop()->GetBigInteger();
+					int count = (int)_evaluation_stack.pop().GetInt64();
+					if (count < 0 || count > NEOVM_MAX_STACK_SIZE)
+						NEOVM_FAULT(INVALID_OPERAND, "count out of range");
 					std::vector<StackItem*> items(count);
 					for (auto i = 0; i < count; i++)
 					{
-						items[i] = false;
+						items[i] = StackItem::to_stack_item_from_bool(this, false);
 					}
 					_evaluation_stack.push_back(StackItem::to_stack_struct_item(this, items));
 				}
-				break;
-				// Exceptions
-				case OpCode::OP_THROW:
+				NEOVM_NEXT();
+				NEOVM_CASE(NEWMAP)
+					_evaluation_stack.push_back(StackItem::to_stack_map_item(this));
+				NEOVM_NEXT();
+				NEOVM_CASE(REMOVE)
+				{
+					auto key = _evaluation_stack.pop();
+					auto item = _evaluation_stack.pop();
+					if (item.is_map())
+					{
+						if (!Map::is_valid_key(key))
+							NEOVM_FAULT(INVALID_OPERAND, "invalid map key");
+						((Map*)item.item())->remove(key);
+						NEOVM_NEXT();
+					}
+					if (!item.IsArray())
+						NEOVM_FAULT(INVALID_OPERAND, "not an array or map");
+					auto items = item.item()->GetArray();
+					int64_t index = key.GetInt64();
+					if (index < 0 || index >= (int64_t)items->size())
+						NEOVM_FAULT(INVALID_OPERAND, "index out of range");
+					items->erase(items->begin() + index);
+				}
+				NEOVM_NEXT();
+				NEOVM_CASE(HASKEY)
+				{
+					auto key = _evaluation_stack.pop();
+					auto item = _evaluation_stack.pop();
+					if (item.is_map())
+					{
+						if (!Map::is_valid_key(key))
+							NEOVM_FAULT(INVALID_OPERAND, "invalid map key");
+						_evaluation_stack.push_back(StackValue::from_bool(((Map*)item.item())->contains_key(key)));
+						NEOVM_NEXT();
+					}
+					if (!item.IsArray())
+						NEOVM_FAULT(INVALID_OPERAND, "not an array or map");
+					int64_t index = key.GetInt64();
+					if (index < 0)
+						NEOVM_FAULT(INVALID_OPERAND, "index out of range");
+					_evaluation_stack.push_back(StackValue::from_bool(index < (int64_t)item.item()->GetArray()->size()));
+				}
+				NEOVM_NEXT();
+				NEOVM_CASE(KEYS)
 				{
-					union_change_state(VMState::FAULT);
-					return;
+					auto item = _evaluation_stack.pop();
+					if (!item.is_map())
+						NEOVM_FAULT(INVALID_OPERAND, "not a map");
+					// the result is a new array, it must not see later changes of the map
+					std::vector<StackItem*> no_items;
+					auto keys = StackItem::to_stack_item(this, no_items);
+					((Map*)item.item())->keys(keys->GetArray());
+					_evaluation_stack.push_back(keys);
 				}
-				case OpCode::OP_THROWIFNOT:
+				NEOVM_NEXT();
+				NEOVM_CASE(VALUES)
 				{
-					if (!_evaluation_stack.pop()->GetBoolean())
+					auto item = _evaluation_stack.pop();
+					std::vector<StackItem*> no_items;
+					auto values = StackItem::to_stack_item(this, no_items);
+					auto result = values->GetArray();
+					if (item.is_map())
+						((Map*)item.item())->values(result);
+					else if (item.IsArray())
+						result->assign(item.item()->GetArray()->begin(), item.item()->GetArray()->end());
+					else
+						NEOVM_FAULT(INVALID_OPERAND, "not an array or map");
+					// structs are values, the result gets copies of them
+					for (auto &value : *result)
 					{
-						union_change_state(VMState::FAULT);
-						return;
+						if (value->IsStruct())
+							value = ((Struct*)value)->Clone(this);
 					}
+					_evaluation_stack.push_back(values);
 				}
-					break;
+				NEOVM_NEXT();
 
-				default:
+				// Exceptions
+				NEOVM_CASE(THROW)
+					NEOVM_FAULT(SCRIPT_THROW, "OP_THROW");
+				NEOVM_CASE(THROWIFNOT)
 				{
-					union_change_state(VMState::FAULT);
-					throw NeoVmException(std::string("unknown instruction op ") + op_code_to_str(opcode), ErrorCode::UNKNOWN_INSTRUCTION_OP);
-					return;
+					if (!_evaluation_stack.pop().GetBoolean())
+						NEOVM_FAULT(SCRIPT_THROW, "OP_THROWIFNOT");
 				}
-				}
-			}
-			if (!Helper::enum_has_flag(_state, VMState::FAULT) && _invocation_stack.size() > 0)
-			{
-				if (current_context()->break_points()->find((uint64_t)current_context()->get_instruction_pointer()) != current_context()->break_points()->end())
-					union_change_state(VMState::BREAK);
+				NEOVM_NEXT();
+
+				NEOVM_CASE(UNKNOWN)
+					NEOVM_FAULT(UNKNOWN_INSTRUCTION_OP, "unknown instruction op");
+				NEOVM_CASE(BADOPERAND)
+					NEOVM_FAULT(BAD_SCRIPT, "not enough binary data to read");
+#ifndef NEOVM_THREADED_DISPATCH
+				}
+			end_of_instruction:
+				NEOVM_END_OF_INSTRUCTION();
 			}
+#endif
+
+#undef NEOVM_FAULT
+#undef NEOVM_RELOAD_CONTEXT
+#undef NEOVM_CHARGE_GAS
+#undef NEOVM_PUSH_INTEGER
+#undef NEOVM_FETCH
+#undef NEOVM_END_OF_INSTRUCTION
+#undef NEOVM_CASE
+#undef NEOVM_DISPATCH
+#undef NEOVM_NEXT
 		}
 
 		StackItem* ExecutionEngine::execute_script(std::string script_id, std::vector<StackItem*> args, bool has_return)
@@ -1076,9 +1467,9 @@ namespace neo
 
 			this->load_script(sbData, Helper::string_content_to_chars("script_loader"), false);
 			this->execute();
-			if (has_return && this->evaluation_stack()->size() > 0)
+			if (has_return && !Helper::enum_has_flag(_state, VMState::FAULT) && this->evaluation_stack()->size() > 0)
 			{
-				return this->evaluation_stack()->pop();
+				return this->evaluation_stack()->pop().to_stack_item(this);
 			}
 			else
 				return nullptr;
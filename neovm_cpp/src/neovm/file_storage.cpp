@@ -0,0 +1,921 @@
+#include <neovm/file_storage.hpp>
+#include <neovm/exceptions.hpp>
+
+#include <algorithm>
+#include <random>
+#include <string.h>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace neo
+{
+	namespace vm
+	{
+#ifdef _WIN32
+		MappedFile::MappedFile(const std::string &path)
+			: _path(path), _handle(0), _mapping(0), _data(nullptr), _size(0)
+		{
+			auto handle = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+			if (handle == INVALID_HANDLE_VALUE)
+				throw NeoVmException("can't open " + path);
+			_handle = (intptr_t)handle;
+			LARGE_INTEGER size;
+			if (!GetFileSizeEx(handle, &size))
+			{
+				CloseHandle(handle);
+				throw NeoVmException("can't read the size of " + path);
+			}
+			_size = (uint64_t)size.QuadPart;
+			try
+			{
+				map();
+			}
+			catch (...)
+			{
+				CloseHandle(handle);
+				throw;
+			}
+		}
+
+		MappedFile::~MappedFile()
+		{
+			unmap();
+			CloseHandle((HANDLE)_handle);
+		}
+
+		void MappedFile::map()
+		{
+			if (_size == 0)
+				return;
+			auto mapping = CreateFileMappingA((HANDLE)_handle, NULL, PAGE_READONLY, 0, 0, NULL);
+			if (!mapping)
+				throw NeoVmException("can't map " + _path);
+			auto data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+			if (!data)
+			{
+				CloseHandle(mapping);
+				throw NeoVmException("can't map " + _path);
+			}
+			_mapping = (intptr_t)mapping;
+			_data = (char*)data;
+		}
+
+		void MappedFile::unmap()
+		{
+			if (!_data)
+				return;
+			UnmapViewOfFile(_data);
+			CloseHandle((HANDLE)_mapping);
+			_data = nullptr;
+			_mapping = 0;
+		}
+
+		void MappedFile::resize(uint64_t size)
+		{
+			// windows can't change the size of a mapped file
+			unmap();
+			LARGE_INTEGER end;
+			end.QuadPart = (LONGLONG)size;
+			if (!SetFilePointerEx((HANDLE)_handle, end, NULL, FILE_BEGIN) || !SetEndOfFile((HANDLE)_handle))
+			{
+				map();
+				throw NeoVmException("can't resize " + _path);
+			}
+			_size = size;
+			map();
+		}
+
+		void MappedFile::write(uint64_t offset, const char *data, size_t size)
+		{
+			while (size > 0)
+			{
+				OVERLAPPED position = {};
+				position.Offset = (DWORD)offset;
+				position.OffsetHigh = (DWORD)(offset >> 32);
+				DWORD written = 0;
+				if (!WriteFile((HANDLE)_handle, data, (DWORD)std::min<size_t>(size, 1 << 30), &written, &position) || written == 0)
+					throw NeoVmException("can't write " + _path);
+				offset += written;
+				data += written;
+				size -= written;
+			}
+		}
+
+		void MappedFile::sync()
+		{
+			if (!FlushFileBuffers((HANDLE)_handle))
+				throw NeoVmException("can't sync " + _path);
+		}
+#else
+		MappedFile::MappedFile(const std::string &path)
+			: _path(path), _handle(-1), _mapping(0), _data(nullptr), _size(0)
+		{
+			auto fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+			if (fd < 0)
+				throw NeoVmException("can't open " + path);
+			_handle = fd;
+			struct stat status;
+			if (fstat(fd, &status) != 0)
+			{
+				::close(fd);
+				throw NeoVmException("can't read the size of " + path);
+			}
+			_size = (uint64_t)status.st_size;
+			try
+			{
+				map();
+			}
+			catch (...)
+			{
+				::close(fd);
+				throw;
+			}
+		}
+
+		MappedFile::~MappedFile()
+		{
+			unmap();
+			::close((int)_handle);
+		}
+
+		void MappedFile::map()
+		{
+			if (_size == 0)
+				return;
+			auto data = mmap(nullptr, (size_t)_size, PROT_READ, MAP_SHARED, (int)_handle, 0);
+			if (data == MAP_FAILED)
+				throw NeoVmException("can't map " + _path);
+			_data = (char*)data;
+		}
+
+		void MappedFile::unmap()
+		{
+			if (!_data)
+				return;
+			munmap(_data, (size_t)_size);
+			_data = nullptr;
+		}
+
+		void MappedFile::resize(uint64_t size)
+		{
+			unmap();
+			if (ftruncate((int)_handle, (off_t)size) != 0)
+			{
+				map();
+				throw NeoVmException("can't resize " + _path);
+			}
+			_size = size;
+			map();
+		}
+
+		void MappedFile::write(uint64_t offset, const char *data, size_t size)
+		{
+			while (size > 0)
+			{
+				auto written = pwrite((int)_handle, data, size, (off_t)offset);
+				if (written <= 0)
+					throw NeoVmException("can't write " + _path);
+				offset += written;
+				data += written;
+				size -= written;
+			}
+		}
+
+		void MappedFile::sync()
+		{
+			if (fsync((int)_handle) != 0)
+				throw NeoVmException("can't sync " + _path);
+		}
+#endif
+
+		BloomFilter::BloomFilter(size_t keys)
+			: _block_mask(0)
+		{
+			reset(keys);
+		}
+
+		void BloomFilter::reset(size_t keys)
+		{
+			uint64_t blocks = 1;
+			while (blocks * 512 < (uint64_t)keys * NEOVM_STORAGE_BLOOM_BITS_PER_KEY)
+				blocks <<= 1;
+			_words.assign((size_t)blocks * 8, 0);
+			_block_mask = blocks - 1;
+		}
+
+		// the high half of the hash picks a block of 512 bits, 9 bit pieces of the hash times an odd constant 7 bits in it
+		void BloomFilter::add(uint64_t hash)
+		{
+			auto block = &_words[(size_t)((hash >> 32) & _block_mask) * 8];
+			auto bits = hash * 0x9E3779B97F4A7C15ULL;
+			for (int i = 0; i < 7; i++)
+			{
+				auto bit = (bits >> (9 * i)) & 511;
+				block[bit >> 6] |= (uint64_t)1 << (bit & 63);
+			}
+		}
+
+		bool BloomFilter::may_contain(uint64_t hash) const
+		{
+			auto block = &_words[(size_t)((hash >> 32) & _block_mask) * 8];
+			auto bits = hash * 0x9E3779B97F4A7C15ULL;
+			for (int i = 0; i < 7; i++)
+			{
+				auto bit = (bits >> (9 * i)) & 511;
+				if (!(block[bit >> 6] & ((uint64_t)1 << (bit & 63))))
+					return false;
+			}
+			return true;
+		}
+
+		namespace
+		{
+			// the bytes an entry is charged, with a guess of the list and index nodes
+			inline size_t cache_entry_bytes(const std::string &key, const std::vector<char> &value)
+			{
+				return key.size() + value.size() + 96;
+			}
+		}
+
+		StorageCache::StorageCache(size_t max_bytes)
+			: _shards(new Shard[NEOVM_STORAGE_CACHE_SHARDS]), _shard_bytes(max_bytes / NEOVM_STORAGE_CACHE_SHARDS)
+		{
+			for (size_t i = 0; i < NEOVM_STORAGE_CACHE_SHARDS; i++)
+				_shards[i].bytes = 0;
+		}
+
+		bool StorageCache::get(uint64_t hash, const std::string &key, std::vector<char> *value)
+		{
+			if (_shard_bytes == 0)
+				return false;
+			auto &shard = shard_of(hash);
+			std::lock_guard<std::mutex> lock(shard.mutex);
+			auto found = shard.index.find(key);
+			if (found == shard.index.end())
+				return false;
+			shard.entries.splice(shard.entries.begin(), shard.entries, found->second);
+			*value = found->second->second;
+			return true;
+		}
+
+		void StorageCache::put(uint64_t hash, const std::string &key, const std::vector<char> &value)
+		{
+			if (cache_entry_bytes(key, value) > _shard_bytes)
+			{
+				remove(hash, key);
+				return;
+			}
+			auto &shard = shard_of(hash);
+			std::lock_guard<std::mutex> lock(shard.mutex);
+			auto found = shard.index.find(key);
+			if (found != shard.index.end())
+			{
+				shard.bytes -= cache_entry_bytes(key, found->second->second);
+				found->second->second = value;
+				shard.entries.splice(shard.entries.begin(), shard.entries, found->second);
+			}
+			else
+			{
+				shard.entries.emplace_front(key, value);
+				shard.index[key] = shard.entries.begin();
+			}
+			shard.bytes += cache_entry_bytes(key, value);
+			while (shard.bytes > _shard_bytes)
+			{
+				auto &last = shard.entries.back();
+				shard.bytes -= cache_entry_bytes(last.first, last.second);
+				shard.index.erase(last.first);
+				shard.entries.pop_back();
+			}
+		}
+
+		void StorageCache::remove(uint64_t hash, const std::string &key)
+		{
+			if (_shard_bytes == 0)
+				return;
+			auto &shard = shard_of(hash);
+			std::lock_guard<std::mutex> lock(shard.mutex);
+			auto found = shard.index.find(key);
+			if (found == shard.index.end())
+				return;
+			shard.bytes -= cache_entry_bytes(key, found->second->second);
+			shard.entries.erase(found->second);
+			shard.index.erase(found);
+		}
+
+		void StorageCache::clear()
+		{
+			for (size_t i = 0; i < NEOVM_STORAGE_CACHE_SHARDS; i++)
+			{
+				auto &shard = _shards[i];
+				std::lock_guard<std::mutex> lock(shard.mutex);
+				shard.index.clear();
+				shard.entries.clear();
+				shard.bytes = 0;
+			}
+		}
+
+		// the file is an array of pages with all numbers in native byte order, little-endian on every supported target.
+		// page 0 is the header. a bucket page starts with the next page of the bucket and the bytes used by records,
+		// followed by the records: key hash, key size, flags and value size, then the key and the value, or the first page
+		// of the value when it is in blob pages. a blob page starts with the next page of its value, a directory page with
+		// the next directory page and the number of bucket entries in it, and a free page with the next free page.
+		// the journal is the magic, the page size, the number of pages, every page number followed by the page, and a
+		// checksum of all of it
+		namespace
+		{
+			const char FILE_MAGIC[8] = { 'N', 'E', 'O', 'V', 'M', 'K', 'V', 'S' };
+			const char JOURNAL_MAGIC[8] = { 'N', 'E', 'O', 'V', 'M', 'J', 'N', 'L' };
+			const uint32_t FILE_VERSION = 1;
+			const uint64_t JOURNAL_CHECKSUM_KEY[2] = { 0, 0 };
+
+			const size_t PAGE_BYTES = NEOVM_STORAGE_PAGE_SIZE;
+			const size_t BUCKET_HEADER_SIZE = 8;
+			const size_t BUCKET_CAPACITY = PAGE_BYTES - BUCKET_HEADER_SIZE;
+			const size_t RECORD_HEADER_SIZE = 16;
+			const uint16_t RECORD_BLOB = 1;
+			const size_t BLOB_CAPACITY = PAGE_BYTES - 4;
+			const size_t DIRECTORY_CAPACITY = (PAGE_BYTES - 8) / 4;
+			const size_t JOURNAL_HEADER_SIZE = 16;
+
+			static_assert(NEOVM_STORAGE_PAGE_SIZE >= 2048 && NEOVM_STORAGE_PAGE_SIZE <= 65536, "the bytes used in a bucket page are 16 bits");
+
+			template <typename T>
+			inline T load(const char *data)
+			{
+				T value;
+				memcpy(&value, data, sizeof(T));
+				return value;
+			}
+
+			template <typename T>
+			inline void store(char *data, T value)
+			{
+				memcpy(data, &value, sizeof(T));
+			}
+
+			inline size_t record_size(const char *record)
+			{
+				return RECORD_HEADER_SIZE + load<uint16_t>(record + 8) + ((load<uint16_t>(record + 10) & RECORD_BLOB) ? 4 : load<uint32_t>(record + 12));
+			}
+
+			inline uint64_t rotl(uint64_t x, int bits)
+			{
+				return (x << bits) | (x >> (64 - bits));
+			}
+
+			inline void sip_round(uint64_t &v0, uint64_t &v1, uint64_t &v2, uint64_t &v3)
+			{
+				v0 += v1; v1 = rotl(v1, 13); v1 ^= v0; v0 = rotl(v0, 32);
+				v2 += v3; v3 = rotl(v3, 16); v3 ^= v2;
+				v0 += v3; v3 = rotl(v3, 21); v3 ^= v0;
+				v2 += v1; v1 = rotl(v1, 17); v1 ^= v2; v2 = rotl(v2, 32);
+			}
+
+			// SipHash-1-3
+			uint64_t siphash(const uint64_t key[2], const char *data, size_t size)
+			{
+				uint64_t v0 = 0x736f6d6570736575ULL ^ key[0];
+				uint64_t v1 = 0x646f72616e646f6dULL ^ key[1];
+				uint64_t v2 = 0x6c7967656e657261ULL ^ key[0];
+				uint64_t v3 = 0x7465646279746573ULL ^ key[1];
+				auto end = data + (size & ~(size_t)7);
+				for (; data != end; data += 8)
+				{
+					auto m = load<uint64_t>(data);
+					v3 ^= m;
+					sip_round(v0, v1, v2, v3);
+					v0 ^= m;
+				}
+				auto last = (uint64_t)size << 56;
+				for (size_t i = 0; i < (size & 7); i++)
+					last |= (uint64_t)(uint8_t)data[i] << (8 * i);
+				v3 ^= last;
+				sip_round(v0, v1, v2, v3);
+				v0 ^= last;
+				v2 ^= 0xFF;
+				sip_round(v0, v1, v2, v3);
+				sip_round(v0, v1, v2, v3);
+				sip_round(v0, v1, v2, v3);
+				return v0 ^ v1 ^ v2 ^ v3;
+			}
+		}
+
+		FileStorage::FileStorage(const std::string &path, size_t cache_size)
+			: _file(path), _journal(path + "-journal"), _page_count(0), _free_page(0), _record_count(0), _record_bytes(0),
+			_level(0), _split(0), _directory_page(0), _saved_buckets(0), _bloom_capacity(0), _bloom_keys(0), _bloom_rebuilt(false),
+			_cache(cache_size)
+		{
+			recover();
+			if (_file.size() == 0)
+				create();
+			else
+				load_header();
+			rebuild_bloom();
+			_bloom_rebuilt = false;
+		}
+
+		void FileStorage::recover()
+		{
+			auto size = _journal.size();
+			if (size == 0)
+				return;
+			auto data = _journal.data();
+			uint64_t count = size >= JOURNAL_HEADER_SIZE ? load<uint32_t>(data + 12) : 0;
+			auto journal_size = JOURNAL_HEADER_SIZE + count * (4 + PAGE_BYTES);
+			// a journal cut short by a crash is thrown away, the file wasn't written yet
+			if (size >= journal_size + 8 && memcmp(data, JOURNAL_MAGIC, 8) == 0 && load<uint32_t>(data + 8) == PAGE_BYTES
+				&& load<uint64_t>(data + journal_size) == siphash(JOURNAL_CHECKSUM_KEY, data, (size_t)journal_size))
+			{
+				auto file_size = _file.size();
+				for (uint64_t i = 0; i < count; i++)
+				{
+					uint64_t page = load<uint32_t>(data + JOURNAL_HEADER_SIZE + i * (4 + PAGE_BYTES));
+					file_size = std::max(file_size, (page + 1) * PAGE_BYTES);
+				}
+				if (file_size > _file.size())
+					_file.resize(file_size);
+				for (uint64_t i = 0; i < count; i++)
+				{
+					auto entry = data + JOURNAL_HEADER_SIZE + i * (4 + PAGE_BYTES);
+					_file.write((uint64_t)load<uint32_t>(entry) * PAGE_BYTES, entry + 4, PAGE_BYTES);
+				}
+				_file.sync();
+			}
+			_journal.resize(0);
+		}
+
+		void FileStorage::create()
+		{
+			std::random_device random;
+			for (auto &key : _hash_key)
+				key = ((uint64_t)random() << 32) | random();
+			_page_count = 1;
+			_buckets.assign(1, allocate_page());
+			commit();
+		}
+
+		void FileStorage::load_header()
+		{
+			if (_file.size() < PAGE_BYTES)
+				throw NeoVmException("truncated storage file");
+			auto header = _file.data();
+			if (memcmp(header, FILE_MAGIC, 8) != 0)
+				throw NeoVmException("not a storage file");
+			if (load<uint32_t>(header + 8) != FILE_VERSION || load<uint32_t>(header + 12) != PAGE_BYTES)
+				throw NeoVmException("unsupported storage file version or page size");
+			_page_count = load<uint32_t>(header + 16);
+			_free_page = load<uint32_t>(header + 20);
+			_record_count = load<uint64_t>(header + 24);
+			_record_bytes = load<uint64_t>(header + 32);
+			_level = load<uint32_t>(header + 40);
+			_split = load<uint32_t>(header + 44);
+			_directory_page = load<uint32_t>(header + 48);
+			_hash_key[0] = load<uint64_t>(header + 56);
+			_hash_key[1] = load<uint64_t>(header + 64);
+			if ((uint64_t)_page_count * PAGE_BYTES > _file.size() || _level > 31 || _split >= ((uint64_t)1 << _level))
+				throw NeoVmException("corrupt storage file header");
+			load_directory();
+		}
+
+		void FileStorage::write_header()
+		{
+			auto header = writable_page(0);
+			memset(header, 0, PAGE_BYTES);
+			memcpy(header, FILE_MAGIC, 8);
+			store<uint32_t>(header + 8, FILE_VERSION);
+			store<uint32_t>(header + 12, (uint32_t)PAGE_BYTES);
+			store<uint32_t>(header + 16, _page_count);
+			store<uint32_t>(header + 20, _free_page);
+			store<uint64_t>(header + 24, _record_count);
+			store<uint64_t>(header + 32, _record_bytes);
+			store<uint32_t>(header + 40, _level);
+			store<uint32_t>(header + 44, _split);
+			store<uint32_t>(header + 48, _directory_page);
+			store<uint64_t>(header + 56, _hash_key[0]);
+			store<uint64_t>(header + 64, _hash_key[1]);
+		}
+
+		void FileStorage::load_directory()
+		{
+			auto count = ((uint64_t)1 << _level) + _split;
+			_buckets.clear();
+			_buckets.reserve((size_t)count);
+			auto page = _directory_page;
+			while (_buckets.size() < count)
+			{
+				if (page == 0 || page >= _page_count)
+					throw NeoVmException("corrupt storage directory");
+				auto data = page_data(page);
+				auto entries = load<uint32_t>(data + 4);
+				if (entries == 0 || entries > DIRECTORY_CAPACITY)
+					throw NeoVmException("corrupt storage directory");
+				for (uint32_t i = 0; i < entries && _buckets.size() < count; i++)
+					_buckets.push_back(load<uint32_t>(data + 8 + 4 * i));
+				page = load<uint32_t>(data);
+			}
+			_saved_buckets = _buckets.size();
+		}
+
+		// buckets are only ever added and their first page never changes, so only the directory pages with new
+		// buckets are written
+		void FileStorage::save_directory()
+		{
+			auto first_changed = _saved_buckets / DIRECTORY_CAPACITY * DIRECTORY_CAPACITY;
+			uint32_t previous = 0;
+			auto page = _directory_page;
+			for (size_t start = 0; start < _buckets.size(); start += DIRECTORY_CAPACITY)
+			{
+				if (page == 0)
+				{
+					page = allocate_page();
+					if (previous)
+						store<uint32_t>(writable_page(previous), page);
+					else
+						_directory_page = page;
+				}
+				if (start >= first_changed)
+				{
+					auto data = writable_page(page);
+					auto count = std::min(DIRECTORY_CAPACITY, _buckets.size() - start);
+					store<uint32_t>(data + 4, (uint32_t)count);
+					memcpy(data + 8, _buckets.data() + start, count * 4);
+				}
+				previous = page;
+				page = load<uint32_t>(page_data(page));
+			}
+			_saved_buckets = _buckets.size();
+		}
+
+		char *FileStorage::writable_page(uint32_t page)
+		{
+			if (page >= _dirty.size())
+				_dirty.resize((size_t)page + 1);
+			auto &copy = _dirty[page];
+			if (!copy)
+			{
+				copy.reset(new char[PAGE_BYTES]);
+				auto offset = (uint64_t)page * PAGE_BYTES;
+				if (offset + PAGE_BYTES <= _file.size())
+					memcpy(copy.get(), _file.data() + offset, PAGE_BYTES);
+				else
+					memset(copy.get(), 0, PAGE_BYTES);
+				_dirty_pages.push_back(page);
+			}
+			return copy.get();
+		}
+
+		// the page is zeroed
+		uint32_t FileStorage::allocate_page()
+		{
+			uint32_t page;
+			if (_free_page)
+			{
+				page = _free_page;
+				_free_page = load<uint32_t>(page_data(page));
+			}
+			else
+			{
+				if (_page_count == UINT32_MAX)
+					throw NeoVmException("storage file full");
+				page = _page_count++;
+			}
+			memset(writable_page(page), 0, PAGE_BYTES);
+			return page;
+		}
+
+		void FileStorage::free_page(uint32_t page)
+		{
+			store<uint32_t>(writable_page(page), _free_page);
+			_free_page = page;
+		}
+
+		uint64_t FileStorage::hash_key(const std::string &key) const
+		{
+			return siphash(_hash_key, key.data(), key.size());
+		}
+
+		uint32_t FileStorage::bucket_of(uint64_t hash) const
+		{
+			auto bucket = hash & (((uint64_t)1 << _level) - 1);
+			if (bucket < _split)
+				bucket = hash & (((uint64_t)1 << (_level + 1)) - 1);
+			return (uint32_t)bucket;
+		}
+
+		// previous is the page before page in the chain of the bucket, 0 for the first page
+		bool FileStorage::find(uint64_t hash, const std::string &key, uint32_t *page, size_t *offset, uint32_t *previous) const
+		{
+			uint32_t last = 0;
+			auto current = _buckets[bucket_of(hash)];
+			while (current)
+			{
+				auto data = page_data(current);
+				auto end = BUCKET_HEADER_SIZE + load<uint16_t>(data + 4);
+				for (size_t position = BUCKET_HEADER_SIZE; position < end; position += record_size(data + position))
+				{
+					auto record = data + position;
+					if (load<uint64_t>(record) == hash && load<uint16_t>(record + 8) == key.size()
+						&& memcmp(record + RECORD_HEADER_SIZE, key.data(), key.size()) == 0)
+					{
+						*page = current;
+						*offset = position;
+						*previous = last;
+						return true;
+					}
+				}
+				last = current;
+				current = load<uint32_t>(data);
+			}
+			return false;
+		}
+
+		void FileStorage::read_value(const char *record, std::vector<char> *value) const
+		{
+			auto size = load<uint32_t>(record + 12);
+			auto payload = record + RECORD_HEADER_SIZE + load<uint16_t>(record + 8);
+			value->resize(size);
+			if (!(load<uint16_t>(record + 10) & RECORD_BLOB))
+			{
+				if (size > 0)
+					memcpy(value->data(), payload, size);
+				return;
+			}
+			auto page = load<uint32_t>(payload);
+			for (size_t copied = 0; copied < size; )
+			{
+				auto data = page_data(page);
+				auto part = std::min<size_t>(BLOB_CAPACITY, size - copied);
+				memcpy(value->data() + copied, data + 4, part);
+				copied += part;
+				page = load<uint32_t>(data);
+			}
+		}
+
+		// into the first page of the bucket with room, a new page is chained to the last one when none has
+		void FileStorage::insert_record(uint64_t hash, const char *record, size_t size)
+		{
+			auto page = _buckets[bucket_of(hash)];
+			while (true)
+			{
+				auto data = page_data(page);
+				auto used = load<uint16_t>(data + 4);
+				if (used + size <= BUCKET_CAPACITY)
+				{
+					auto target = writable_page(page);
+					memcpy(target + BUCKET_HEADER_SIZE + used, record, size);
+					store<uint16_t>(target + 4, (uint16_t)(used + size));
+					return;
+				}
+				auto next = load<uint32_t>(data);
+				if (!next)
+				{
+					next = allocate_page();
+					store<uint32_t>(writable_page(page), next);
+				}
+				page = next;
+			}
+		}
+
+		// the records after it move down, an overflow page left empty leaves the chain
+		void FileStorage::remove_record(uint32_t page, size_t offset, uint32_t previous)
+		{
+			auto data = writable_page(page);
+			auto record = data + offset;
+			auto size = record_size(record);
+			if (load<uint16_t>(record + 10) & RECORD_BLOB)
+				free_blob(load<uint32_t>(record + RECORD_HEADER_SIZE + load<uint16_t>(record + 8)));
+			auto used = load<uint16_t>(data + 4);
+			memmove(record, record + size, BUCKET_HEADER_SIZE + used - offset - size);
+			store<uint16_t>(data + 4, (uint16_t)(used - size));
+			if (used == size && previous)
+			{
+				store<uint32_t>(writable_page(previous), load<uint32_t>(data));
+				free_page(page);
+			}
+		}
+
+		// the first page of a chain holding the data, written from the end so every page is written once
+		uint32_t FileStorage::write_blob(const char *data, size_t size)
+		{
+			uint32_t next = 0;
+			for (auto i = (size + BLOB_CAPACITY - 1) / BLOB_CAPACITY; i-- > 0; )
+			{
+				auto page = allocate_page();
+				auto target = writable_page(page);
+				store<uint32_t>(target, next);
+				memcpy(target + 4, data + i * BLOB_CAPACITY, std::min(BLOB_CAPACITY, size - i * BLOB_CAPACITY));
+				next = page;
+			}
+			return next;
+		}
+
+		void FileStorage::free_blob(uint32_t page)
+		{
+			while (page)
+			{
+				auto next = load<uint32_t>(page_data(page));
+				free_page(page);
+				page = next;
+			}
+		}
+
+		// linear hashing: the bucket at split is divided with the next bit of the hash between itself and a new bucket
+		void FileStorage::split_bucket()
+		{
+			auto head = _buckets[_split];
+			std::vector<char> records;
+			for (auto page = head; page; )
+			{
+				auto data = page_data(page);
+				records.insert(records.end(), data + BUCKET_HEADER_SIZE, data + BUCKET_HEADER_SIZE + load<uint16_t>(data + 4));
+				auto next = load<uint32_t>(data);
+				if (page != head)
+					free_page(page);
+				page = next;
+			}
+			auto data = writable_page(head);
+			store<uint32_t>(data, 0);
+			store<uint16_t>(data + 4, 0);
+			_buckets.push_back(allocate_page());
+			if (++_split == ((uint64_t)1 << _level))
+			{
+				_level++;
+				_split = 0;
+			}
+			for (size_t offset = 0; offset < records.size(); )
+			{
+				auto record = records.data() + offset;
+				auto size = record_size(record);
+				insert_record(load<uint64_t>(record), record, size);
+				offset += size;
+			}
+		}
+
+		void FileStorage::rebuild_bloom()
+		{
+			_bloom_capacity = std::max<uint64_t>(_record_count * 2, NEOVM_STORAGE_BLOOM_MIN_KEYS);
+			_bloom_keys = _record_count;
+			_bloom.reset((size_t)_bloom_capacity);
+			for (auto page : _buckets)
+			{
+				while (page)
+				{
+					auto data = page_data(page);
+					auto end = BUCKET_HEADER_SIZE + load<uint16_t>(data + 4);
+					for (size_t position = BUCKET_HEADER_SIZE; position < end; position += record_size(data + position))
+						_bloom.add(load<uint64_t>(data + position));
+					page = load<uint32_t>(data);
+				}
+			}
+			_bloom_rebuilt = true;
+		}
+
+		bool FileStorage::get(const std::string &key, std::vector<char> *value)
+		{
+			auto hash = hash_key(key);
+			if (!_bloom.may_contain(hash))
+				return false;
+			if (_cache.get(hash, key, value))
+				return true;
+			uint32_t page, previous;
+			size_t offset;
+			if (!find(hash, key, &page, &offset, &previous))
+				return false;
+			read_value(page_data(page) + offset, value);
+			_cache.put(hash, key, *value);
+			return true;
+		}
+
+		void FileStorage::put(const std::string &key, const std::vector<char> &value)
+		{
+			if (RECORD_HEADER_SIZE + key.size() + 4 > BUCKET_CAPACITY)
+				throw NeoVmException("too long storage key");
+			if (value.size() > UINT32_MAX)
+				throw NeoVmException("too long storage value");
+			auto hash = hash_key(key);
+			auto inline_value = value.size() <= NEOVM_STORAGE_MAX_INLINE_VALUE && RECORD_HEADER_SIZE + key.size() + value.size() <= BUCKET_CAPACITY;
+			uint32_t page, previous;
+			size_t offset;
+			auto found = find(hash, key, &page, &offset, &previous);
+			if (found)
+			{
+				auto record = page_data(page) + offset;
+				if (inline_value && !(load<uint16_t>(record + 10) & RECORD_BLOB) && load<uint32_t>(record + 12) == value.size())
+				{
+					if (!value.empty())
+						memcpy(writable_page(page) + offset + RECORD_HEADER_SIZE + key.size(), value.data(), value.size());
+					_cache.put(hash, key, value);
+					return;
+				}
+				_record_bytes -= record_size(record);
+				remove_record(page, offset, previous);
+			}
+			std::vector<char> record(RECORD_HEADER_SIZE + key.size() + (inline_value ? value.size() : 4));
+			store<uint64_t>(record.data(), hash);
+			store<uint16_t>(record.data() + 8, (uint16_t)key.size());
+			store<uint16_t>(record.data() + 10, inline_value ? 0 : RECORD_BLOB);
+			store<uint32_t>(record.data() + 12, (uint32_t)value.size());
+			memcpy(record.data() + RECORD_HEADER_SIZE, key.data(), key.size());
+			auto payload = record.data() + RECORD_HEADER_SIZE + key.size();
+			if (!inline_value)
+				store<uint32_t>(payload, write_blob(value.data(), value.size()));
+			else if (!value.empty())
+				memcpy(payload, value.data(), value.size());
+			insert_record(hash, record.data(), record.size());
+			_record_bytes += record.size();
+			if (!found)
+			{
+				_record_count++;
+				if (++_bloom_keys > _bloom_capacity)
+					rebuild_bloom();
+				else
+					_bloom.add(hash);
+			}
+			_cache.put(hash, key, value);
+			// whichever bucket filled up, the next one in turn splits
+			if (_record_bytes * 100 > (uint64_t)_buckets.size() * BUCKET_CAPACITY * NEOVM_STORAGE_BUCKET_FILL && _level < 31)
+				split_bucket();
+		}
+
+		void FileStorage::remove(const std::string &key)
+		{
+			auto hash = hash_key(key);
+			_cache.remove(hash, key);
+			if (!_bloom.may_contain(hash))
+				return;
+			uint32_t page, previous;
+			size_t offset;
+			if (!find(hash, key, &page, &offset, &previous))
+				return;
+			_record_bytes -= record_size(page_data(page) + offset);
+			_record_count--;
+			remove_record(page, offset, previous);
+		}
+
+		void FileStorage::commit()
+		{
+			if (_dirty_pages.empty() && _saved_buckets == _buckets.size())
+				return;
+			save_directory();
+			write_header();
+			std::sort(_dirty_pages.begin(), _dirty_pages.end());
+
+			std::vector<char> journal(JOURNAL_HEADER_SIZE + _dirty_pages.size() * (4 + PAGE_BYTES) + 8);
+			auto out = journal.data();
+			memcpy(out, JOURNAL_MAGIC, 8);
+			store<uint32_t>(out + 8, (uint32_t)PAGE_BYTES);
+			store<uint32_t>(out + 12, (uint32_t)_dirty_pages.size());
+			out += JOURNAL_HEADER_SIZE;
+			for (auto page : _dirty_pages)
+			{
+				store<uint32_t>(out, page);
+				memcpy(out + 4, _dirty[page].get(), PAGE_BYTES);
+				out += 4 + PAGE_BYTES;
+			}
+			store<uint64_t>(out, siphash(JOURNAL_CHECKSUM_KEY, journal.data(), out - journal.data()));
+			_journal.write(0, journal.data(), journal.size());
+			_journal.sync();
+
+			// the file only changes once the journal is on disk, from here on a crash is recovered by writing the pages again
+			auto size = (uint64_t)_page_count * PAGE_BYTES;
+			if (_file.size() < size)
+				_file.resize(std::max(size, (_file.size() + _file.size() / 4) / PAGE_BYTES * PAGE_BYTES));
+			for (auto page : _dirty_pages)
+				_file.write((uint64_t)page * PAGE_BYTES, _dirty[page].get(), PAGE_BYTES);
+			_file.sync();
+			_journal.resize(0);
+
+			for (auto page : _dirty_pages)
+				_dirty[page].reset();
+			_dirty_pages.clear();
+			_bloom_rebuilt = false;
+		}
+
+		void FileStorage::rollback()
+		{
+			for (auto page : _dirty_pages)
+				_dirty[page].reset();
+			_dirty_pages.clear();
+			load_header();
+			_cache.clear();
+			// a filter rebuilt since the commit misses keys removed since then
+			if (_bloom_rebuilt)
+				rebuild_bloom();
+			_bloom_rebuilt = false;
+		}
+	}
+}
@@ -0,0 +1,143 @@
+#include <neovm/garbage_collector.hpp>
+#include <neovm/exceptions.hpp>
+
+namespace neo
+{
+	namespace vm
+	{
+		GarbageCollector::GarbageCollector(MemoryResource *resource, size_t threshold, size_t max_heap_size)
+			: _resource(resource), _threshold(threshold), _max_heap_size(max_heap_size), _allocated_count(0),
+			_next_collect_count(threshold), _heap_size(0), _collections_count(0)
+		{
+		}
+
+		GarbageCollector::~GarbageCollector()
+		{
+			clear();
+		}
+
+		void GarbageCollector::clear()
+		{
+			if (!_resource->is_arena())
+			{
+				for (auto item : _items)
+				{
+					delete item;
+				}
+			}
+			_items.clear();
+			_pinned.clear();
+			_allocated_count = 0;
+			_next_collect_count = _threshold;
+			_heap_size = 0;
+		}
+
+		void GarbageCollector::add(StackItem *item)
+		{
+			_items.push_back(item);
+			++_allocated_count;
+			_heap_size += item->memory_size();
+		}
+
+		void GarbageCollector::pin(StackItem *item)
+		{
+			if (item)
+				++_pinned[item];
+		}
+
+		void GarbageCollector::unpin(StackItem *item)
+		{
+			auto found = _pinned.find(item);
+			if (found == _pinned.end())
+				return;
+			if (--found->second == 0)
+				_pinned.erase(found);
+		}
+
+		void GarbageCollector::collect(const std::vector<StackItem*> &roots)
+		{
+			// mark, iteratively so deep or cyclic item graphs can't overflow the native stack
+			std::vector<StackItem*> pending(roots);
+			for (const auto &pair : _pinned)
+			{
+				pending.push_back(pair.first);
+			}
+			while (!pending.empty())
+			{
+				auto item = pending.back();
+				pending.pop_back();
+				if (!item || item->_gc_marked)
+					continue;
+				item->_gc_marked = true;
+				item->references(&pending);
+			}
+
+			// sweep
+			size_t live = 0;
+			size_t heap_size = 0;
+			for (size_t i = 0; i < _items.size(); i++)
+			{
+				auto item = _items[i];
+				if (item->_gc_marked)
+				{
+					item->_gc_marked = false;
+					heap_size += item->memory_size();
+					_items[live++] = item;
+				}
+				else
+				{
+					delete item;
+				}
+			}
+			_items.resize(live);
+
+			_heap_size = heap_size;
+			_allocated_count = 0;
+			// the next collection waits for at least as many new items as survived, so collecting stays linear in allocations
+			_next_collect_count = live > _threshold ? live : _threshold;
+			++_collections_count;
+
+			if (_max_heap_size > 0 && _heap_size > _max_heap_size)
+			{
+				throw NeoVmException("heap size over limit", ErrorCode::MEMORY_ERROR);
+			}
+		}
+
+		size_t GarbageCollector::items_count() const
+		{
+			return _items.size();
+		}
+
+		size_t GarbageCollector::heap_size() const
+		{
+			return _heap_size;
+		}
+
+		size_t GarbageCollector::collections_count() const
+		{
+			return _collections_count;
+		}
+
+		size_t GarbageCollector::threshold() const
+		{
+			return _threshold;
+		}
+
+		void GarbageCollector::set_threshold(size_t threshold)
+		{
+			_threshold = threshold;
+			if (_next_collect_count > threshold)
+				_next_collect_count = threshold;
+		}
+
+		size_t GarbageCollector::max_heap_size() const
+		{
+			return _max_heap_size;
+		}
+
+		void GarbageCollector::set_max_heap_size(size_t max_heap_size)
+		{
+			_max_heap_size = max_heap_size;
+		}
+	}
+}
@@ -0,0 +1,61 @@
+#include <neovm/gas_cost_table.hpp>
+#include <neovm/interop_service.hpp>
+#include <atomic>
+
+namespace neo
+{
+	namespace vm
+	{
+		namespace
+		{
+			uint64_t next_version()
+			{
+				static std::atomic<uint64_t> version(0);
+				return ++version;
+			}
+		}
+
+		GasCostTable::GasCostTable(int64_t opcode_cost, int64_t service_cost)
+			: _default_service_cost(service_cost), _version(next_version())
+		{
+			for (size_t i = 0; i < 256; i++)
+			{
+				_opcode_costs[i] = opcode_cost;
+			}
+		}
+
+		const GasCostTable *GasCostTable::default_table()
+		{
+			static GasCostTable table;
+			return &table;
+		}
+
+		void GasCostTable::set_opcode_cost(OpCode opcode, int64_t cost)
+		{
+			_opcode_costs[(VMByte)opcode] = cost;
+			_version = next_version();
+		}
+
+		int64_t GasCostTable::service_cost(uint32_t service_id) const
+		{
+			if (service_id >= _service_costs.size() || _service_costs[service_id] < 0)
+				return _default_service_cost;
+			return _service_costs[service_id];
+		}
+
+		void GasCostTable::set_service_cost(const std::string &method, int64_t cost)
+		{
+			auto id = intern_service_name(method);
+			if (id >= _service_costs.size())
+				_service_costs.resize(id + 1, -1);
+			_service_costs[id] = cost;
+			_version = next_version();
+		}
+
+		void GasCostTable::set_default_service_cost(int64_t cost)
+		{
+			_default_service_cost = cost;
+			_version = next_version();
+		}
+	}
+}
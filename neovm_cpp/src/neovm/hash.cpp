@@ -0,0 +1,383 @@
+#include <neovm/hash.hpp>
+
+#include <stdint.h>
+#include <string.h>
+
+#ifdef NEOVM_SHA_EXTENSIONS
+#include <immintrin.h>
+#if defined(__GNUC__) || defined(__clang__)
+#include <cpuid.h>
+#define NEOVM_TARGET_SHA __attribute__((target("sha,sse4.1,ssse3")))
+#else
+#include <intrin.h>
+#define NEOVM_TARGET_SHA
+#endif
+#endif
+
+namespace neo
+{
+	namespace vm
+	{
+		namespace
+		{
+			inline uint32_t rotl(uint32_t x, int n) { return (x << n) | (x >> (32 - n)); }
+			inline uint32_t rotr(uint32_t x, int n) { return (x >> n) | (x << (32 - n)); }
+
+			inline uint32_t load_be32(const uint8_t *p)
+			{
+				return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+			}
+
+			inline uint32_t load_le32(const uint8_t *p)
+			{
+				return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+			}
+
+			inline void store_be32(uint8_t *p, uint32_t x)
+			{
+				p[0] = (uint8_t)(x >> 24); p[1] = (uint8_t)(x >> 16); p[2] = (uint8_t)(x >> 8); p[3] = (uint8_t)x;
+			}
+
+			inline void store_le32(uint8_t *p, uint32_t x)
+			{
+				p[0] = (uint8_t)x; p[1] = (uint8_t)(x >> 8); p[2] = (uint8_t)(x >> 16); p[3] = (uint8_t)(x >> 24);
+			}
+
+			// compresses whole 64 byte blocks into the state
+			typedef void(*BlockFunction)(uint32_t *state, const uint8_t *data, size_t blocks);
+
+			// Merkle-Damgard over 64 byte blocks: whole blocks straight from data, then the padded tail
+			void md_hash(BlockFunction compress, uint32_t *state, const char *data, size_t size, bool big_endian)
+			{
+				auto bytes = (const uint8_t*)data;
+				size_t blocks = size / 64;
+				if (blocks > 0)
+					compress(state, bytes, blocks);
+				size_t rest = size - blocks * 64;
+				uint8_t tail[128];
+				// data may be null when size is 0
+				if (rest > 0)
+					memcpy(tail, bytes + blocks * 64, rest);
+				tail[rest] = 0x80;
+				size_t tail_size = rest + 9 <= 64 ? 64 : 128;
+				memset(tail + rest + 1, 0, tail_size - rest - 1);
+				uint64_t bits = (uint64_t)size * 8;
+				for (int i = 0; i < 8; i++)
+				{
+					auto byte = (uint8_t)(bits >> (8 * i));
+					if (big_endian)
+						tail[tail_size - 1 - i] = byte;
+					else
+						tail[tail_size - 8 + i] = byte;
+				}
+				compress(state, tail, tail_size / 64);
+			}
+
+			void sha1_blocks(uint32_t *state, const uint8_t *data, size_t blocks)
+			{
+				uint32_t w[80];
+				for (; blocks > 0; blocks--, data += 64)
+				{
+					for (int i = 0; i < 16; i++)
+						w[i] = load_be32(data + 4 * i);
+					for (int i = 16; i < 80; i++)
+						w[i] = rotl(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+					uint32_t a = state[0], b = state[1], c = state[2], d = state[3], e = state[4];
+					for (int i = 0; i < 80; i++)
+					{
+						uint32_t f, k;
+						if (i < 20) { f = (b & c) | (~b & d); k = 0x5A827999; }
+						else if (i < 40) { f = b ^ c ^ d; k = 0x6ED9EBA1; }
+						else if (i < 60) { f = (b & c) | (b & d) | (c & d); k = 0x8F1BBCDC; }
+						else { f = b ^ c ^ d; k = 0xCA62C1D6; }
+						uint32_t t = rotl(a, 5) + f + e + k + w[i];
+						e = d; d = c; c = rotl(b, 30); b = a; a = t;
+					}
+					state[0] += a; state[1] += b; state[2] += c; state[3] += d; state[4] += e;
+				}
+			}
+
+			const uint32_t SHA256_K[64] = {
+				0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+				0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+				0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+				0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+				0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+				0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+				0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+				0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+			};
+
+			void sha256_blocks(uint32_t *state, const uint8_t *data, size_t blocks)
+			{
+				uint32_t w[64];
+				for (; blocks > 0; blocks--, data += 64)
+				{
+					for (int i = 0; i < 16; i++)
+						w[i] = load_be32(data + 4 * i);
+					for (int i = 16; i < 64; i++)
+					{
+						uint32_t s0 = rotr(w[i - 15], 7) ^ rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+						uint32_t s1 = rotr(w[i - 2], 17) ^ rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+						w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+					}
+					uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+					uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+					for (int i = 0; i < 64; i++)
+					{
+						uint32_t t1 = h + (rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25)) + ((e & f) ^ (~e & g)) + SHA256_K[i] + w[i];
+						uint32_t t2 = (rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+						h = g; g = f; f = e; e = d + t1;
+						d = c; c = b; b = a; a = t1 + t2;
+					}
+					state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+					state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+				}
+			}
+
+			const uint8_t RIPEMD160_RL[80] = {
+				0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15,
+				7, 4, 13, 1, 10, 6, 15, 3, 12, 0, 9, 5, 2, 14, 11, 8,
+				3, 10, 14, 4, 9, 15, 8, 1, 2, 7, 0, 6, 13, 11, 5, 12,
+				1, 9, 11, 10, 0, 8, 12, 4, 13, 3, 7, 15, 14, 5, 6, 2,
+				4, 0, 5, 9, 7, 12, 2, 10, 14, 1, 3, 8, 11, 6, 15, 13
+			};
+			const uint8_t RIPEMD160_RR[80] = {
+				5, 14, 7, 0, 9, 2, 11, 4, 13, 6, 15, 8, 1, 10, 3, 12,
+				6, 11, 3, 7, 0, 13, 5, 10, 14, 15, 8, 12, 4, 9, 1, 2,
+				15, 5, 1, 3, 7, 14, 6, 9, 11, 8, 12, 2, 10, 0, 4, 13,
+				8, 6, 4, 1, 3, 11, 15, 0, 5, 12, 2, 13, 9, 7, 10, 14,
+				12, 15, 10, 4, 1, 5, 8, 7, 6, 2, 13, 14, 0, 3, 9, 11
+			};
+			const uint8_t RIPEMD160_SL[80] = {
+				11, 14, 15, 12, 5, 8, 7, 9, 11, 13, 14, 15, 6, 7, 9, 8,
+				7, 6, 8, 13, 11, 9, 7, 15, 7, 12, 15, 9, 11, 7, 13, 12,
+				11, 13, 6, 7, 14, 9, 13, 15, 14, 8, 13, 6, 5, 12, 7, 5,
+				11, 12, 14, 15, 14, 15, 9, 8, 9, 14, 5, 6, 8, 6, 5, 12,
+				9, 15, 5, 11, 6, 8, 13, 12, 5, 12, 13, 14, 11, 8, 5, 6
+			};
+			const uint8_t RIPEMD160_SR[80] = {
+				8, 9, 9, 11, 13, 15, 15, 5, 7, 7, 8, 11, 14, 14, 12, 6,
+				9, 13, 15, 7, 12, 8, 9, 11, 7, 7, 12, 7, 6, 15, 13, 11,
+				9, 7, 15, 11, 8, 6, 6, 14, 12, 13, 5, 14, 13, 13, 7, 5,
+				15, 5, 8, 11, 14, 14, 6, 14, 6, 9, 12, 9, 12, 5, 15, 8,
+				8, 5, 12, 9, 12, 5, 14, 6, 8, 13, 6, 5, 15, 13, 11, 11
+			};
+			const uint32_t RIPEMD160_KL[5] = { 0x00000000, 0x5A827999, 0x6ED9EBA1, 0x8F1BBCDC, 0xA953FD4E };
+			const uint32_t RIPEMD160_KR[5] = { 0x50A28BE6, 0x5C4DD124, 0x6D703EF3, 0x7A6D76E9, 0x00000000 };
+
+			inline uint32_t ripemd160_f(int round, uint32_t x, uint32_t y, uint32_t z)
+			{
+				switch (round)
+				{
+				case 0: return x ^ y ^ z;
+				case 1: return (x & y) | (~x & z);
+				case 2: return (x | ~y) ^ z;
+				case 3: return (x & z) | (y & ~z);
+				default: return x ^ (y | ~z);
+				}
+			}
+
+			void ripemd160_blocks(uint32_t *state, const uint8_t *data, size_t blocks)
+			{
+				uint32_t x[16];
+				for (; blocks > 0; blocks--, data += 64)
+				{
+					for (int i = 0; i < 16; i++)
+						x[i] = load_le32(data + 4 * i);
+					uint32_t al = state[0], bl = state[1], cl = state[2], dl = state[3], el = state[4];
+					uint32_t ar = al, br = bl, cr = cl, dr = dl, er = el;
+					for (int j = 0; j < 80; j++)
+					{
+						int round = j / 16;
+						uint32_t t = rotl(al + ripemd160_f(round, bl, cl, dl) + x[RIPEMD160_RL[j]] + RIPEMD160_KL[round], RIPEMD160_SL[j]) + el;
+						al = el; el = dl; dl = rotl(cl, 10); cl = bl; bl = t;
+						t = rotl(ar + ripemd160_f(4 - round, br, cr, dr) + x[RIPEMD160_RR[j]] + RIPEMD160_KR[round], RIPEMD160_SR[j]) + er;
+						ar = er; er = dr; dr = rotl(cr, 10); cr = br; br = t;
+					}
+					uint32_t t = state[1] + cl + dr;
+					state[1] = state[2] + dl + er;
+					state[2] = state[3] + el + ar;
+					state[3] = state[4] + al + br;
+					state[4] = state[0] + bl + cr;
+					state[0] = t;
+				}
+			}
+
+#ifdef NEOVM_SHA_EXTENSIONS
+			bool cpu_has_sha_extensions()
+			{
+				// SSSE3 and SSE4.1 in leaf 1 ecx, SHA in leaf 7 ebx
+#if defined(__GNUC__) || defined(__clang__)
+				unsigned int a, b, c, d;
+				if (__get_cpuid_max(0, nullptr) < 7)
+					return false;
+				__cpuid(1, a, b, c, d);
+				bool sse = (c & (1u << 9)) && (c & (1u << 19));
+				__cpuid_count(7, 0, a, b, c, d);
+				return sse && (b & (1u << 29));
+#else
+				int info[4];
+				__cpuid(info, 0);
+				if (info[0] < 7)
+					return false;
+				__cpuid(info, 1);
+				bool sse = (info[2] & (1 << 9)) && (info[2] & (1 << 19));
+				__cpuidex(info, 7, 0);
+				return sse && (info[1] & (1 << 29));
+#endif
+			}
+
+			// rounds 4 * (5 * F + first) to 4 * (5 * F + 4) + 3, all using the round function F.
+			// m holds the last 4 message quads, quad g is m[g & 3]
+			template <int F>
+			NEOVM_TARGET_SHA inline void sha1_shani_groups(__m128i &abcd, __m128i &abcd_prev, __m128i *m, int first)
+			{
+				for (int g = 5 * F + first; g < 5 * F + 5; g++)
+				{
+					if (g >= 4)
+						m[g & 3] = _mm_sha1msg2_epu32(_mm_xor_si128(_mm_sha1msg1_epu32(m[g & 3], m[(g + 1) & 3]), m[(g + 2) & 3]), m[(g + 3) & 3]);
+					__m128i e = _mm_sha1nexte_epu32(abcd_prev, m[g & 3]);
+					abcd_prev = abcd;
+					abcd = _mm_sha1rnds4_epu32(abcd, e, F);
+				}
+			}
+
+			NEOVM_TARGET_SHA void sha1_blocks_shani(uint32_t *state, const uint8_t *data, size_t blocks)
+			{
+				const __m128i mask = _mm_set_epi64x(0x0001020304050607ULL, 0x08090a0b0c0d0e0fULL);
+				__m128i abcd = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)state), 0x1B);
+				__m128i e0 = _mm_set_epi32((int)state[4], 0, 0, 0);
+				for (; blocks > 0; blocks--, data += 64)
+				{
+					__m128i abcd_save = abcd;
+					__m128i e0_save = e0;
+					__m128i m[4];
+					for (int i = 0; i < 4; i++)
+						m[i] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(data + 16 * i)), mask);
+					__m128i abcd_prev = abcd;
+					abcd = _mm_sha1rnds4_epu32(abcd, _mm_add_epi32(e0, m[0]), 0);
+					sha1_shani_groups<0>(abcd, abcd_prev, m, 1);
+					sha1_shani_groups<1>(abcd, abcd_prev, m, 0);
+					sha1_shani_groups<2>(abcd, abcd_prev, m, 0);
+					sha1_shani_groups<3>(abcd, abcd_prev, m, 0);
+					e0 = _mm_sha1nexte_epu32(abcd_prev, e0_save);
+					abcd = _mm_add_epi32(abcd, abcd_save);
+				}
+				_mm_storeu_si128((__m128i*)state, _mm_shuffle_epi32(abcd, 0x1B));
+				state[4] = (uint32_t)_mm_extract_epi32(e0, 3);
+			}
+
+			NEOVM_TARGET_SHA void sha256_blocks_shani(uint32_t *state, const uint8_t *data, size_t blocks)
+			{
+				const __m128i mask = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+				// the instructions keep the state as ABEF and CDGH
+				__m128i tmp = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)&state[0]), 0xB1);
+				__m128i state1 = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)&state[4]), 0x1B);
+				__m128i state0 = _mm_alignr_epi8(tmp, state1, 8);
+				state1 = _mm_blend_epi16(state1, tmp, 0xF0);
+				for (; blocks > 0; blocks--, data += 64)
+				{
+					__m128i abef_save = state0;
+					__m128i cdgh_save = state1;
+					__m128i w[4];
+					for (int i = 0; i < 16; i++)
+					{
+						if (i < 4)
+							w[i] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(data + 16 * i)), mask);
+						else
+						{
+							__m128i x = _mm_sha256msg1_epu32(w[i & 3], w[(i + 1) & 3]);
+							x = _mm_add_epi32(x, _mm_alignr_epi8(w[(i + 3) & 3], w[(i + 2) & 3], 4));
+							w[i & 3] = _mm_sha256msg2_epu32(x, w[(i + 3) & 3]);
+						}
+						__m128i msg = _mm_add_epi32(w[i & 3], _mm_loadu_si128((const __m128i*)&SHA256_K[4 * i]));
+						state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+						state0 = _mm_sha256rnds2_epu32(state0, state1, _mm_shuffle_epi32(msg, 0x0E));
+					}
+					state0 = _mm_add_epi32(state0, abef_save);
+					state1 = _mm_add_epi32(state1, cdgh_save);
+				}
+				tmp = _mm_shuffle_epi32(state0, 0x1B);
+				state1 = _mm_shuffle_epi32(state1, 0xB1);
+				_mm_storeu_si128((__m128i*)&state[0], _mm_blend_epi16(tmp, state1, 0xF0));
+				_mm_storeu_si128((__m128i*)&state[4], _mm_alignr_epi8(state1, tmp, 8));
+			}
+
+#endif
+
+			bool use_sha_extensions()
+			{
+#ifdef NEOVM_SHA_EXTENSIONS
+				static const bool supported = cpu_has_sha_extensions();
+				return supported;
+#else
+				return false;
+#endif
+			}
+
+			inline BlockFunction sha1_compress()
+			{
+#ifdef NEOVM_SHA_EXTENSIONS
+				if (use_sha_extensions())
+					return sha1_blocks_shani;
+#endif
+				return sha1_blocks;
+			}
+
+			inline BlockFunction sha256_compress()
+			{
+#ifdef NEOVM_SHA_EXTENSIONS
+				if (use_sha_extensions())
+					return sha256_blocks_shani;
+#endif
+				return sha256_blocks;
+			}
+		}
+
+		void sha1(const char *data, size_t size, char *out)
+		{
+			uint32_t state[5] = { 0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0 };
+			md_hash(sha1_compress(), state, data, size, true);
+			for (int i = 0; i < 5; i++)
+				store_be32((uint8_t*)out + 4 * i, state[i]);
+		}
+
+		void sha256(const char *data, size_t size, char *out)
+		{
+			uint32_t state[8] = {
+				0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+			};
+			md_hash(sha256_compress(), state, data, size, true);
+			for (int i = 0; i < 8; i++)
+				store_be32((uint8_t*)out + 4 * i, state[i]);
+		}
+
+		void ripemd160(const char *data, size_t size, char *out)
+		{
+			uint32_t state[5] = { 0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0 };
+			md_hash(ripemd160_blocks, state, data, size, false);
+			for (int i = 0; i < 5; i++)
+				store_le32((uint8_t*)out + 4 * i, state[i]);
+		}
+
+		void hash160(const char *data, size_t size, char *out)
+		{
+			char digest[NEOVM_SHA256_SIZE];
+			sha256(data, size, digest);
+			ripemd160(digest, sizeof(digest), out);
+		}
+
+		void hash256(const char *data, size_t size, char *out)
+		{
+			char digest[NEOVM_SHA256_SIZE];
+			sha256(data, size, digest);
+			sha256(digest, sizeof(digest), out);
+		}
+
+		bool sha_extensions_enabled()
+		{
+			return use_sha_extensions();
+		}
+	}
+}
@@ -2,15 +2,24 @@
 #include <neovm/exceptions.hpp>
 
 #include <sstream>
+#include <cstring>
 
 namespace neo
 {
 	namespace vm
 	{
 
-		BinaryReader::BinaryReader(std::vector<char> data)
+		BinaryReader::BinaryReader(const char *data, size_t size)
 		{
 			_data = data;
+			_size = size;
+			_position = 0;
+		}
+
+		BinaryReader::BinaryReader(const std::vector<char> &data)
+		{
+			_data = data.data();
+			_size = data.size();
 			_position = 0;
 		}
 
@@ -19,76 +28,79 @@ namespace neo
 			return _position;
 		}
 
-		std::vector<char> BinaryReader::ReadBytes(size_t size)
+		size_t BinaryReader::size() const
 		{
-			if (size + _position > _data.size())
+			return _size;
+		}
+
+		const VMByte *BinaryReader::take(size_t size)
+		{
+			if (_position > _size || size > _size - _position)
 			{
 				throw NeoVmException("not enough binary data to read");
 			}
-			std::vector<char> result(size);
-			memcpy(result.data(), _data.data() + _position, size * sizeof(char));
+			auto result = (const VMByte*)(_data + _position);
 			_position += size;
 			return result;
 		}
 
+		ByteSpan BinaryReader::ReadSpan(size_t size)
+		{
+			ByteSpan span;
+			span.data = (const char*)take(size);
+			span.size = size;
+			return span;
+		}
+
+		std::vector<char> BinaryReader::ReadBytes(size_t size)
+		{
+			return ReadSpan(size).to_vector();
+		}
+
 		std::vector<VMByte> BinaryReader::ReadUBytes(size_t size)
 		{
-			if (size + _position > _data.size())
-			{
-				throw NeoVmException("not enough binary data to read");
-			}
-			std::vector<VMByte> result(size);
-			memcpy(result.data(), _data.data() + _position, size * sizeof(VMByte));
-			_position += size;
-			return result;
+			auto bytes = take(size);
+			return std::vector<VMByte>(bytes, bytes + size);
 		}
 
 		VMByte BinaryReader::ReadByte()
 		{
-			return ReadUBytes(1)[0];
+			return *take(1);
 		}
 
 		VMLInteger BinaryReader::ReadVarInt64(VMLInteger max)
 		{
-			// little endien
-			auto bytes = ReadUBytes(8);
-			VMLInteger result = ((VMLInteger)bytes[7] << 56) + ((VMLInteger)bytes[6] << 48) + ((VMLInteger)bytes[5] << 40) + ((VMLInteger)bytes[4] << 32)
-				+ ((VMLInteger)bytes[3] << 24) + ((VMLInteger)bytes[2] << 16) + ((VMLInteger)bytes[1] << 8) + (VMLInteger)bytes[0];
-			return result;
+			return (VMLInteger)ReadUInt64();
 		}
 
 		uint16_t BinaryReader::ReadUInt16()
 		{
 			// little endien
-			auto bytes = ReadUBytes(2);
-			return ((uint16_t)bytes[1] << 8) + (uint16_t)bytes[10];
+			auto bytes = take(2);
+			return (uint16_t)(((uint16_t)bytes[1] << 8) + (uint16_t)bytes[0]);
 		}
 
 		int16_t BinaryReader::ReadInt16()
 		{
-			// little endien
-			auto bytes = ReadUBytes(2);
-			return ((int16_t)bytes[1] << 8) + (int16_t)bytes[0];
+			return (int16_t)ReadUInt16();
 		}
 
 		uint32_t BinaryReader::ReadUInt32()
 		{
 			// little endien
-			auto bytes = ReadUBytes(4);
+			auto bytes = take(4);
 			return ((uint32_t)bytes[3] << 24) + ((uint32_t)bytes[2] << 16) + ((uint32_t)bytes[1] << 8) + bytes[0];
 		}
 
 		int32_t BinaryReader::ReadInt32()
 		{
-			// little endien
-			auto bytes = ReadUBytes(4);
-			return ((int32_t)bytes[3] << 24) + ((int32_t)bytes[2] << 16) + ((int32_t)bytes[1] << 8) + (int32_t)bytes[0];
+			return (int32_t)ReadUInt32();
 		}
 
 		uint64_t BinaryReader::ReadUInt64()
 		{
 			// little endien
-			auto bytes = ReadUBytes(8);
+			auto bytes = take(8);
 			uint64_t result = ((uint64_t)bytes[7] << 56) + ((uint64_t)bytes[6] << 48) + ((uint64_t)bytes[5] << 40)
 				+ ((uint64_t)bytes[4] << 32) + ((uint64_t)bytes[3] << 24) + ((uint64_t)bytes[2] << 16) + ((uint64_t)bytes[1] << 8) + (uint64_t)bytes[0];
 			return result;
@@ -96,7 +108,7 @@ namespace neo
 
 		VMLInteger BinaryReader::ReadVarInt(unsigned long max)
 		{
-			char fb = ReadByte();
+			VMByte fb = ReadByte();
 			VMLInteger value;
 			if (fb == 0xFD)
 				value = ReadUInt16();
@@ -122,7 +134,7 @@ namespace neo
 
 		unsigned long long Helper::ReadVarInt(BinaryReader *reader, unsigned long long max)
 		{
-			char fb = reader->ReadByte();
+			VMByte fb = reader->ReadByte();
 			unsigned long long value;
 			if (fb == 0xFD)
 				value = reader->ReadUInt16();
@@ -138,10 +150,16 @@ namespace neo
 
 		std::string Helper::bytes_to_string(std::vector<char> bytes)
 		{
-			std::vector<char> str_bytes(bytes.size() + 1);
-			memcpy(str_bytes.data(), bytes.data(), bytes.size());
-			str_bytes[bytes.size()] = '\0';
-			return str_bytes.data();
+			return bytes_to_string(bytes.data(), bytes.size());
+		}
+
+		std::string Helper::bytes_to_string(const char *data, size_t size)
+		{
+			// stops at the first '\0' like a C string
+			if (size == 0)
+				return std::string();
+			auto end = (const char*)memchr(data, '\0', size);
+			return std::string(data, end ? end : data + size);
 		}
 
 		std::vector<char> Helper::string_content_to_chars(std::string str)
@@ -221,22 +239,37 @@ namespace neo
 			return (enum_value | flag) == enum_value;
 		}
 
-		std::vector<char> Helper::big_integer_to_chars(VMBigInteger num)
+		size_t Helper::hash_bytes(const char *data, size_t size)
 		{
-			// little endian
-			std::vector<char> array(8);
-			for (int i = 0; i < 8; i++)
-				array[i] = (char) (num >> (i * 8));
-			return array;
+			uint64_t hash = 14695981039346656037ULL;
+			for (size_t i = 0; i < size; i++)
+			{
+				hash ^= (VMByte)data[i];
+				hash *= 1099511628211ULL;
+			}
+			return (size_t)hash;
 		}
 
-		std::vector<VMByte> Helper::big_integer_to_bytes(VMBigInteger num)
+		size_t Helper::hash_int64(int64_t value)
 		{
-			// little endian
-			std::vector<VMByte> array(8);
-			for (int i = 0; i < 8; i++)
-				array[i] = (VMByte) (num >> (i * 8));
-			return array;
+			// 64-bit finalizer of MurmurHash3
+			uint64_t x = (uint64_t)value;
+			x ^= x >> 33;
+			x *= 0xff51afd7ed558ccdULL;
+			x ^= x >> 33;
+			return (size_t)x;
+		}
+
+		std::vector<char> Helper::big_integer_to_chars(const VMBigInteger &num)
+		{
+			// little endian two's complement, empty for zero
+			return num.to_byte_array();
+		}
+
+		std::vector<VMByte> Helper::big_integer_to_bytes(const VMBigInteger &num)
+		{
+			auto chars = num.to_byte_array();
+			return std::vector<VMByte>(chars.begin(), chars.end());
 		}
 
 		std::vector<VMByte> Helper::int16_to_bytes(int16_t num)
@@ -0,0 +1,453 @@
+#include <neovm/instruction.hpp>
+#include <neovm/helper.hpp>
+#include <neovm/exceptions.hpp>
+#include <neovm/interop_service.hpp>
+
+#include <utility>
+
+namespace neo
+{
+	namespace vm
+	{
+		InstructionHandler instruction_handler_of(OpCode opcode)
+		{
+			if (opcode >= OpCode::OP_PUSHBYTES1 && opcode <= OpCode::OP_PUSHBYTES75)
+				return IH_PUSHBYTES;
+			switch (opcode)
+			{
+			case OpCode::OP_PUSH0: return IH_PUSH0;
+			case OpCode::OP_PUSHDATA1:
+			case OpCode::OP_PUSHDATA2:
+			case OpCode::OP_PUSHDATA4: return IH_PUSHBYTES;
+			case OpCode::OP_PUSHM1:
+			case OpCode::OP_PUSH1:
+			case OpCode::OP_PUSH2:
+			case OpCode::OP_PUSH3:
+			case OpCode::OP_PUSH4:
+			case OpCode::OP_PUSH5:
+			case OpCode::OP_PUSH6:
+			case OpCode::OP_PUSH7:
+			case OpCode::OP_PUSH8:
+			case OpCode::OP_PUSH9:
+			case OpCode::OP_PUSH10:
+			case OpCode::OP_PUSH11:
+			case OpCode::OP_PUSH12:
+			case OpCode::OP_PUSH13:
+			case OpCode::OP_PUSH14:
+			case OpCode::OP_PUSH15:
+			case OpCode::OP_PUSH16: return IH_PUSHINT;
+
+			case OpCode::OP_NOP: return IH_NOP;
+			case OpCode::OP_JMP: return IH_JMP;
+			case OpCode::OP_JMPIF: return IH_JMPIF;
+			case OpCode::OP_JMPIFNOT: return IH_JMPIFNOT;
+			case OpCode::OP_CALL: return IH_CALL;
+			case OpCode::OP_RET: return IH_RET;
+			case OpCode::OP_APPCALL: return IH_APPCALL;
+			case OpCode::OP_TAILCALL: return IH_TAILCALL;
+			case OpCode::OP_SYSCALL: return IH_SYSCALL;
+
+			case OpCode::OP_DUPFROMALTSTACK: return IH_DUPFROMALTSTACK;
+			case OpCode::OP_TOALTSTACK: return IH_TOALTSTACK;
+			case OpCode::OP_FROMALTSTACK: return IH_FROMALTSTACK;
+			case OpCode::OP_XDROP: return IH_XDROP;
+			case OpCode::OP_XSWAP: return IH_XSWAP;
+			case OpCode::OP_XTUCK: return IH_XTUCK;
+			case OpCode::OP_DEPTH: return IH_DEPTH;
+			case OpCode::OP_DROP: return IH_DROP;
+			case OpCode::OP_DUP: return IH_DUP;
+			case OpCode::OP_NIP: return IH_NIP;
+			case OpCode::OP_OVER: return IH_OVER;
+			case OpCode::OP_PICK: return IH_PICK;
+			case OpCode::OP_ROLL: return IH_ROLL;
+			case OpCode::OP_ROT: return IH_ROT;
+			case OpCode::OP_SWAP: return IH_SWAP;
+			case OpCode::OP_TUCK: return IH_TUCK;
+
+			case OpCode::OP_CAT: return IH_CAT;
+			case OpCode::OP_SUBSTR: return IH_SUBSTR;
+			case OpCode::OP_LEFT: return IH_LEFT;
+			case OpCode::OP_RIGHT: return IH_RIGHT;
+			case OpCode::OP_SIZE: return IH_SIZE;
+
+			case OpCode::OP_INVERT: return IH_INVERT;
+			case OpCode::BIT_AND: return IH_AND;
+			case OpCode::BIT_OR: return IH_OR;
+			case OpCode::BIT_XOR: return IH_XOR;
+			case OpCode::OP_EQUAL: return IH_EQUAL;
+
+			case OpCode::OP_INC: return IH_INC;
+			case OpCode::OP_DEC: return IH_DEC;
+			case OpCode::OP_SIGN: return IH_SIGN;
+			case OpCode::OP_NEGATE: return IH_NEGATE;
+			case OpCode::OP_ABS: return IH_ABS;
+			case OpCode::OP_NOT: return IH_NOT;
+			case OpCode::OP_NZ: return IH_NZ;
+			case OpCode::OP_ADD: return IH_ADD;
+			case OpCode::OP_SUB: return IH_SUB;
+			case OpCode::OP_MUL: return IH_MUL;
+			case OpCode::OP_DIV: return IH_DIV;
+			case OpCode::OP_MOD: return IH_MOD;
+			case OpCode::OP_SHL: return IH_SHL;
+			case OpCode::OP_SHR: return IH_SHR;
+			case OpCode::OP_BOOLAND: return IH_BOOLAND;
+			case OpCode::OP_BOOLOR: return IH_BOOLOR;
+			case OpCode::OP_NUMEQUAL: return IH_NUMEQUAL;
+			case OpCode::OP_NUMNOTEQUAL: return IH_NUMNOTEQUAL;
+			case OpCode::OP_LT: return IH_LT;
+			case OpCode::OP_GT: return IH_GT;
+			case OpCode::OP_LTE: return IH_LTE;
+			case OpCode::OP_GTE: return IH_GTE;
+			case OpCode::OP_MIN: return IH_MIN;
+			case OpCode::OP_MAX: return IH_MAX;
+			case OpCode::OP_WITHIN: return IH_WITHIN;
+
+			case OpCode::OP_SHA1: return IH_SHA1;
+			case OpCode::OP_SHA256: return IH_SHA256;
+			case OpCode::OP_HASH160: return IH_HASH160;
+			case OpCode::OP_HASH256: return IH_HASH256;
+			case OpCode::OP_CHECKSIG: return IH_CHECKSIG;
+			case OpCode::OP_CHECKMULTISIG: return IH_CHECKMULTISIG;
+
+			case OpCode::OP_ARRAYSIZE: return IH_ARRAYSIZE;
+			case OpCode::OP_PACK: return IH_PACK;
+			case OpCode::OP_UNPACK: return IH_UNPACK;
+			case OpCode::OP_PICKITEM: return IH_PICKITEM;
+			case OpCode::OP_SETITEM: return IH_SETITEM;
+			case OpCode::OP_NEWARRAY: return IH_NEWARRAY;
+			case OpCode::OP_NEWSTRUCT: return IH_NEWSTRUCT;
+			case OpCode::OP_NEWMAP: return IH_NEWMAP;
+			case OpCode::OP_REMOVE: return IH_REMOVE;
+			case OpCode::OP_HASKEY: return IH_HASKEY;
+			case OpCode::OP_KEYS: return IH_KEYS;
+			case OpCode::OP_VALUES: return IH_VALUES;
+
+			case OpCode::OP_THROW: return IH_THROW;
+			case OpCode::OP_THROWIFNOT: return IH_THROWIFNOT;
+			default:
+				return IH_UNKNOWN;
+			}
+		}
+
+		uint8_t instruction_stack_inputs(InstructionHandler handler)
+		{
+			switch (handler)
+			{
+			case IH_JMPIF:
+			case IH_JMPIFNOT:
+			case IH_TOALTSTACK:
+			case IH_XDROP:
+			case IH_XSWAP:
+			case IH_XTUCK:
+			case IH_DROP:
+			case IH_DUP:
+			case IH_PICK:
+			case IH_ROLL:
+			case IH_SIZE:
+			case IH_INVERT:
+			case IH_INC:
+			case IH_DEC:
+			case IH_SIGN:
+			case IH_NEGATE:
+			case IH_ABS:
+			case IH_NOT:
+			case IH_NZ:
+			case IH_SHA1:
+			case IH_SHA256:
+			case IH_HASH160:
+			case IH_HASH256:
+			case IH_CHECKMULTISIG:
+			case IH_ARRAYSIZE:
+			case IH_PACK:
+			case IH_UNPACK:
+			case IH_NEWARRAY:
+			case IH_NEWSTRUCT:
+			case IH_KEYS:
+			case IH_VALUES:
+			case IH_THROWIFNOT:
+				return 1;
+			case IH_NIP:
+			case IH_OVER:
+			case IH_SWAP:
+			case IH_TUCK:
+			case IH_CAT:
+			case IH_LEFT:
+			case IH_RIGHT:
+			case IH_AND:
+			case IH_OR:
+			case IH_XOR:
+			case IH_EQUAL:
+			case IH_ADD:
+			case IH_SUB:
+			case IH_MUL:
+			case IH_DIV:
+			case IH_MOD:
+			case IH_SHL:
+			case IH_SHR:
+			case IH_BOOLAND:
+			case IH_BOOLOR:
+			case IH_NUMEQUAL:
+			case IH_NUMNOTEQUAL:
+			case IH_LT:
+			case IH_GT:
+			case IH_LTE:
+			case IH_GTE:
+			case IH_MIN:
+			case IH_MAX:
+			case IH_PICKITEM:
+			case IH_REMOVE:
+			case IH_HASKEY:
+			case IH_CHECKSIG:
+				return 2;
+			case IH_ROT:
+			case IH_SUBSTR:
+			case IH_WITHIN:
+			case IH_SETITEM:
+				return 3;
+			default:
+				return 0;
+			}
+		}
+
+		DecodedScript::DecodedScript(std::vector<char> script, bool neo_mode, const GasCostTable *gas_costs)
+			: _script(std::move(script)), _index_of_offset(_script.size() + 1, -1)
+		{
+			if (!gas_costs)
+				gas_costs = GasCostTable::default_table();
+			_gas_table_version = gas_costs->version();
+			// decode the linear sweep from offset 0 and, because a jump may land inside the operand of another
+			// instruction, also every jump target that is not yet an instruction boundary
+			BinaryReader reader(_script);
+			std::vector<uint32_t> pending;
+			std::vector<std::pair<uint32_t, uint32_t>> jumps; // (instruction index, target offset)
+			pending.push_back(0);
+			while (!pending.empty())
+			{
+				uint32_t offset = pending.back();
+				pending.pop_back();
+				if (_index_of_offset[offset] >= 0)
+					continue;
+				for (;;)
+				{
+					int64_t jump_offset = -1;
+					uint32_t next_offset = offset;
+					auto index = decode_one(&reader, offset, neo_mode, &jump_offset, &next_offset);
+					if (jump_offset >= 0)
+					{
+						jumps.push_back(std::make_pair(index, (uint32_t)jump_offset));
+						pending.push_back((uint32_t)jump_offset);
+					}
+					if (next_offset == offset)
+					{
+						// end of script or undecodable operand, never falls through
+						_instructions[index].next = index;
+						break;
+					}
+					if (_index_of_offset[next_offset] >= 0)
+					{
+						_instructions[index].next = (uint32_t)_index_of_offset[next_offset];
+						break;
+					}
+					_instructions[index].next = (uint32_t)_instructions.size();
+					offset = next_offset;
+				}
+			}
+			for (const auto &jump : jumps)
+			{
+				_instructions[jump.first].target = _index_of_offset[jump.second];
+			}
+			price_blocks(gas_costs);
+		}
+
+		namespace
+		{
+			// instructions after which execution doesn't simply fall through to next
+			inline bool ends_block(const Instruction &instruction)
+			{
+				switch (instruction.handler)
+				{
+				case IH_JMP:
+				case IH_JMPIF:
+				case IH_JMPIFNOT:
+				case IH_CALL:
+				case IH_RET:
+				case IH_APPCALL:
+				case IH_TAILCALL:
+				case IH_THROW:
+				case IH_THROWIFNOT:
+				case IH_UNKNOWN:
+				case IH_BADOPERAND:
+					return true;
+				default:
+					return false;
+				}
+			}
+		}
+
+		void DecodedScript::price_blocks(const GasCostTable *gas_costs)
+		{
+			// a block starts at the entry, at jump targets, after block ends and where fall-through paths merge
+			auto count = _instructions.size();
+			std::vector<uint32_t> fall_through_count(count, 0);
+			std::vector<bool> leader(count, false);
+			for (size_t i = 0; i < count; i++)
+			{
+				const auto &instruction = _instructions[i];
+				if (instruction.target >= 0)
+					leader[instruction.target] = true;
+				if (instruction.next == i)
+					continue;
+				if (ends_block(instruction))
+					leader[instruction.next] = true;
+				else
+					++fall_through_count[instruction.next];
+			}
+			for (size_t i = 0; i < count; i++)
+			{
+				if (fall_through_count[i] != 1)
+					leader[i] = true;
+			}
+			for (size_t i = 0; i < count; i++)
+			{
+				_instructions[i].block_gas = 0;
+				if (!leader[i])
+					continue;
+				int64_t gas = 0;
+				size_t index = i;
+				for (;;)
+				{
+					const auto &instruction = _instructions[index];
+					gas += gas_costs->opcode_cost((OpCode)instruction.opcode);
+					if (instruction.handler == IH_SYSCALL && instruction.service_id != NEOVM_UNKNOWN_SERVICE_ID)
+						gas += gas_costs->service_cost(instruction.service_id);
+					if (ends_block(instruction) || instruction.next == index || leader[instruction.next])
+						break;
+					index = instruction.next;
+				}
+				_instructions[i].block_gas = gas;
+			}
+		}
+
+		uint32_t DecodedScript::decode_one(BinaryReader *reader, uint32_t offset, bool neo_mode, int64_t *jump_offset, uint32_t *next_offset)
+		{
+			Instruction instruction = Instruction();
+			instruction.offset = offset;
+			instruction.target = -1;
+			instruction.service_id = NEOVM_UNKNOWN_SERVICE_ID;
+			if (offset >= _script.size())
+			{
+				// running off the end of a script returns from it
+				instruction.opcode = OpCode::OP_RET;
+				instruction.handler = IH_RET;
+				*next_offset = offset;
+			}
+			else
+			{
+				auto opcode = (OpCode)((VMByte)_script[offset]);
+				instruction.opcode = (VMByte)opcode;
+				instruction.handler = (uint16_t)instruction_handler_of(opcode);
+				reader->Seek(offset + 1, BinaryReader::BEGIN);
+				try
+				{
+					size_t data_size = 0;
+					bool has_data = false;
+					switch (instruction.handler)
+					{
+					case IH_PUSHBYTES:
+					{
+						has_data = true;
+						if (opcode == OpCode::OP_PUSHDATA1)
+							data_size = reader->ReadByte();
+						else if (opcode == OpCode::OP_PUSHDATA2)
+							data_size = reader->ReadUInt16();
+						else if (opcode == OpCode::OP_PUSHDATA4)
+						{
+							auto size = reader->ReadInt32();
+							if (size < 0)
+								throw NeoVmException("invalid PUSHDATA4 size");
+							data_size = (size_t)size;
+						}
+						else
+							data_size = (size_t)opcode;
+					}
+					break;
+					case IH_PUSHINT:
+						instruction.value = (int)opcode - (int)OpCode::OP_PUSH1 + 1;
+						break;
+					case IH_JMP:
+					case IH_JMPIF:
+					case IH_JMPIFNOT:
+					case IH_CALL:
+					{
+						int64_t target = (int64_t)offset + reader->ReadInt16();
+						if (target >= 0 && target <= (int64_t)_script.size())
+							*jump_offset = target;
+					}
+					break;
+					case IH_APPCALL:
+					case IH_TAILCALL:
+						has_data = true;
+						data_size = neo_mode ? 20 : reader->ReadUInt32();
+						break;
+					case IH_SYSCALL:
+						has_data = true;
+						data_size = (size_t)Helper::ReadVarInt(reader, 252);
+						break;
+					default:
+						break;
+					}
+					if (has_data)
+					{
+						auto data = reader->ReadSpan(data_size);
+						instruction.data_offset = (uint32_t)(data.data - _script.data());
+						instruction.data_size = (uint32_t)data.size;
+						if (instruction.handler == IH_SYSCALL)
+							instruction.service_id = find_service_id(Helper::bytes_to_string(data.data, data.size));
+					}
+					*next_offset = (uint32_t)reader->position();
+				}
+				catch (NeoVmException&)
+				{
+					instruction.handler = IH_BADOPERAND;
+					*jump_offset = -1;
+					*next_offset = offset;
+				}
+			}
+			instruction.stack_inputs = instruction_stack_inputs((InstructionHandler)instruction.handler);
+			auto index = (uint32_t)_instructions.size();
+			_instructions.push_back(instruction);
+			_index_of_offset[offset] = (int32_t)index;
+			return index;
+		}
+
+		const std::vector<char> &DecodedScript::script() const
+		{
+			return _script;
+		}
+
+		const Instruction *DecodedScript::instructions() const
+		{
+			return _instructions.data();
+		}
+
+		size_t DecodedScript::instructions_count() const
+		{
+			return _instructions.size();
+		}
+
+		size_t DecodedScript::memory_size() const
+		{
+			return sizeof(DecodedScript) + _script.capacity()
+				+ _instructions.capacity() * sizeof(Instruction)
+				+ _index_of_offset.capacity() * sizeof(int32_t);
+		}
+
+		int32_t DecodedScript::index_of(size_t offset) const
+		{
+			if (offset >= _index_of_offset.size())
+				return -1;
+			return _index_of_offset[offset];
+		}
+
+	}
+}
@@ -3,14 +3,55 @@
 #include <neovm/execution_context.hpp>
 #include <neovm/types.hpp>
 #include <neovm/exceptions.hpp>
+#include <neovm/json.hpp>
+#include <neovm/serialization.hpp>
+#include <neovm/storage.hpp>
 
 #include <iostream>
+#include <mutex>
+#include <unordered_map>
 
 namespace neo
 {
 	namespace vm
 	{
+		namespace
+		{
+			struct ServiceNames
+			{
+				std::mutex mutex;
+				std::unordered_map<std::string, uint32_t> ids;
+			};
+
+			ServiceNames &service_names()
+			{
+				static ServiceNames names;
+				return names;
+			}
+		}
+
+		uint32_t intern_service_name(const std::string &method)
+		{
+			auto &names = service_names();
+			std::lock_guard<std::mutex> lock(names.mutex);
+			auto found = names.ids.find(method);
+			if (found != names.ids.end())
+				return found->second;
+			auto id = (uint32_t)names.ids.size();
+			names.ids[method] = id;
+			return id;
+		}
+
+		uint32_t find_service_id(const std::string &method)
+		{
+			auto &names = service_names();
+			std::lock_guard<std::mutex> lock(names.mutex);
+			auto found = names.ids.find(method);
+			return found == names.ids.end() ? NEOVM_UNKNOWN_SERVICE_ID : found->second;
+		}
+
 		InteropService::InteropService()
+			: _frozen(false)
 		{
 			register_service("System.ExecutionEngine.GetScriptContainer", GetScriptContainer);
 			register_service("System.ExecutionEngine.GetExecutingScriptHash", GetExecutingScriptHash);
@@ -20,23 +61,54 @@ namespace neo
 			register_service("System.ExecutionEngine.SetGlobal", SetGlobalVariable);
 			register_service("System.ExecutionEngine.GetGlobal", GetGlobalVariable);
 
-			// TODO: json_loads service
+			register_service("json_dumps", JsonDumps);
+			register_service("json_loads", JsonLoads);
+
+			register_service("Neo.Runtime.Serialize", Serialize);
+			register_service("Neo.Runtime.Deserialize", Deserialize);
+			register_service("System.Runtime.Serialize", Serialize);
+			register_service("System.Runtime.Deserialize", Deserialize);
+
+			register_service("Neo.Storage.GetContext", StorageGetContext);
+			register_service("Neo.Storage.Get", StorageGet);
+			register_service("Neo.Storage.Put", StoragePut);
+			register_service("Neo.Storage.Delete", StorageDelete);
+			register_service("System.Storage.GetContext", StorageGetContext);
+			register_service("System.Storage.Get", StorageGet);
+			register_service("System.Storage.Put", StoragePut);
+			register_service("System.Storage.Delete", StorageDelete);
 		}
 
 		void InteropService::register_service(std::string method, std::function<bool(ExecutionEngine*)> handler)
 		{
-			_dictionary[method] = handler;
+			if (_frozen)
+				throw NeoVmException("can't register a service in a frozen interop service");
+			auto id = intern_service_name(method);
+			if (id >= _handlers.size())
+				_handlers.resize(id + 1);
+			_handlers[id] = handler;
 		}
 
 		void InteropService::clear_services()
 		{
-			_dictionary.clear();
+			if (_frozen)
+				throw NeoVmException("can't clear a frozen interop service");
+			_handlers.clear();
+		}
+
+		void InteropService::freeze()
+		{
+			_frozen = true;
+		}
+
+		bool InteropService::is_frozen() const
+		{
+			return _frozen;
 		}
 
 		bool InteropService::invoke(std::string method, ExecutionEngine *engine)
 		{
-			if (_dictionary.find(method) == _dictionary.end()) return false;
-			return _dictionary[method](engine);
+			return invoke(find_service_id(method), engine);
 		}
 
 		bool InteropService::GetScriptContainer(ExecutionEngine *engine)
@@ -67,11 +139,11 @@ namespace neo
 		{
 			auto value = engine->evaluation_stack()->pop();
 			auto name = engine->evaluation_stack()->pop();
-			if (name->type() != StackItemType::SIT_BYTE_ARRAY)
+			if (name.type() != StackItemType::SIT_BYTE_ARRAY)
 			{
 				throw NeoVmException("global variable name must be string");
 			}
-			auto name_str = name->GetString();
+			auto name_str = name.GetString();
 			if (name_str.empty())
 			{
 				throw NeoVmException("global env key can't be empty string");
@@ -79,14 +151,14 @@ namespace neo
 			if (name_str.size() > GLOBAL_ENV_KEY_MAX_LENGTH) {
 				throw NeoVmException("too long string for global env key");
 			}
-			engine->register_global_variable(name_str, value);
+			engine->register_global_variable(name_str, value.to_stack_item(engine));
 			return true;
 		}
 
 		bool InteropService::GetGlobalVariable(ExecutionEngine *engine)
 		{
 			auto name = engine->evaluation_stack()->pop();
-			auto name_str = name->GetString();
+			auto name_str = name.GetString();
 			if (name_str.empty())
 			{
 				throw NeoVmException("global env key can't be empty string");
@@ -108,5 +180,117 @@ namespace neo
 			return true;
 		}
 
+		bool InteropService::JsonDumps(ExecutionEngine *engine)
+		{
+			// the buffer keeps its capacity from one call to the next
+			static thread_local JsonWriter writer;
+			writer.clear();
+			writer.write(engine->evaluation_stack()->pop());
+			const auto &json = writer.str();
+			engine->evaluation_stack()->push(StackItem::to_stack_item(engine, std::vector<char>(json.begin(), json.end())));
+			return true;
+		}
+
+		bool InteropService::JsonLoads(ExecutionEngine *engine)
+		{
+			auto json = engine->evaluation_stack()->pop();
+			if (json.type() != StackItemType::SIT_BYTE_ARRAY)
+			{
+				throw NeoVmException("json_loads argument must be string");
+			}
+			auto data = json.GetByteArray();
+			engine->evaluation_stack()->push(json_loads(engine, data.data(), data.size()));
+			return true;
+		}
+
+		bool InteropService::Serialize(ExecutionEngine *engine)
+		{
+			// the buffer keeps its capacity from one call to the next
+			static thread_local std::vector<char> buffer;
+			buffer.clear();
+			serialize_stack_item(engine->evaluation_stack()->pop(), &buffer);
+			engine->evaluation_stack()->push(new (engine->memory_resource()) ByteArray(engine, buffer.data(), buffer.size()));
+			return true;
+		}
+
+		bool InteropService::Deserialize(ExecutionEngine *engine)
+		{
+			auto data = engine->evaluation_stack()->pop();
+			if (data.type() == StackItemType::SIT_BYTE_ARRAY)
+			{
+				// read the bytes in place
+				auto span = ((ByteArray*)data.item())->span();
+				engine->evaluation_stack()->push(deserialize_stack_item(engine, span.data, span.size));
+			}
+			else
+			{
+				auto bytes = data.GetByteArray();
+				engine->evaluation_stack()->push(deserialize_stack_item(engine, bytes.data(), bytes.size()));
+			}
+			return true;
+		}
+
+		namespace
+		{
+			IStorage *engine_storage(ExecutionEngine *engine)
+			{
+				auto storage = engine->storage();
+				if (!storage)
+					throw NeoVmException("no storage attached to the engine");
+				return storage;
+			}
+
+			// pops the context and the key, the storage key of the entry
+			std::string pop_storage_key(ExecutionEngine *engine)
+			{
+				auto context = engine->evaluation_stack()->pop().GetByteArray();
+				auto key = engine->evaluation_stack()->pop().GetByteArray();
+				if (key.size() > NEOVM_MAX_STORAGE_KEY_SIZE)
+					throw NeoVmException("too long storage key");
+				return contract_storage_key(context.data(), context.size(), key.data(), key.size());
+			}
+
+			void check_own_context(ExecutionEngine *engine)
+			{
+				auto context = engine->evaluation_stack()->peek(0);
+				if (context.GetByteArray() != engine->current_context()->script_id())
+					throw NeoVmException("can't write the storage of another contract");
+			}
+		}
+
+		bool InteropService::StorageGetContext(ExecutionEngine *engine)
+		{
+			engine->evaluation_stack()->push(StackItem::to_stack_item(engine, engine->current_context()->script_id()));
+			return true;
+		}
+
+		bool InteropService::StorageGet(ExecutionEngine *engine)
+		{
+			auto storage = engine_storage(engine);
+			auto key = pop_storage_key(engine);
+			std::vector<char> value;
+			storage->get(key, &value);
+			engine->evaluation_stack()->push(StackItem::to_stack_item(engine, std::move(value)));
+			return true;
+		}
+
+		bool InteropService::StoragePut(ExecutionEngine *engine)
+		{
+			auto storage = engine_storage(engine);
+			check_own_context(engine);
+			auto key = pop_storage_key(engine);
+			auto value = engine->evaluation_stack()->pop().GetByteArray();
+			storage->put(key, value);
+			return true;
+		}
+
+		bool InteropService::StorageDelete(ExecutionEngine *engine)
+		{
+			auto storage = engine_storage(engine);
+			check_own_context(engine);
+			storage->remove(pop_storage_key(engine));
+			return true;
+		}
+
 	}
 }
\ No newline at end of file
@@ -0,0 +1,362 @@
+#include <neovm/json.hpp>
+#include <neovm/stack_value.hpp>
+#include <neovm/types.hpp>
+#include <neovm/exceptions.hpp>
+#include <cstring>
+
+namespace neo
+{
+	namespace vm
+	{
+		void JsonWriter::write(const StackValue &value)
+		{
+			if (!value.is_inline())
+				value.item()->write_json(this);
+			else if (value.type() == StackItemType::SIT_INTEGER)
+				write_integer(VMBigInteger(value.GetInt64()));
+			else
+				write_bool(value.GetBoolean());
+		}
+
+		void JsonWriter::write_string(const char *data, size_t size)
+		{
+			static const char hex[] = "0123456789abcdef";
+			_buffer.push_back('"');
+			size_t start = 0;
+			for (size_t i = 0; i < size; i++)
+			{
+				auto c = (VMByte)data[i];
+				if (c >= 0x20 && c != '"' && c != '\\')
+					continue;
+				// copy the run of plain bytes at once
+				_buffer.append(data + start, i - start);
+				start = i + 1;
+				switch (c)
+				{
+				case '"': _buffer.append("\\\"", 2); break;
+				case '\\': _buffer.append("\\\\", 2); break;
+				case '\b': _buffer.append("\\b", 2); break;
+				case '\t': _buffer.append("\\t", 2); break;
+				case '\n': _buffer.append("\\n", 2); break;
+				case '\f': _buffer.append("\\f", 2); break;
+				case '\r': _buffer.append("\\r", 2); break;
+				default:
+				{
+					char escaped[6] = { '\\', 'u', '0', '0', hex[c >> 4], hex[c & 0xF] };
+					_buffer.append(escaped, 6);
+				}
+				}
+			}
+			_buffer.append(data + start, size - start);
+			_buffer.push_back('"');
+		}
+
+		void JsonWriter::write_integer(const VMBigInteger &value)
+		{
+			if (!value.is_small())
+			{
+				_buffer.append(value.to_string());
+				return;
+			}
+			int64_t n = value.small_value();
+			// digits are produced backwards, the magnitude of INT64_MIN only fits unsigned
+			char digits[20];
+			size_t count = 0;
+			uint64_t magnitude = n < 0 ? (uint64_t)0 - (uint64_t)n : (uint64_t)n;
+			do
+			{
+				digits[count++] = (char)('0' + magnitude % 10);
+				magnitude /= 10;
+			} while (magnitude > 0);
+			if (n < 0)
+				_buffer.push_back('-');
+			while (count > 0)
+				_buffer.push_back(digits[--count]);
+		}
+
+		void JsonWriter::write_bool(bool value)
+		{
+			if (value)
+				_buffer.append("true", 4);
+			else
+				_buffer.append("false", 5);
+		}
+
+		void JsonWriter::enter(const StackItem *container)
+		{
+			if (!_path.insert(container).second)
+				throw NeoVmException("circular reference in json");
+			if (_path.size() > JSON_MAX_REFERENCE_OBJECT_COUNT)
+				throw NeoVmException("too many objects referenced in json");
+		}
+
+		namespace
+		{
+			class JsonParser
+			{
+			private:
+				ExecutionEngine *_engine;
+				const char *_pos;
+				const char *_end;
+				size_t _depth;
+			public:
+				JsonParser(ExecutionEngine *engine, const char *data, size_t size)
+					: _engine(engine), _pos(data), _end(data + size), _depth(0) {}
+
+				StackItem *parse_document()
+				{
+					auto item = parse_value();
+					skip_spaces();
+					if (_pos != _end)
+						throw NeoVmException("unexpected data after json value");
+					return item;
+				}
+
+			private:
+				inline void skip_spaces()
+				{
+					while (_pos < _end && (*_pos == ' ' || *_pos == '\t' || *_pos == '\n' || *_pos == '\r'))
+						++_pos;
+				}
+
+				inline bool consume(char c)
+				{
+					skip_spaces();
+					if (_pos < _end && *_pos == c)
+					{
+						++_pos;
+						return true;
+					}
+					return false;
+				}
+
+				inline void expect(char c)
+				{
+					if (!consume(c))
+						throw NeoVmException(std::string("invalid json, expected '") + c + "'");
+				}
+
+				void expect_literal(const char *literal, size_t size)
+				{
+					if ((size_t)(_end - _pos) < size || memcmp(_pos, literal, size) != 0)
+						throw NeoVmException("invalid json literal");
+					_pos += size;
+				}
+
+				StackItem *parse_value()
+				{
+					skip_spaces();
+					if (_pos >= _end)
+						throw NeoVmException("unexpected end of json");
+					switch (*_pos)
+					{
+					case '{': return parse_object();
+					case '[': return parse_array();
+					case '"': return StackItem::to_stack_item(_engine, parse_string());
+					case 't':
+						expect_literal("true", 4);
+						return StackItem::to_stack_item_from_bool(_engine, true);
+					case 'f':
+						expect_literal("false", 5);
+						return StackItem::to_stack_item_from_bool(_engine, false);
+					case 'n':
+						expect_literal("null", 4);
+						return StackItem::to_stack_item_from_bool(_engine, false);
+					default:
+						return parse_number();
+					}
+				}
+
+				void enter()
+				{
+					// the parser recurses, so the limit keeps deep input from overflowing the thread's stack
+					if (++_depth > NEOVM_MAX_SERIALIZE_DEPTH)
+						throw NeoVmException("too deeply nested json");
+				}
+
+				StackItem *parse_object()
+				{
+					enter();
+					++_pos;
+					auto map = (Map*)StackItem::to_stack_map_item(_engine);
+					if (!consume('}'))
+					{
+						do
+						{
+							skip_spaces();
+							if (_pos >= _end || *_pos != '"')
+								throw NeoVmException("invalid json, object key must be a string");
+							auto key = StackItem::to_stack_item(_engine, parse_string());
+							expect(':');
+							map->put(key, parse_value());
+						} while (consume(','));
+						expect('}');
+					}
+					--_depth;
+					return map;
+				}
+
+				StackItem *parse_array()
+				{
+					enter();
+					++_pos;
+					std::vector<StackItem*> items;
+					if (!consume(']'))
+					{
+						do
+						{
+							items.push_back(parse_value());
+						} while (consume(','));
+						expect(']');
+					}
+					--_depth;
+					return StackItem::to_stack_item(_engine, items);
+				}
+
+				StackItem *parse_number()
+				{
+					bool negative = false;
+					if (_pos < _end && *_pos == '-')
+					{
+						negative = true;
+						++_pos;
+					}
+					if (_pos >= _end || *_pos < '0' || *_pos > '9')
+						throw NeoVmException("invalid json value");
+					// accumulate in 64 bits and only go to the big integer when the value needs it
+					uint64_t small = 0;
+					VMBigInteger big;
+					bool is_big = false;
+					for (; _pos < _end && *_pos >= '0' && *_pos <= '9'; ++_pos)
+					{
+						int digit = *_pos - '0';
+						if (!is_big && small <= (UINT64_MAX - digit) / 10)
+						{
+							small = small * 10 + digit;
+							continue;
+						}
+						if (!is_big)
+						{
+							big = VMBigInteger(small);
+							is_big = true;
+						}
+						big = big * 10 + digit;
+						// one byte of slack, a negative value can take one byte less than its magnitude
+						if (big.byte_size() > NEOVM_MAX_BIGINTEGER_SIZE + 1)
+							throw NeoVmException("json number too large");
+					}
+					if (_pos < _end && (*_pos == '.' || *_pos == 'e' || *_pos == 'E'))
+						throw NeoVmException("json numbers must be integers in the vm");
+					VMBigInteger value = is_big ? big : VMBigInteger(small);
+					if (negative)
+						value = -value;
+					if (!value.is_small() && value.byte_size() > NEOVM_MAX_BIGINTEGER_SIZE)
+						throw NeoVmException("json number too large");
+					return StackItem::to_stack_item(_engine, value);
+				}
+
+				int parse_hex4()
+				{
+					if (_end - _pos < 4)
+						throw NeoVmException("invalid json unicode escape");
+					int code = 0;
+					for (int i = 0; i < 4; i++)
+					{
+						char c = *_pos++;
+						code <<= 4;
+						if (c >= '0' && c <= '9')
+							code |= c - '0';
+						else if (c >= 'a' && c <= 'f')
+							code |= c - 'a' + 10;
+						else if (c >= 'A' && c <= 'F')
+							code |= c - 'A' + 10;
+						else
+							throw NeoVmException("invalid json unicode escape");
+					}
+					return code;
+				}
+
+				static void append_utf8(std::vector<char> *out, uint32_t code)
+				{
+					if (code < 0x80)
+						out->push_back((char)code);
+					else if (code < 0x800)
+					{
+						out->push_back((char)(0xC0 | (code >> 6)));
+						out->push_back((char)(0x80 | (code & 0x3F)));
+					}
+					else if (code < 0x10000)
+					{
+						out->push_back((char)(0xE0 | (code >> 12)));
+						out->push_back((char)(0x80 | ((code >> 6) & 0x3F)));
+						out->push_back((char)(0x80 | (code & 0x3F)));
+					}
+					else
+					{
+						out->push_back((char)(0xF0 | (code >> 18)));
+						out->push_back((char)(0x80 | ((code >> 12) & 0x3F)));
+						out->push_back((char)(0x80 | ((code >> 6) & 0x3F)));
+						out->push_back((char)(0x80 | (code & 0x3F)));
+					}
+				}
+
+				std::vector<char> parse_string()
+				{
+					++_pos;
+					std::vector<char> result;
+					for (;;)
+					{
+						// copy the run of plain characters at once
+						auto start = _pos;
+						while (_pos < _end && *_pos != '"' && *_pos != '\\')
+							++_pos;
+						result.insert(result.end(), start, _pos);
+						if (_pos >= _end)
+							throw NeoVmException("unterminated json string");
+						if (*_pos++ == '"')
+							return result;
+						if (_pos >= _end)
+							throw NeoVmException("unterminated json string");
+						char c = *_pos++;
+						switch (c)
+						{
+						case '"':
+						case '\\':
+						case '/':
+							result.push_back(c);
+							break;
+						case 'b': result.push_back('\b'); break;
+						case 'f': result.push_back('\f'); break;
+						case 'n': result.push_back('\n'); break;
+						case 'r': result.push_back('\r'); break;
+						case 't': result.push_back('\t'); break;
+						case 'u':
+						{
+							uint32_t code = (uint32_t)parse_hex4();
+							if (code >= 0xD800 && code < 0xDC00 && _end - _pos >= 6 && _pos[0] == '\\' && _pos[1] == 'u')
+							{
+								// surrogate pair
+								_pos += 2;
+								uint32_t low = (uint32_t)parse_hex4();
+								if (low < 0xDC00 || low >= 0xE000)
+									throw NeoVmException("invalid json surrogate pair");
+								code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+							}
+							append_utf8(&result, code);
+						}
+						break;
+						default:
+							throw NeoVmException("invalid json escape");
+						}
+					}
+				}
+			};
+		}
+
+		StackItem *json_loads(ExecutionEngine *engine, const char *data, size_t size)
+		{
+			JsonParser parser(engine, data, size);
+			return parser.parse_document();
+		}
+	}
+}
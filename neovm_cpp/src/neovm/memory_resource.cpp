@@ -0,0 +1,135 @@
+#include <neovm/memory_resource.hpp>
+#include <neovm/exceptions.hpp>
+#include <new>
+#include <string.h>
+
+namespace neo
+{
+	namespace vm
+	{
+		namespace
+		{
+			class NewDeleteResource : public MemoryResource
+			{
+			public:
+				virtual void *allocate(size_t bytes)
+				{
+					return ::operator new(bytes);
+				}
+
+				virtual void deallocate(void *p, size_t bytes)
+				{
+					::operator delete(p);
+				}
+			};
+
+			inline size_t align_size(size_t bytes)
+			{
+				if (bytes == 0)
+					return NEOVM_MEMORY_ALIGNMENT;
+				return (bytes + NEOVM_MEMORY_ALIGNMENT - 1) & ~((size_t)NEOVM_MEMORY_ALIGNMENT - 1);
+			}
+		}
+
+		MemoryResource *new_delete_resource()
+		{
+			static NewDeleteResource resource;
+			return &resource;
+		}
+
+		ArenaResource::ArenaResource(size_t chunk_size)
+			: _chunk_size(align_size(chunk_size)), _current_chunk(0), _cursor(nullptr), _end(nullptr)
+		{
+			memset(_free_lists, 0, sizeof(_free_lists));
+		}
+
+		ArenaResource::~ArenaResource()
+		{
+			for (auto block : _large_blocks)
+			{
+				::operator delete(block);
+			}
+			for (auto chunk : _chunks)
+			{
+				::operator delete(chunk);
+			}
+		}
+
+		void *ArenaResource::allocate(size_t bytes)
+		{
+			bytes = align_size(bytes);
+			if (bytes > NEOVM_ARENA_MAX_SMALL_BLOCK)
+			{
+				auto block = ::operator new(bytes);
+				_large_blocks.insert(block);
+				return block;
+			}
+			auto &free_list = _free_lists[bytes / NEOVM_MEMORY_ALIGNMENT - 1];
+			if (free_list)
+			{
+				auto block = free_list;
+				free_list = block->next;
+				return block;
+			}
+			return allocate_from_chunks(bytes);
+		}
+
+		void *ArenaResource::allocate_from_chunks(size_t bytes)
+		{
+			if (_cursor && (size_t)(_end - _cursor) >= bytes)
+			{
+				auto block = _cursor;
+				_cursor += bytes;
+				return block;
+			}
+			// the rest of the current chunk is wasted until reset
+			if (_cursor)
+				++_current_chunk;
+			if (_current_chunk >= _chunks.size())
+			{
+				_chunks.push_back((char*) ::operator new(_chunk_size));
+				_current_chunk = _chunks.size() - 1;
+			}
+			_cursor = _chunks[_current_chunk];
+			_end = _cursor + _chunk_size;
+			auto block = _cursor;
+			_cursor += bytes;
+			return block;
+		}
+
+		void ArenaResource::deallocate(void *p, size_t bytes)
+		{
+			if (!p)
+				return;
+			bytes = align_size(bytes);
+			if (bytes > NEOVM_ARENA_MAX_SMALL_BLOCK)
+			{
+				if (_large_blocks.erase(p) > 0)
+					::operator delete(p);
+				return;
+			}
+			auto block = (FreeBlock*)p;
+			auto &free_list = _free_lists[bytes / NEOVM_MEMORY_ALIGNMENT - 1];
+			block->next = free_list;
+			free_list = block;
+		}
+
+		void ArenaResource::reset()
+		{
+			for (auto block : _large_blocks)
+			{
+				::operator delete(block);
+			}
+			_large_blocks.clear();
+			memset(_free_lists, 0, sizeof(_free_lists));
+			_current_chunk = 0;
+			_cursor = nullptr;
+			_end = nullptr;
+		}
+
+		size_t ArenaResource::reserved_size() const
+		{
+			return _chunks.size() * _chunk_size;
+		}
+	}
+}
@@ -130,6 +130,11 @@ namespace neo
 			opcode_name_pair(OP_SETITEM),
 			opcode_name_pair(OP_NEWARRAY),
 			opcode_name_pair(OP_NEWSTRUCT),
+			opcode_name_pair(OP_NEWMAP),
+			opcode_name_pair(OP_REMOVE),
+			opcode_name_pair(OP_HASKEY),
+			opcode_name_pair(OP_KEYS),
+			opcode_name_pair(OP_VALUES),
 
 			// Exceptions
 			opcode_name_pair(OP_THROW),
@@ -138,11 +143,13 @@ namespace neo
 
 		std::string op_code_to_str(OpCode opcode)
 		{
-			if (opcode_names_map.find(opcode) == opcode_names_map.end())
+			// find only, engines on several threads read the map at once
+			auto found = opcode_names_map.find(opcode);
+			if (found == opcode_names_map.end())
 			{
 				return std::to_string(opcode);
 			}
-			return opcode_names_map[opcode];
+			return found->second;
 		}
 	}
 }
\ No newline at end of file
@@ -0,0 +1,45 @@
+#include <neovm/parallel_crypto.hpp>
+
+namespace neo
+{
+	namespace vm
+	{
+		ParallelCrypto::ParallelCrypto(ICrypto *crypto, ThreadPool *pool, size_t min_parallel_checks)
+			: _crypto(crypto), _pool(pool), _min_parallel_checks(min_parallel_checks)
+		{
+		}
+
+		std::vector<char> ParallelCrypto::Hash160(std::vector<char> message)
+		{
+			return _crypto->Hash160(std::move(message));
+		}
+
+		std::vector<char> ParallelCrypto::Hash256(std::vector<char> message)
+		{
+			return _crypto->Hash256(std::move(message));
+		}
+
+		bool ParallelCrypto::VerifySignature(std::vector<char> message, std::vector<char> signature, std::vector<char> pubkey)
+		{
+			return _crypto->VerifySignature(std::move(message), std::move(signature), std::move(pubkey));
+		}
+
+		void ParallelCrypto::VerifySignatures(const std::vector<SignatureCheck> &checks, bool *results)
+		{
+			if (checks.size() < _min_parallel_checks || _pool->concurrency() < 2)
+			{
+				_crypto->VerifySignatures(checks, results);
+				return;
+			}
+			// a few chunks per thread so they balance out, each chunk still goes through the batch call of the wrapped crypto
+			size_t chunk = (checks.size() + _pool->concurrency() * 4 - 1) / (_pool->concurrency() * 4);
+			size_t tasks = (checks.size() + chunk - 1) / chunk;
+			_pool->parallel_for(tasks, [&](size_t task) {
+				size_t begin = task * chunk;
+				size_t end = begin + chunk < checks.size() ? begin + chunk : checks.size();
+				std::vector<SignatureCheck> part(checks.begin() + begin, checks.begin() + end);
+				_crypto->VerifySignatures(part, results + begin);
+			});
+		}
+	}
+}
@@ -0,0 +1,92 @@
+#include <neovm/parallel_executor.hpp>
+#include <future>
+#include <memory>
+
+namespace neo
+{
+	namespace vm
+	{
+		ParallelBlockExecutor::ParallelBlockExecutor(EnginePool *pool)
+			: _pool(pool), _executions(0)
+		{
+		}
+
+		std::vector<EngineJobResult> ParallelBlockExecutor::execute(const std::vector<BlockTransaction> &transactions, IStorage *storage)
+		{
+			size_t count = transactions.size();
+			std::vector<EngineJobResult> results(count);
+			std::vector<std::unique_ptr<RecordingStorage>> views(count);
+			StorageOverlay state(storage); // the writes of the transactions committed so far
+			std::unordered_set<std::string> written; // keys written by the transactions committed so far
+
+			auto job = [&views, &transactions](size_t i, IStorage *base) {
+				views[i].reset(new RecordingStorage(base));
+				auto view = views[i].get();
+				const auto &transaction = transactions[i];
+				return [view, &transaction](ExecutionEngine *engine) {
+					engine->set_storage(view);
+					return EnginePool::run_script(engine, transaction.script, transaction.script_id, transaction.container, transaction.gas_limit);
+				};
+			};
+
+			// every transaction runs against the storage at the start of the block, which isn't written until the end,
+			// while the earlier ones are validated
+			std::vector<std::future<EngineJobResult>> speculative;
+			// the speculative runs write views, so an exception must not leave before they have finished
+			struct WaitAll
+			{
+				std::vector<std::future<EngineJobResult>> *futures;
+				~WaitAll()
+				{
+					for (auto &future : *futures)
+					{
+						if (future.valid())
+							future.wait();
+					}
+				}
+			} wait_all = { &speculative };
+			speculative.reserve(count);
+			for (size_t i = 0; i < count; i++)
+				speculative.push_back(_pool->run(job(i, storage)));
+			_executions = count;
+
+			for (size_t i = 0; i < count; i++)
+			{
+				results[i] = speculative[i].get();
+				bool valid = true;
+				for (const auto &key : views[i]->reads())
+				{
+					if (written.find(key) != written.end())
+					{
+						valid = false;
+						break;
+					}
+				}
+				if (!valid)
+				{
+					// all transactions before it are committed, so running it again on the block state gives its serial outcome.
+					// it runs right here, on the pool it would queue behind the speculative runs still outstanding
+					results[i] = _pool->call(job(i, &state));
+					++_executions;
+				}
+				if (results[i].state & VMState::FAULT)
+					continue;
+				for (const auto &write : views[i]->writes())
+				{
+					if (write.second.removed)
+						state.remove(write.first);
+					else
+						state.put(write.first, write.second.value);
+					written.insert(write.first);
+				}
+			}
+			state.commit();
+			return results;
+		}
+
+		size_t ParallelBlockExecutor::executions() const
+		{
+			return _executions;
+		}
+	}
+}
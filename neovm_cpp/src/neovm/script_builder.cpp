@@ -45,11 +45,11 @@ namespace neo
 			return emit(op, Helper::int16_to_bytes(offset));
 		}
 
-		ScriptBuilder* ScriptBuilder::emit_push(VMBigInteger number)
+		ScriptBuilder* ScriptBuilder::emit_push(const VMBigInteger &number)
 		{
 			if (number == -1) return emit(OpCode::OP_PUSHM1);
 			if (number == 0) return emit(OpCode::OP_PUSH0);
-			if (number > 0 && number <= 16) return emit((OpCode)(OpCode::OP_PUSH1 - 1 + (VMByte)number));
+			if (number > 0 && number <= 16) return emit((OpCode)(OpCode::OP_PUSH1 - 1 + (VMByte)number.small_value()));
 			return emit_push(Helper::big_integer_to_bytes(number));
 		}
 
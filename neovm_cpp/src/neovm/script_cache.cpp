@@ -0,0 +1,164 @@
+#include <neovm/script_cache.hpp>
+#include <iterator>
+#include <string.h>
+
+namespace neo
+{
+	namespace vm
+	{
+		ScriptHash ScriptHash::of_script_id(const char *script_id, size_t size)
+		{
+			ScriptHash hash;
+			if (size == NEOVM_SCRIPT_HASH_SIZE)
+			{
+				memcpy(hash.bytes, script_id, NEOVM_SCRIPT_HASH_SIZE);
+				return hash;
+			}
+			// FNV-1a, a different basis per 8 bytes of the key
+			memset(hash.bytes, 0, sizeof(hash.bytes));
+			for (size_t part = 0; part * 8 < NEOVM_SCRIPT_HASH_SIZE; part++)
+			{
+				uint64_t h = 14695981039346656037ULL + part;
+				for (size_t i = 0; i < size; i++)
+				{
+					h ^= (uint8_t)script_id[i];
+					h *= 1099511628211ULL;
+				}
+				h ^= size;
+				size_t count = NEOVM_SCRIPT_HASH_SIZE - part * 8;
+				memcpy(hash.bytes + part * 8, &h, count < 8 ? count : 8);
+			}
+			return hash;
+		}
+
+		bool ScriptHash::operator==(const ScriptHash &other) const
+		{
+			return memcmp(bytes, other.bytes, sizeof(bytes)) == 0;
+		}
+
+		size_t ScriptHashHasher::operator()(const ScriptHash &hash) const
+		{
+			size_t value;
+			memcpy(&value, hash.bytes, sizeof(value));
+			return value;
+		}
+
+		ScriptCache::ScriptCache(size_t max_size)
+			: _max_size(max_size), _size(0), _hits(0), _misses(0)
+		{
+		}
+
+		std::shared_ptr<DecodedScript> ScriptCache::find(const char *script_id, size_t size, bool neo_mode, uint64_t gas_table_version)
+		{
+			auto hash = ScriptHash::of_script_id(script_id, size);
+			std::lock_guard<std::mutex> lock(_mutex);
+			auto found = _index.find(hash);
+			if (found == _index.end())
+			{
+				++_misses;
+				return nullptr;
+			}
+			auto entry = found->second;
+			if (entry->neo_mode != neo_mode || entry->script->gas_table_version() != gas_table_version || entry->script_id.size() != size
+				|| (size > 0 && memcmp(entry->script_id.data(), script_id, size) != 0))
+			{
+				++_misses;
+				return nullptr;
+			}
+			++_hits;
+			_entries.splice(_entries.begin(), _entries, entry);
+			return entry->script;
+		}
+
+		void ScriptCache::insert(const char *script_id, size_t size, bool neo_mode, std::shared_ptr<DecodedScript> script)
+		{
+			auto hash = ScriptHash::of_script_id(script_id, size);
+			auto script_size = script->memory_size();
+			std::lock_guard<std::mutex> lock(_mutex);
+			auto found = _index.find(hash);
+			if (found != _index.end())
+				erase_entry(found->second);
+			if (script_size > _max_size)
+				return;
+			Entry entry;
+			entry.hash = hash;
+			entry.script_id.assign(script_id, script_id + size);
+			entry.neo_mode = neo_mode;
+			entry.script = std::move(script);
+			entry.size = script_size;
+			_entries.push_front(std::move(entry));
+			_index[hash] = _entries.begin();
+			_size += script_size;
+			evict();
+		}
+
+		void ScriptCache::erase(const char *script_id, size_t size)
+		{
+			auto hash = ScriptHash::of_script_id(script_id, size);
+			std::lock_guard<std::mutex> lock(_mutex);
+			auto found = _index.find(hash);
+			if (found != _index.end())
+				erase_entry(found->second);
+		}
+
+		void ScriptCache::clear()
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_index.clear();
+			_entries.clear();
+			_size = 0;
+		}
+
+		void ScriptCache::erase_entry(EntryList::iterator entry)
+		{
+			_size -= entry->size;
+			_index.erase(entry->hash);
+			_entries.erase(entry);
+		}
+
+		void ScriptCache::evict()
+		{
+			while (_size > _max_size && !_entries.empty())
+			{
+				erase_entry(std::prev(_entries.end()));
+			}
+		}
+
+		size_t ScriptCache::size() const
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			return _size;
+		}
+
+		size_t ScriptCache::max_size() const
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			return _max_size;
+		}
+
+		void ScriptCache::set_max_size(size_t max_size)
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_max_size = max_size;
+			evict();
+		}
+
+		size_t ScriptCache::entries_count() const
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			return _entries.size();
+		}
+
+		uint64_t ScriptCache::hits() const
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			return _hits;
+		}
+
+		uint64_t ScriptCache::misses() const
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			return _misses;
+		}
+	}
+}
@@ -0,0 +1,630 @@
+#include <neovm/secp256r1.hpp>
+#include <vector>
+#include <string.h>
+#if defined(_MSC_VER) && defined(_M_X64)
+#include <intrin.h>
+#endif
+
+namespace neo
+{
+	namespace vm
+	{
+		namespace
+		{
+			// field elements and scalars are 4 little-endian 64 bit limbs, always fully reduced,
+			// field elements in Montgomery form so every multiplication is one mont_mul
+			struct Modulus
+			{
+				uint64_t m[4];
+				uint64_t n0; // -m^-1 mod 2^64
+				uint64_t r2[4]; // 2^512 mod m, converts into Montgomery form
+				uint64_t one[4]; // 2^256 mod m, 1 in Montgomery form
+			};
+
+			const Modulus FIELD = {
+				{ 0xffffffffffffffffULL, 0x00000000ffffffffULL, 0x0000000000000000ULL, 0xffffffff00000001ULL },
+				0x1ULL,
+				{ 0x0000000000000003ULL, 0xfffffffbffffffffULL, 0xfffffffffffffffeULL, 0x00000004fffffffdULL },
+				{ 0x0000000000000001ULL, 0xffffffff00000000ULL, 0xffffffffffffffffULL, 0x00000000fffffffeULL }
+			};
+
+			const Modulus ORDER = {
+				{ 0xf3b9cac2fc632551ULL, 0xbce6faada7179e84ULL, 0xffffffffffffffffULL, 0xffffffff00000000ULL },
+				0xccd1c8aaee00bc4fULL,
+				{ 0x83244c95be79eea2ULL, 0x4699799c49bd6fa6ULL, 0x2845b2392b6bec59ULL, 0x66e12d94f3d95620ULL },
+				{ 0x0c46353d039cdaafULL, 0x4319055258e8617bULL, 0x0000000000000000ULL, 0x00000000ffffffffULL }
+			};
+
+			const uint64_t FIELD_MINUS_2[4] = { 0xfffffffffffffffdULL, 0x00000000ffffffffULL, 0x0000000000000000ULL, 0xffffffff00000001ULL };
+			const uint64_t ORDER_MINUS_2[4] = { 0xf3b9cac2fc63254fULL, 0xbce6faada7179e84ULL, 0xffffffffffffffffULL, 0xffffffff00000000ULL };
+			// (p + 1) / 4, p = 3 mod 4 so a^((p + 1) / 4) is a square root of a
+			const uint64_t SQRT_EXPONENT[4] = { 0x0000000000000000ULL, 0x0000000040000000ULL, 0x4000000000000000ULL, 0x3fffffffc0000000ULL };
+
+			// curve y^2 = x^3 - 3x + b, b and the generator in Montgomery form
+			const uint64_t CURVE_B[4] = { 0xd89cdf6229c4bddfULL, 0xacf005cd78843090ULL, 0xe5a220abf7212ed6ULL, 0xdc30061d04874834ULL };
+			const uint64_t GENERATOR_X[4] = { 0xf4a13945d898c296ULL, 0x77037d812deb33a0ULL, 0xf8bce6e563a440f2ULL, 0x6b17d1f2e12c4247ULL };
+			const uint64_t GENERATOR_Y[4] = { 0xcbb6406837bf51f5ULL, 0x2bce33576b315eceULL, 0x8ee7eb4a7c0f9e16ULL, 0x4fe342e2fe1a7f9bULL };
+
+			// the generator is fixed, so its table is built once with a wide window
+			const int GENERATOR_WINDOW = 8;
+			// a 256 bit scalar has at most 257 w-NAF digits
+			const int MAX_WNAF_DIGITS = 258;
+
+			inline uint64_t mul_wide(uint64_t a, uint64_t b, uint64_t *high)
+			{
+#if defined(__SIZEOF_INT128__)
+				unsigned __int128 product = (unsigned __int128)a * b;
+				*high = (uint64_t)(product >> 64);
+				return (uint64_t)product;
+#elif defined(_MSC_VER) && defined(_M_X64)
+				return _umul128(a, b, high);
+#else
+				uint64_t a0 = (uint32_t)a, a1 = a >> 32, b0 = (uint32_t)b, b1 = b >> 32;
+				uint64_t p00 = a0 * b0, p01 = a0 * b1, p10 = a1 * b0, p11 = a1 * b1;
+				uint64_t middle = (p00 >> 32) + (uint32_t)p01 + (uint32_t)p10;
+				*high = p11 + (p01 >> 32) + (p10 >> 32) + (middle >> 32);
+				return (middle << 32) | (uint32_t)p00;
+#endif
+			}
+
+			// a * b + c + d, which always fits in 128 bits
+			inline uint64_t mul_add(uint64_t a, uint64_t b, uint64_t c, uint64_t d, uint64_t *high)
+			{
+				uint64_t h;
+				uint64_t low = mul_wide(a, b, &h);
+				low += c;
+				h += low < c;
+				low += d;
+				h += low < d;
+				*high = h;
+				return low;
+			}
+
+			inline uint64_t add_carry(uint64_t a, uint64_t b, uint64_t *carry)
+			{
+				uint64_t sum = a + *carry;
+				uint64_t c = sum < a;
+				sum += b;
+				c += sum < b;
+				*carry = c;
+				return sum;
+			}
+
+			inline uint64_t sub_borrow(uint64_t a, uint64_t b, uint64_t *borrow)
+			{
+				uint64_t diff = a - b;
+				uint64_t c = a < b;
+				uint64_t result = diff - *borrow;
+				c += diff < *borrow;
+				*borrow = c;
+				return result;
+			}
+
+			inline uint64_t add4(uint64_t *r, const uint64_t *a, const uint64_t *b)
+			{
+				uint64_t carry = 0;
+				for (int i = 0; i < 4; i++)
+					r[i] = add_carry(a[i], b[i], &carry);
+				return carry;
+			}
+
+			inline uint64_t sub4(uint64_t *r, const uint64_t *a, const uint64_t *b)
+			{
+				uint64_t borrow = 0;
+				for (int i = 0; i < 4; i++)
+					r[i] = sub_borrow(a[i], b[i], &borrow);
+				return borrow;
+			}
+
+			inline bool is_zero(const uint64_t *a)
+			{
+				return (a[0] | a[1] | a[2] | a[3]) == 0;
+			}
+
+			inline bool equal(const uint64_t *a, const uint64_t *b)
+			{
+				return ((a[0] ^ b[0]) | (a[1] ^ b[1]) | (a[2] ^ b[2]) | (a[3] ^ b[3])) == 0;
+			}
+
+			inline bool greater_or_equal(const uint64_t *a, const uint64_t *b)
+			{
+				for (int i = 3; i >= 0; i--)
+				{
+					if (a[i] != b[i])
+						return a[i] > b[i];
+				}
+				return true;
+			}
+
+			inline void copy4(uint64_t *r, const uint64_t *a)
+			{
+				memcpy(r, a, 4 * sizeof(uint64_t));
+			}
+
+			void from_big_endian(uint64_t *r, const char *bytes)
+			{
+				for (int i = 0; i < 4; i++)
+				{
+					uint64_t limb = 0;
+					for (int j = 0; j < 8; j++)
+						limb = (limb << 8) | (uint8_t)bytes[(3 - i) * 8 + j];
+					r[i] = limb;
+				}
+			}
+
+			inline void mod_add(uint64_t *r, const uint64_t *a, const uint64_t *b, const Modulus &mod)
+			{
+				uint64_t sum[4], reduced[4];
+				uint64_t carry = add4(sum, a, b);
+				uint64_t borrow = sub4(reduced, sum, mod.m);
+				copy4(r, (carry || !borrow) ? reduced : sum);
+			}
+
+			inline void mod_sub(uint64_t *r, const uint64_t *a, const uint64_t *b, const Modulus &mod)
+			{
+				uint64_t diff[4];
+				if (sub4(diff, a, b))
+					add4(diff, diff, mod.m);
+				copy4(r, diff);
+			}
+
+			// a * b / 2^256 mod m, word-by-word Montgomery multiplication (CIOS)
+			void mont_mul(uint64_t *r, const uint64_t *a, const uint64_t *b, const Modulus &mod)
+			{
+				uint64_t t[6] = { 0, 0, 0, 0, 0, 0 };
+				for (int i = 0; i < 4; i++)
+				{
+					uint64_t c = 0;
+					for (int j = 0; j < 4; j++)
+						t[j] = mul_add(a[j], b[i], t[j], c, &c);
+					uint64_t carry = 0;
+					t[4] = add_carry(t[4], c, &carry);
+					t[5] = carry;
+					uint64_t q = t[0] * mod.n0;
+					mul_add(q, mod.m[0], t[0], 0, &c);
+					for (int j = 1; j < 4; j++)
+						t[j - 1] = mul_add(q, mod.m[j], t[j], c, &c);
+					carry = 0;
+					t[3] = add_carry(t[4], c, &carry);
+					t[4] = t[5] + carry;
+				}
+				uint64_t reduced[4];
+				uint64_t borrow = sub4(reduced, t, mod.m);
+				copy4(r, (t[4] || !borrow) ? reduced : t);
+			}
+
+			// base^exponent with base in Montgomery form
+			void mod_pow(uint64_t *r, const uint64_t *base, const uint64_t *exponent, const Modulus &mod)
+			{
+				uint64_t result[4];
+				copy4(result, mod.one);
+				for (int i = 255; i >= 0; i--)
+				{
+					mont_mul(result, result, result, mod);
+					if ((exponent[i / 64] >> (i % 64)) & 1)
+						mont_mul(result, result, base, mod);
+				}
+				copy4(r, result);
+			}
+
+			// mont_mul specialized for p: p = -1 mod 2^64 so q is the low word itself, and the low word of
+			// t + q p clears with q carried out, limb 2 of p is 0, so a round needs 2 multiplications instead of 4
+			void fe_mul(uint64_t *r, const uint64_t *a, const uint64_t *b)
+			{
+				uint64_t t[6] = { 0, 0, 0, 0, 0, 0 };
+				for (int i = 0; i < 4; i++)
+				{
+					uint64_t c = 0;
+					for (int j = 0; j < 4; j++)
+						t[j] = mul_add(a[j], b[i], t[j], c, &c);
+					uint64_t carry = 0;
+					t[4] = add_carry(t[4], c, &carry);
+					t[5] = carry;
+					uint64_t q = t[0];
+					t[0] = mul_add(q, FIELD.m[1], t[1], q, &c);
+					carry = 0;
+					t[1] = add_carry(t[2], c, &carry);
+					t[2] = mul_add(q, FIELD.m[3], t[3], carry, &c);
+					carry = 0;
+					t[3] = add_carry(t[4], c, &carry);
+					t[4] = t[5] + carry;
+				}
+				uint64_t reduced[4];
+				uint64_t borrow = sub4(reduced, t, FIELD.m);
+				copy4(r, (t[4] || !borrow) ? reduced : t);
+			}
+
+			inline void fe_sqr(uint64_t *r, const uint64_t *a) { mont_mul(r, a, a, FIELD); }
+			inline void fe_add(uint64_t *r, const uint64_t *a, const uint64_t *b) { mod_add(r, a, b, FIELD); }
+			inline void fe_sub(uint64_t *r, const uint64_t *a, const uint64_t *b) { mod_sub(r, a, b, FIELD); }
+			inline void fe_inv(uint64_t *r, const uint64_t *a) { mod_pow(r, a, FIELD_MINUS_2, FIELD); }
+			inline void fe_to_mont(uint64_t *r, const uint64_t *a) { mont_mul(r, a, FIELD.r2, FIELD); }
+
+			inline void fe_neg(uint64_t *r, const uint64_t *a)
+			{
+				static const uint64_t zero[4] = { 0, 0, 0, 0 };
+				mod_sub(r, zero, a, FIELD);
+			}
+
+			inline void fe_from_mont(uint64_t *r, const uint64_t *a)
+			{
+				static const uint64_t one[4] = { 1, 0, 0, 0 };
+				mont_mul(r, a, one, FIELD);
+			}
+
+			// x^3 - 3x + b
+			void curve_rhs(uint64_t *r, const uint64_t *x)
+			{
+				uint64_t x3[4], three_x[4];
+				fe_sqr(x3, x);
+				fe_mul(x3, x3, x);
+				fe_add(three_x, x, x);
+				fe_add(three_x, three_x, x);
+				fe_sub(x3, x3, three_x);
+				fe_add(r, x3, CURVE_B);
+			}
+
+			// z == 0 is the point at infinity
+			struct JacobianPoint
+			{
+				uint64_t x[4];
+				uint64_t y[4];
+				uint64_t z[4];
+			};
+
+			// dbl-2001-b, a = -3
+			void point_double(JacobianPoint *r, const JacobianPoint &p)
+			{
+				if (is_zero(p.z))
+				{
+					*r = p;
+					return;
+				}
+				uint64_t delta[4], gamma[4], beta[4], alpha[4], t[4], u[4];
+				fe_sqr(delta, p.z);
+				fe_sqr(gamma, p.y);
+				fe_mul(beta, p.x, gamma);
+				fe_sub(t, p.x, delta);
+				fe_add(u, p.x, delta);
+				fe_mul(t, t, u);
+				fe_add(alpha, t, t);
+				fe_add(alpha, alpha, t);
+				// z3 = (y + z)^2 - gamma - delta, computed before y and z are overwritten
+				fe_add(t, p.y, p.z);
+				fe_sqr(t, t);
+				fe_sub(t, t, gamma);
+				fe_sub(r->z, t, delta);
+				// x3 = alpha^2 - 8 beta
+				fe_add(beta, beta, beta);
+				fe_add(beta, beta, beta);
+				fe_sqr(t, alpha);
+				fe_add(u, beta, beta);
+				fe_sub(r->x, t, u);
+				// y3 = alpha (4 beta - x3) - 8 gamma^2
+				fe_sub(t, beta, r->x);
+				fe_mul(t, alpha, t);
+				fe_sqr(gamma, gamma);
+				fe_add(gamma, gamma, gamma);
+				fe_add(gamma, gamma, gamma);
+				fe_add(gamma, gamma, gamma);
+				fe_sub(r->y, t, gamma);
+			}
+
+			// madd-2007-bl, p + q or p - q
+			void point_add_affine(JacobianPoint *r, const JacobianPoint &p, const Secp256r1AffinePoint &q, bool negate)
+			{
+				uint64_t qy[4];
+				if (negate)
+					fe_neg(qy, q.y);
+				else
+					copy4(qy, q.y);
+				if (is_zero(p.z))
+				{
+					copy4(r->x, q.x);
+					copy4(r->y, qy);
+					copy4(r->z, FIELD.one);
+					return;
+				}
+				uint64_t z1z1[4], u2[4], s2[4], h[4], rr[4];
+				fe_sqr(z1z1, p.z);
+				fe_mul(u2, q.x, z1z1);
+				fe_mul(s2, p.z, z1z1);
+				fe_mul(s2, qy, s2);
+				fe_sub(h, u2, p.x);
+				fe_sub(rr, s2, p.y);
+				if (is_zero(h))
+				{
+					if (is_zero(rr))
+						point_double(r, p);
+					else
+						memset(r->z, 0, sizeof(r->z));
+					return;
+				}
+				uint64_t hh[4], i[4], j[4], v[4], t[4], x3[4], y3[4];
+				fe_sqr(hh, h);
+				fe_add(i, hh, hh);
+				fe_add(i, i, i);
+				fe_mul(j, h, i);
+				fe_add(rr, rr, rr);
+				fe_mul(v, p.x, i);
+				// x3 = rr^2 - j - 2v
+				fe_sqr(x3, rr);
+				fe_sub(x3, x3, j);
+				fe_sub(x3, x3, v);
+				fe_sub(x3, x3, v);
+				// y3 = rr (v - x3) - 2 y1 j
+				fe_sub(t, v, x3);
+				fe_mul(y3, rr, t);
+				fe_mul(t, p.y, j);
+				fe_add(t, t, t);
+				fe_sub(y3, y3, t);
+				// z3 = (z1 + h)^2 - z1z1 - hh
+				fe_add(t, p.z, h);
+				fe_sqr(t, t);
+				fe_sub(t, t, z1z1);
+				fe_sub(r->z, t, hh);
+				copy4(r->x, x3);
+				copy4(r->y, y3);
+			}
+
+			// one field inversion for all the points (Montgomery's trick), none of them may be infinity
+			void to_affine(const JacobianPoint *points, size_t count, Secp256r1AffinePoint *out)
+			{
+				std::vector<uint64_t> prefix(count * 4);
+				copy4(&prefix[0], points[0].z);
+				for (size_t i = 1; i < count; i++)
+					fe_mul(&prefix[i * 4], &prefix[(i - 1) * 4], points[i].z);
+				uint64_t inverse[4], z_inverse[4], zz[4];
+				fe_inv(inverse, &prefix[(count - 1) * 4]);
+				for (size_t i = count; i-- > 0;)
+				{
+					if (i > 0)
+					{
+						fe_mul(z_inverse, inverse, &prefix[(i - 1) * 4]);
+						fe_mul(inverse, inverse, points[i].z);
+					}
+					else
+						copy4(z_inverse, inverse);
+					fe_sqr(zz, z_inverse);
+					fe_mul(out[i].x, points[i].x, zz);
+					fe_mul(zz, zz, z_inverse);
+					fe_mul(out[i].y, points[i].y, zz);
+				}
+			}
+
+			// point, 3 point, 5 point... 2^(window - 2) odd multiples
+			void odd_multiples(const Secp256r1AffinePoint &point, int window, Secp256r1AffinePoint *out)
+			{
+				size_t count = (size_t)1 << (window - 2);
+				out[0] = point;
+				if (count == 1)
+					return;
+				std::vector<JacobianPoint> multiples(count);
+				copy4(multiples[0].x, point.x);
+				copy4(multiples[0].y, point.y);
+				copy4(multiples[0].z, FIELD.one);
+				JacobianPoint twice;
+				point_double(&twice, multiples[0]);
+				Secp256r1AffinePoint twice_affine;
+				to_affine(&twice, 1, &twice_affine);
+				for (size_t i = 1; i < count; i++)
+					point_add_affine(&multiples[i], multiples[i - 1], twice_affine, false);
+				to_affine(multiples.data() + 1, count - 1, out + 1);
+			}
+
+			struct GeneratorTable
+			{
+				Secp256r1AffinePoint points[1 << (GENERATOR_WINDOW - 2)];
+
+				GeneratorTable()
+				{
+					Secp256r1AffinePoint generator;
+					fe_to_mont(generator.x, GENERATOR_X);
+					fe_to_mont(generator.y, GENERATOR_Y);
+					odd_multiples(generator, GENERATOR_WINDOW, points);
+				}
+			};
+
+			const GeneratorTable &generator_table()
+			{
+				static const GeneratorTable table;
+				return table;
+			}
+
+			// width-w non-adjacent form, digit i has weight 2^i and is 0 or odd in (-2^(w-1), 2^(w-1)).
+			// returns the number of digits
+			int wnaf(int8_t *digits, const uint64_t *scalar, int window)
+			{
+				uint64_t k[5] = { scalar[0], scalar[1], scalar[2], scalar[3], 0 };
+				const int full = 1 << window;
+				int length = 0;
+				while ((k[0] | k[1] | k[2] | k[3] | k[4]) != 0)
+				{
+					int digit = 0;
+					if (k[0] & 1)
+					{
+						digit = (int)(k[0] & (uint64_t)(full - 1));
+						if (digit >= (full >> 1))
+							digit -= full;
+						uint64_t carry = 0;
+						if (digit > 0)
+						{
+							uint64_t borrow = (uint64_t)digit;
+							for (int i = 0; i < 5 && borrow; i++)
+							{
+								uint64_t before = k[i];
+								k[i] -= borrow;
+								borrow = before < borrow;
+							}
+						}
+						else
+						{
+							carry = (uint64_t)(-digit);
+							for (int i = 0; i < 5 && carry; i++)
+							{
+								k[i] += carry;
+								carry = k[i] < carry;
+							}
+						}
+					}
+					digits[length++] = (int8_t)digit;
+					for (int i = 0; i < 4; i++)
+						k[i] = (k[i] >> 1) | (k[i + 1] << 63);
+					k[4] >>= 1;
+				}
+				return length;
+			}
+		}
+
+		std::shared_ptr<Secp256r1PublicKey> Secp256r1PublicKey::decode(const char *data, size_t size, int window)
+		{
+			if (window < 2)
+				window = 2;
+			if (window > NEOVM_SECP256R1_CACHED_KEY_WINDOW)
+				window = NEOVM_SECP256R1_CACHED_KEY_WINDOW;
+			auto bytes = (const uint8_t*)data;
+			uint64_t x[4], y[4];
+			Secp256r1AffinePoint point;
+			if (size == 33 && (bytes[0] == 0x02 || bytes[0] == 0x03))
+			{
+				from_big_endian(x, data + 1);
+				if (greater_or_equal(x, FIELD.m))
+					return nullptr;
+				uint64_t rhs[4], check[4];
+				fe_to_mont(point.x, x);
+				curve_rhs(rhs, point.x);
+				mod_pow(point.y, rhs, SQRT_EXPONENT, FIELD);
+				fe_sqr(check, point.y);
+				if (!equal(check, rhs))
+					return nullptr;
+				fe_from_mont(y, point.y);
+				if ((y[0] & 1) != (bytes[0] & 1))
+					fe_neg(point.y, point.y);
+			}
+			else if ((size == 65 && bytes[0] == 0x04) || size == 64)
+			{
+				from_big_endian(x, data + size - 64);
+				from_big_endian(y, data + size - 32);
+				if (greater_or_equal(x, FIELD.m) || greater_or_equal(y, FIELD.m))
+					return nullptr;
+				uint64_t rhs[4], yy[4];
+				fe_to_mont(point.x, x);
+				fe_to_mont(point.y, y);
+				curve_rhs(rhs, point.x);
+				fe_sqr(yy, point.y);
+				if (!equal(yy, rhs))
+					return nullptr;
+			}
+			else
+				return nullptr;
+			std::shared_ptr<Secp256r1PublicKey> key(new Secp256r1PublicKey());
+			key->_window = window;
+			odd_multiples(point, window, key->_table);
+			return key;
+		}
+
+		bool secp256r1_verify(const char *hash, const char *signature, size_t signature_size, const Secp256r1PublicKey &key)
+		{
+			if (signature_size != 64)
+				return false;
+			uint64_t r[4], s[4], e[4];
+			from_big_endian(r, signature);
+			from_big_endian(s, signature + 32);
+			from_big_endian(e, hash);
+			if (is_zero(r) || is_zero(s) || greater_or_equal(r, ORDER.m) || greater_or_equal(s, ORDER.m))
+				return false;
+			if (greater_or_equal(e, ORDER.m))
+				sub4(e, e, ORDER.m);
+			// w = s^-1 R mod n, so a Montgomery product with w is a plain product with s^-1
+			uint64_t w[4], u1[4], u2[4];
+			mont_mul(w, s, ORDER.r2, ORDER);
+			mod_pow(w, w, ORDER_MINUS_2, ORDER);
+			mont_mul(u1, e, w, ORDER);
+			mont_mul(u2, r, w, ORDER);
+
+			// u1 G + u2 Q with both w-NAFs in one double-and-add pass
+			int8_t naf1[MAX_WNAF_DIGITS], naf2[MAX_WNAF_DIGITS];
+			int length1 = wnaf(naf1, u1, GENERATOR_WINDOW);
+			int length2 = wnaf(naf2, u2, key.window());
+			const auto &generator = generator_table();
+			JacobianPoint point;
+			memset(&point, 0, sizeof(point));
+			for (int i = (length1 > length2 ? length1 : length2) - 1; i >= 0; i--)
+			{
+				point_double(&point, point);
+				if (i < length1 && naf1[i] != 0)
+				{
+					int digit = naf1[i];
+					point_add_affine(&point, point, generator.points[((digit < 0 ? -digit : digit) - 1) / 2], digit < 0);
+				}
+				if (i < length2 && naf2[i] != 0)
+				{
+					int digit = naf2[i];
+					point_add_affine(&point, point, key.odd_multiple(((digit < 0 ? -digit : digit) - 1) / 2), digit < 0);
+				}
+			}
+			if (is_zero(point.z))
+				return false;
+
+			// x mod n == r without an inversion: X == r Z^2, or (r + n) Z^2 when r + n is still a field element
+			uint64_t zz[4], candidate[4], t[4];
+			fe_sqr(zz, point.z);
+			fe_to_mont(candidate, r);
+			fe_mul(t, candidate, zz);
+			if (equal(t, point.x))
+				return true;
+			if (add4(candidate, r, ORDER.m) || greater_or_equal(candidate, FIELD.m))
+				return false;
+			fe_to_mont(candidate, candidate);
+			fe_mul(t, candidate, zz);
+			return equal(t, point.x);
+		}
+
+		bool secp256r1_verify(const char *hash, const char *signature, size_t signature_size, const char *pubkey, size_t pubkey_size)
+		{
+			auto key = Secp256r1PublicKey::decode(pubkey, pubkey_size);
+			return key && secp256r1_verify(hash, signature, signature_size, *key);
+		}
+
+		Secp256r1KeyCache::Secp256r1KeyCache(size_t max_entries)
+			: _max_entries(max_entries)
+		{
+		}
+
+		std::shared_ptr<Secp256r1PublicKey> Secp256r1KeyCache::get(const char *pubkey, size_t size)
+		{
+			std::string id(pubkey, size);
+			{
+				std::lock_guard<std::mutex> lock(_mutex);
+				auto found = _index.find(id);
+				if (found != _index.end())
+				{
+					_entries.splice(_entries.begin(), _entries, found->second);
+					return found->second->second;
+				}
+			}
+			// decoding takes a square root and builds the table, so it runs outside the lock
+			auto key = Secp256r1PublicKey::decode(pubkey, size, NEOVM_SECP256R1_CACHED_KEY_WINDOW);
+			if (!key || _max_entries == 0)
+				return key;
+			std::lock_guard<std::mutex> lock(_mutex);
+			auto found = _index.find(id);
+			if (found != _index.end())
+				return found->second->second;
+			_entries.emplace_front(id, key);
+			_index[id] = _entries.begin();
+			while (_entries.size() > _max_entries)
+			{
+				_index.erase(_entries.back().first);
+				_entries.pop_back();
+			}
+			return key;
+		}
+
+		size_t Secp256r1KeyCache::size()
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			return _entries.size();
+		}
+	}
+}
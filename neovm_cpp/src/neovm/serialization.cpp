@@ -0,0 +1,237 @@
+#include <neovm/serialization.hpp>
+#include <neovm/stack_value.hpp>
+#include <neovm/types.hpp>
+#include <neovm/helper.hpp>
+#include <neovm/execution_engine.hpp>
+#include <neovm/exceptions.hpp>
+
+#include <unordered_set>
+
+namespace neo
+{
+	namespace vm
+	{
+		namespace
+		{
+			void write_var_int(std::vector<char> *out, uint64_t value)
+			{
+				if (value < 0xFD)
+				{
+					out->push_back((char)value);
+					return;
+				}
+				size_t size;
+				if (value <= 0xFFFF)
+				{
+					out->push_back((char)0xFD);
+					size = 2;
+				}
+				else if (value <= 0xFFFFFFFF)
+				{
+					out->push_back((char)0xFE);
+					size = 4;
+				}
+				else
+				{
+					out->push_back((char)0xFF);
+					size = 8;
+				}
+				for (size_t i = 0; i < size; i++)
+				{
+					out->push_back((char)(value & 0xFF));
+					value >>= 8;
+				}
+			}
+
+			inline void write_var_bytes(std::vector<char> *out, const char *data, size_t size)
+			{
+				write_var_int(out, size);
+				out->insert(out->end(), data, data + size);
+			}
+
+			class Serializer
+			{
+			private:
+				std::vector<char> *_out;
+				std::unordered_set<const StackItem*> _containers; // every container written so far
+				size_t _depth;
+			public:
+				Serializer(std::vector<char> *out) : _out(out), _depth(0) {}
+
+				void write(const StackValue &value)
+				{
+					if (!value.is_inline())
+					{
+						write(value.item());
+						return;
+					}
+					if (value.type() == StackItemType::SIT_BOOLEAN)
+					{
+						_out->push_back((char)SERIALIZED_BOOLEAN);
+						_out->push_back(value.GetBoolean() ? 1 : 0);
+						return;
+					}
+					write_integer(VMBigInteger(value.GetInt64()));
+				}
+
+			private:
+				void write_integer(const VMBigInteger &value)
+				{
+					_out->push_back((char)SERIALIZED_INTEGER);
+					auto bytes = value.to_byte_array();
+					write_var_bytes(_out, bytes.data(), bytes.size());
+				}
+
+				void write(const StackItem *item)
+				{
+					switch (item->type())
+					{
+					case StackItemType::SIT_BYTE_ARRAY:
+					{
+						auto span = ((const ByteArray*)item)->span();
+						_out->push_back((char)SERIALIZED_BYTE_ARRAY);
+						write_var_bytes(_out, span.data, span.size);
+					}
+					break;
+					case StackItemType::SIT_BOOLEAN:
+						_out->push_back((char)SERIALIZED_BOOLEAN);
+						_out->push_back(item->GetBoolean() ? 1 : 0);
+						break;
+					case StackItemType::SIT_INTEGER:
+						write_integer(item->GetBigInteger());
+						break;
+					case StackItemType::SIT_ARRAY:
+					case StackItemType::SIT_STRUCT:
+					case StackItemType::SIT_MAP:
+						write_container(item);
+						break;
+					default:
+						throw NeoVmException("can't serialize userdata or interop interface items");
+					}
+				}
+
+				void write_container(const StackItem *item)
+				{
+					if (!_containers.insert(item).second)
+						throw NeoVmException("can't serialize a container referenced twice");
+					if (++_depth > NEOVM_MAX_SERIALIZE_DEPTH)
+						throw NeoVmException("too deeply nested item to serialize");
+					if (item->type() == StackItemType::SIT_MAP)
+					{
+						auto map = (const Map*)item;
+						_out->push_back((char)SERIALIZED_MAP);
+						write_var_int(_out, map->count());
+						map->for_each_entry([this](const StackItem *key, const StackItem *value) {
+							write(key);
+							write(value);
+						});
+					}
+					else
+					{
+						auto items = ((StackItem*)item)->GetArray();
+						_out->push_back((char)(item->type() == StackItemType::SIT_STRUCT ? SERIALIZED_STRUCT : SERIALIZED_ARRAY));
+						write_var_int(_out, items->size());
+						for (auto element : *items)
+							write(element);
+					}
+					--_depth;
+				}
+			};
+
+			class Deserializer
+			{
+			private:
+				ExecutionEngine *_engine;
+				BinaryReader _reader;
+				size_t _depth;
+			public:
+				Deserializer(ExecutionEngine *engine, const char *data, size_t size)
+					: _engine(engine), _reader(data, size), _depth(0) {}
+
+				StackItem *read_document()
+				{
+					auto item = read();
+					if (_reader.position() != _reader.size())
+						throw NeoVmException("unexpected data after serialized item");
+					return item;
+				}
+
+			private:
+				// every element takes at least one byte, so a count can't be larger than the bytes left
+				size_t read_count()
+				{
+					return (size_t)Helper::ReadVarInt(&_reader, _reader.size() - _reader.position());
+				}
+
+				StackItem *read()
+				{
+					auto type = _reader.ReadByte();
+					switch (type)
+					{
+					case SERIALIZED_BYTE_ARRAY:
+					{
+						auto span = _reader.ReadSpan((size_t)Helper::ReadVarInt(&_reader, _reader.size() - _reader.position()));
+						return new (_engine->memory_resource()) ByteArray(_engine, span.data, span.size);
+					}
+					case SERIALIZED_BOOLEAN:
+						return StackItem::to_stack_item_from_bool(_engine, _reader.ReadByte() != 0);
+					case SERIALIZED_INTEGER:
+					{
+						auto span = _reader.ReadSpan((size_t)Helper::ReadVarInt(&_reader, NEOVM_MAX_BIGINTEGER_SIZE));
+						return StackItem::to_stack_item(_engine, VMBigInteger::from_byte_array(span.data, span.size));
+					}
+					case SERIALIZED_ARRAY:
+					case SERIALIZED_STRUCT:
+					{
+						auto count = read_count();
+						std::vector<StackItem*> no_items;
+						auto array = type == SERIALIZED_STRUCT ? StackItem::to_stack_struct_item(_engine, no_items) : StackItem::to_stack_item(_engine, no_items);
+						enter();
+						auto items = array->GetArray();
+						items->reserve(count);
+						for (size_t i = 0; i < count; i++)
+							items->push_back(read());
+						--_depth;
+						return array;
+					}
+					case SERIALIZED_MAP:
+					{
+						auto count = read_count();
+						auto map = (Map*)StackItem::to_stack_map_item(_engine);
+						enter();
+						for (size_t i = 0; i < count; i++)
+						{
+							auto key = read();
+							if (!Map::is_valid_key(key))
+								throw NeoVmException("invalid serialized map key");
+							map->put(key, read());
+						}
+						--_depth;
+						return map;
+					}
+					default:
+						throw NeoVmException("invalid serialized item type");
+					}
+				}
+
+				void enter()
+				{
+					if (++_depth > NEOVM_MAX_SERIALIZE_DEPTH)
+						throw NeoVmException("too deeply nested serialized item");
+				}
+			};
+		}
+
+		void serialize_stack_item(const StackValue &value, std::vector<char> *out)
+		{
+			Serializer serializer(out);
+			serializer.write(value);
+		}
+
+		StackItem *deserialize_stack_item(ExecutionEngine *engine, const char *data, size_t size)
+		{
+			Deserializer deserializer(engine, data, size);
+			return deserializer.read_document();
+		}
+	}
+}
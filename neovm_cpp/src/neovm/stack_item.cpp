@@ -2,25 +2,56 @@
 #include <neovm/iinterop_interface.hpp>
 #include <neovm/types.hpp>
 #include <neovm/exceptions.hpp>
+#include <neovm/execution_engine.hpp>
+#include <neovm/json.hpp>
 
 namespace neo
 {
 	namespace vm
 	{
+		namespace
+		{
+			// stored before every stack item so delete can return it to the resource it came from
+			struct StackItemHeader
+			{
+				MemoryResource *resource;
+				size_t size;
+			};
+			static_assert(sizeof(StackItemHeader) <= NEOVM_MEMORY_ALIGNMENT, "stack item header must fit in one alignment unit");
+		}
+
+		void *StackItem::operator new(size_t size, MemoryResource *resource)
+		{
+			auto block = (char*)resource->allocate(size + NEOVM_MEMORY_ALIGNMENT);
+			auto header = (StackItemHeader*)block;
+			header->resource = resource;
+			header->size = size + NEOVM_MEMORY_ALIGNMENT;
+			return block + NEOVM_MEMORY_ALIGNMENT;
+		}
+
+		void StackItem::operator delete(void *p, MemoryResource *resource)
+		{
+			StackItem::operator delete(p);
+		}
+
+		void StackItem::operator delete(void *p)
+		{
+			if (!p)
+				return;
+			auto block = (char*)p - NEOVM_MEMORY_ALIGNMENT;
+			auto header = (StackItemHeader*)block;
+			header->resource->deallocate(block, header->size);
+		}
+
 		VMBigInteger StackItem::GetBigInteger() const
 		{
-			// big endian
+			// little endian two's complement
 			auto bytes = GetByteArray();
-			if (bytes.size() > 8)
+			if (bytes.size() > NEOVM_MAX_BIGINTEGER_SIZE)
 			{
-				throw NeoVmException("too long bytes to parse to BigInteger");
+				throw NeoVmException("too long bytes to parse to BigInteger", ErrorCode::INVALID_OPERAND);
 			}
-			VMBigInteger value = 0;
-			for (size_t i = 0; i < bytes.size(); i++)
-			{
-				value += (VMByte)(bytes[i]) << (8 * (bytes.size() - i - 1));
-			}
-			return value;
+			return VMBigInteger::from_byte_array(bytes.data(), bytes.size());
 		}
 
 		bool StackItem::GetBoolean() const
@@ -41,9 +72,22 @@ namespace neo
 			return Helper::bytes_to_string(GetByteArray());
 		}
 
-		std::string StackItem::to_json_string(std::set<void*> referenced_objects) const
+		std::string StackItem::to_json_string() const
+		{
+			JsonWriter writer;
+			write_json(&writer);
+			return writer.str();
+		}
+
+		void StackItem::write_json(JsonWriter *writer) const
+		{
+			auto str = GetString();
+			writer->write_string(str.data(), str.size());
+		}
+
+		size_t StackItem::hash_code() const
 		{
-			return GetString();
+			throw NeoVmException("not supported operation");
 		}
 
 		IInteropInterface* StackItem::GetInterface()
@@ -53,44 +97,49 @@ namespace neo
 
 		StackItem *GetStackItemFromInterface(ExecutionEngine *engine, IInteropInterface *value)
 		{
-			return new InteropInterface(engine, value);
+			return new (engine->memory_resource()) InteropInterface(engine, value);
 		}
 
 		StackItem *StackItem::to_stack_item(ExecutionEngine *engine, std::vector<char> bytes)
 		{
-			return new ByteArray(engine, bytes);
+			return new (engine->memory_resource()) ByteArray(engine, std::move(bytes));
 		}
 
 		StackItem *StackItem::to_stack_item(ExecutionEngine *engine, std::string str)
 		{
 			std::vector<char> bytes(str.size());
 			memcpy(bytes.data(), str.c_str(), sizeof(char) * str.size());
-			return to_stack_item(engine, bytes);
+			return to_stack_item(engine, std::move(bytes));
 		}
 
 		StackItem* StackItem::to_stack_item_from_bool(ExecutionEngine *engine, bool value)
 		{
-			return new Boolean(engine, value);
+			return new (engine->memory_resource()) Boolean(engine, value);
 		}
 
 		StackItem *StackItem::to_stack_item(ExecutionEngine *engine, VMBigInteger num)
 		{
-			return new Integer(engine, num);
+			return new (engine->memory_resource()) Integer(engine, num);
 		}
 
 		StackItem *StackItem::to_stack_item(ExecutionEngine *engine, std::vector<StackItem*> &items)
 		{
-			return new Array(engine, items);
+			return new (engine->memory_resource()) Array(engine, items);
 		}
 
 		StackItem *StackItem::to_stack_struct_item(ExecutionEngine *engine, std::vector<StackItem*> &items)
 		{
-			return new Struct(engine, items);
+			return new (engine->memory_resource()) Struct(engine, items);
 		}
 
 		StackItem *StackItem::to_stack_userdata_item(ExecutionEngine *engine, void *userdata)
 		{
-			return new Userdata(engine, userdata);
+			return new (engine->memory_resource()) Userdata(engine, userdata);
+		}
+
+		StackItem *StackItem::to_stack_map_item(ExecutionEngine *engine)
+		{
+			return new (engine->memory_resource()) Map(engine, std::vector<std::pair<StackItem*, StackItem*>>());
 		}
 
 	}
@@ -0,0 +1,66 @@
+#include <neovm/stack_value.hpp>
+#include <neovm/helper.hpp>
+
+namespace neo
+{
+	namespace vm
+	{
+		std::vector<char> StackValue::GetByteArray() const
+		{
+			switch (_tag)
+			{
+			case SV_INTEGER: return Helper::big_integer_to_chars(VMBigInteger(_integer));
+			case SV_BOOLEAN: return _boolean ? std::vector<char>(1, 1) : std::vector<char>();
+			default: return _item->GetByteArray();
+			}
+		}
+
+		std::string StackValue::GetString() const
+		{
+			switch (_tag)
+			{
+			case SV_INTEGER: return std::to_string(_integer);
+			case SV_BOOLEAN: return _boolean ? "true" : "false";
+			default: return _item->GetString();
+			}
+		}
+
+		bool StackValue::Equals(const StackValue &other) const
+		{
+			if (_tag == SV_ITEM && other._tag == SV_ITEM)
+				return _item == other._item || (_item && _item->Equals(other._item));
+			// same rules as Integer::Equals and Boolean::Equals, the other side may be inline or boxed
+			auto t = type();
+			if (t != other.type())
+				return false;
+			if (t == StackItemType::SIT_INTEGER)
+				return GetBigInteger() == other.GetBigInteger();
+			return GetBoolean() == other.GetBoolean();
+		}
+
+		size_t StackValue::hash_code() const
+		{
+			switch (_tag)
+			{
+			case SV_INTEGER: return Helper::hash_int64(_integer);
+			case SV_BOOLEAN: return _boolean ? 1 : 0;
+			default: return _item->hash_code();
+			}
+		}
+
+		StackValue StackValue::box_integer(ExecutionEngine *engine, const VMBigInteger &value)
+		{
+			return StackValue(StackItem::to_stack_item(engine, value));
+		}
+
+		StackItem *StackValue::to_stack_item(ExecutionEngine *engine) const
+		{
+			switch (_tag)
+			{
+			case SV_INTEGER: return StackItem::to_stack_item(engine, VMBigInteger(_integer));
+			case SV_BOOLEAN: return StackItem::to_stack_item_from_bool(engine, _boolean);
+			default: return _item;
+			}
+		}
+	}
+}
@@ -0,0 +1,372 @@
+#include <neovm/state_root.hpp>
+#include <neovm/hash.hpp>
+#include <neovm/exceptions.hpp>
+
+#include <algorithm>
+#include <string.h>
+
+namespace neo
+{
+	namespace vm
+	{
+		// a node is stored under the prefix, the depth (2 bytes, big-endian) and the bits of the path above it,
+		// as its type, its hash and two hashes: the path and the value hash of a leaf, the children of a branch.
+		// the prefix is a var int contract_storage_key never writes, 0 in two bytes
+		namespace
+		{
+			const char NODE_KEY_PREFIX[2] = { (char)0x80, 0x00 };
+			const size_t NODE_RECORD_SIZE = 1 + 3 * NEOVM_SHA256_SIZE;
+			const uint32_t MAX_DEPTH = 8 * NEOVM_SHA256_SIZE;
+			// subtrees a parallel update is split into, per thread
+			const size_t SUBTREES_PER_THREAD = 4;
+			// entries hashed by one parallel task
+			const size_t HASH_CHUNK = 64;
+
+			enum NodeType
+			{
+				NODE_EMPTY = 0,
+				NODE_LEAF = 1,
+				NODE_BRANCH = 2,
+				NODE_STUB = 3 // a node known by its hash only, loaded when needed
+			};
+
+			inline int bit_at(const char *path, uint32_t depth)
+			{
+				return ((uint8_t)path[depth >> 3] >> (7 - (depth & 7))) & 1;
+			}
+
+			inline void set_bit(char *path, uint32_t depth, int bit)
+			{
+				auto mask = (uint8_t)(0x80 >> (depth & 7));
+				path[depth >> 3] = (char)(bit ? ((uint8_t)path[depth >> 3] | mask) : ((uint8_t)path[depth >> 3] & ~mask));
+			}
+
+			std::string node_key(uint32_t depth, const char *path)
+			{
+				std::string key(NODE_KEY_PREFIX, sizeof(NODE_KEY_PREFIX));
+				key.push_back((char)(depth >> 8));
+				key.push_back((char)depth);
+				key.append(path, (depth + 7) / 8);
+				if (depth & 7)
+					key.back() = (char)((uint8_t)key.back() & (0xFF << (8 - (depth & 7))));
+				return key;
+			}
+
+			// domain separated, so a leaf never hashes like a branch
+			void node_hash(char tag, const char *first, const char *second, char *out)
+			{
+				char data[1 + 2 * NEOVM_SHA256_SIZE];
+				data[0] = tag;
+				memcpy(data + 1, first, NEOVM_SHA256_SIZE);
+				memcpy(data + 1 + NEOVM_SHA256_SIZE, second, NEOVM_SHA256_SIZE);
+				sha256(data, sizeof(data), out);
+			}
+
+			inline bool is_zero(const char *hash)
+			{
+				for (size_t i = 0; i < NEOVM_SHA256_SIZE; i++)
+				{
+					if (hash[i])
+						return false;
+				}
+				return true;
+			}
+		}
+
+		struct StateRoot::Node
+		{
+			int type;
+			char hash[NEOVM_SHA256_SIZE];
+			char first[NEOVM_SHA256_SIZE]; // the path of a leaf, the left child of a branch
+			char second[NEOVM_SHA256_SIZE]; // the value hash of a leaf, the right child of a branch
+
+			static Node empty()
+			{
+				Node node;
+				node.type = NODE_EMPTY;
+				memset(node.hash, 0, sizeof(node.hash));
+				return node;
+			}
+
+			static Node stub(const char *hash)
+			{
+				if (is_zero(hash))
+					return empty();
+				Node node;
+				node.type = NODE_STUB;
+				memcpy(node.hash, hash, sizeof(node.hash));
+				return node;
+			}
+
+			static Node leaf(const char *path, const char *value_hash)
+			{
+				Node node;
+				node.type = NODE_LEAF;
+				memcpy(node.first, path, sizeof(node.first));
+				memcpy(node.second, value_hash, sizeof(node.second));
+				node_hash(0, path, value_hash, node.hash);
+				return node;
+			}
+
+			static Node branch(const char *left, const char *right)
+			{
+				Node node;
+				node.type = NODE_BRANCH;
+				memcpy(node.first, left, sizeof(node.first));
+				memcpy(node.second, right, sizeof(node.second));
+				node_hash(1, left, right, node.hash);
+				return node;
+			}
+
+			// at the position of depth on path, an empty node removes the record
+			void store(uint32_t depth, const char *path, StorageWriteSet *writes) const
+			{
+				auto &write = (*writes)[node_key(depth, path)];
+				write.removed = type == NODE_EMPTY;
+				write.value.clear();
+				if (write.removed)
+					return;
+				write.value.reserve(NODE_RECORD_SIZE);
+				write.value.push_back((char)type);
+				write.value.insert(write.value.end(), hash, hash + sizeof(hash));
+				write.value.insert(write.value.end(), first, first + sizeof(first));
+				write.value.insert(write.value.end(), second, second + sizeof(second));
+			}
+		};
+
+		struct StateRoot::Change
+		{
+			char path[NEOVM_SHA256_SIZE];
+			char value_hash[NEOVM_SHA256_SIZE];
+			bool removed;
+		};
+
+		// the subtrees at depth (or above it, where a leaf or an empty subtree is reached first) that changes fall into.
+		// the first walk collects them, they are updated in parallel, and a second walk, visiting the same subtrees in
+		// the same order, takes their results and updates the nodes above them
+		struct StateRoot::Plan
+		{
+			struct Subtree
+			{
+				uint32_t depth;
+				Node node;
+				const Change *begin;
+				const Change *end;
+				Node result;
+			};
+
+			uint32_t depth;
+			bool finishing;
+			size_t next;
+			std::vector<Subtree> subtrees;
+		};
+
+		StateRoot::StateRoot(IStorage *storage, ThreadPool *pool)
+			: _storage(storage), _pool(pool)
+		{
+		}
+
+		bool StateRoot::is_node_key(const std::string &key)
+		{
+			return key.size() >= sizeof(NODE_KEY_PREFIX) && memcmp(key.data(), NODE_KEY_PREFIX, sizeof(NODE_KEY_PREFIX)) == 0;
+		}
+
+		StateRoot::Node StateRoot::read_node(uint32_t depth, const char *path) const
+		{
+			std::vector<char> record;
+			if (!_storage->get(node_key(depth, path), &record))
+				return Node::empty();
+			if (record.size() != NODE_RECORD_SIZE || (record[0] != NODE_LEAF && record[0] != NODE_BRANCH))
+				throw NeoVmException("corrupt state trie node");
+			Node node;
+			node.type = record[0];
+			memcpy(node.hash, record.data() + 1, NEOVM_SHA256_SIZE);
+			memcpy(node.first, record.data() + 1 + NEOVM_SHA256_SIZE, NEOVM_SHA256_SIZE);
+			memcpy(node.second, record.data() + 1 + 2 * NEOVM_SHA256_SIZE, NEOVM_SHA256_SIZE);
+			return node;
+		}
+
+		void StateRoot::root(char *out) const
+		{
+			char path[NEOVM_SHA256_SIZE] = {};
+			memcpy(out, read_node(0, path).hash, NEOVM_STATE_ROOT_SIZE);
+		}
+
+		// the node at depth on the paths of the changes after applying them, the nodes below it that changed are written.
+		// node is what was there before, it's returned as it is when nothing changes below it
+		StateRoot::Node StateRoot::update(uint32_t depth, const Node &existing, const Change *begin, const Change *end, StorageWriteSet *writes, Plan *plan) const
+		{
+			if (begin == end)
+				return existing;
+			auto node = existing.type == NODE_STUB ? read_node(depth, begin->path) : existing;
+			if (plan && (node.type != NODE_BRANCH || depth == plan->depth))
+			{
+				if (plan->finishing)
+					return plan->subtrees[plan->next++].result;
+				Plan::Subtree subtree;
+				subtree.depth = depth;
+				subtree.node = node;
+				subtree.begin = begin;
+				subtree.end = end;
+				plan->subtrees.push_back(subtree);
+				return Node::empty();
+			}
+			if (node.type == NODE_BRANCH)
+			{
+				auto middle = std::partition_point(begin, end, [depth](const Change &change) { return bit_at(change.path, depth) == 0; });
+				auto left = update(depth + 1, Node::stub(node.first), begin, middle, writes, plan);
+				auto right = update(depth + 1, Node::stub(node.second), middle, end, writes, plan);
+				if (plan && !plan->finishing)
+					return Node::empty();
+				return join(depth, begin->path, left, right, begin != middle, middle != end, writes);
+			}
+
+			// an empty subtree or a single leaf, built again from the entries it ends up with
+			std::vector<Change> entries;
+			entries.reserve(end - begin + 1);
+			auto keep_leaf = node.type == NODE_LEAF;
+			for (auto change = begin; change != end; ++change)
+			{
+				if (keep_leaf && memcmp(change->path, node.first, NEOVM_SHA256_SIZE) == 0)
+					keep_leaf = false;
+				if (!change->removed)
+					entries.push_back(*change);
+			}
+			if (keep_leaf)
+			{
+				Change leaf;
+				memcpy(leaf.path, node.first, NEOVM_SHA256_SIZE);
+				memcpy(leaf.value_hash, node.second, NEOVM_SHA256_SIZE);
+				leaf.removed = false;
+				auto position = std::lower_bound(entries.begin(), entries.end(), leaf, [](const Change &x, const Change &y) {
+					return memcmp(x.path, y.path, NEOVM_SHA256_SIZE) < 0;
+				});
+				entries.insert(position, leaf);
+			}
+			return build(depth, entries.data(), entries.data() + entries.size(), writes);
+		}
+
+		// the branch at depth over its updated children, or the one leaf left under it. path is any path below it
+		StateRoot::Node StateRoot::join(uint32_t depth, const char *path, Node left, Node right, bool left_changed, bool right_changed, StorageWriteSet *writes) const
+		{
+			char left_path[NEOVM_SHA256_SIZE], right_path[NEOVM_SHA256_SIZE];
+			memcpy(left_path, path, NEOVM_SHA256_SIZE);
+			memcpy(right_path, path, NEOVM_SHA256_SIZE);
+			set_bit(left_path, depth, 0);
+			set_bit(right_path, depth, 1);
+			// an untouched child next to an empty one is loaded to see whether it is a leaf
+			if (right.type == NODE_EMPTY && left.type == NODE_STUB)
+				left = read_node(depth + 1, left_path);
+			if (left.type == NODE_EMPTY && right.type == NODE_STUB)
+				right = read_node(depth + 1, right_path);
+			if ((left.type == NODE_EMPTY && right.type != NODE_BRANCH) || (right.type == NODE_EMPTY && left.type != NODE_BRANCH))
+			{
+				// the leaf, if any, moves up to this node
+				if (left_changed || left.type != NODE_EMPTY)
+					Node::empty().store(depth + 1, left_path, writes);
+				if (right_changed || right.type != NODE_EMPTY)
+					Node::empty().store(depth + 1, right_path, writes);
+				return left.type == NODE_LEAF ? left : right;
+			}
+			if (left_changed)
+				left.store(depth + 1, left_path, writes);
+			if (right_changed)
+				right.store(depth + 1, right_path, writes);
+			return Node::branch(left.hash, right.hash);
+		}
+
+		// the subtree at depth holding exactly the entries, the nodes below it are written
+		StateRoot::Node StateRoot::build(uint32_t depth, const Change *begin, const Change *end, StorageWriteSet *writes) const
+		{
+			if (begin == end)
+				return Node::empty();
+			if (end - begin == 1)
+				return Node::leaf(begin->path, begin->value_hash);
+			if (depth >= MAX_DEPTH)
+				throw NeoVmException("duplicate state trie path");
+			auto middle = std::partition_point(begin, end, [depth](const Change &change) { return bit_at(change.path, depth) == 0; });
+			auto left = build(depth + 1, begin, middle, writes);
+			auto right = build(depth + 1, middle, end, writes);
+			if (left.type != NODE_EMPTY)
+				left.store(depth + 1, begin->path, writes);
+			if (right.type != NODE_EMPTY)
+				right.store(depth + 1, middle->path, writes);
+			return Node::branch(left.hash, right.hash);
+		}
+
+		void StateRoot::update(const StorageWriteSet &writes, char *out)
+		{
+			std::vector<const StorageWriteSet::value_type*> entries;
+			entries.reserve(writes.size());
+			for (const auto &write : writes)
+			{
+				if (!is_node_key(write.first))
+					entries.push_back(&write);
+			}
+			if (entries.empty())
+			{
+				root(out);
+				return;
+			}
+			auto parallel = _pool && _pool->concurrency() > 1 && entries.size() >= NEOVM_STATE_ROOT_MIN_PARALLEL_CHANGES;
+
+			std::vector<Change> changes(entries.size());
+			auto hash_entries = [&entries, &changes](size_t chunk) {
+				auto last = std::min(entries.size(), (chunk + 1) * HASH_CHUNK);
+				for (auto i = chunk * HASH_CHUNK; i < last; i++)
+				{
+					const auto &key = entries[i]->first;
+					const auto &write = entries[i]->second;
+					sha256(key.data(), key.size(), changes[i].path);
+					changes[i].removed = write.removed;
+					if (!write.removed)
+						sha256(write.value.data(), write.value.size(), changes[i].value_hash);
+				}
+			};
+			auto chunks = (entries.size() + HASH_CHUNK - 1) / HASH_CHUNK;
+			if (parallel)
+				_pool->parallel_for(chunks, hash_entries);
+			else
+			{
+				for (size_t i = 0; i < chunks; i++)
+					hash_entries(i);
+			}
+			std::sort(changes.begin(), changes.end(), [](const Change &x, const Change &y) {
+				return memcmp(x.path, y.path, NEOVM_SHA256_SIZE) < 0;
+			});
+
+			char root_path[NEOVM_SHA256_SIZE] = {};
+			auto root = read_node(0, root_path);
+			auto begin = changes.data();
+			auto end = begin + changes.size();
+			StorageWriteSet nodes;
+			Node result;
+			if (parallel)
+			{
+				Plan plan;
+				plan.depth = 0;
+				while (((size_t)1 << plan.depth) < _pool->concurrency() * SUBTREES_PER_THREAD && plan.depth < 16)
+					plan.depth++;
+				plan.finishing = false;
+				plan.next = 0;
+				update(0, root, begin, end, &nodes, &plan);
+				std::vector<StorageWriteSet> subtree_nodes(plan.subtrees.size());
+				// the storage is only read until all subtrees are done
+				_pool->parallel_for(plan.subtrees.size(), [this, &plan, &subtree_nodes](size_t i) {
+					auto &subtree = plan.subtrees[i];
+					subtree.result = update(subtree.depth, subtree.node, subtree.begin, subtree.end, &subtree_nodes[i], nullptr);
+				});
+				plan.finishing = true;
+				result = update(0, root, begin, end, &nodes, &plan);
+				// the subtrees are disjoint and below the nodes of the second walk, so no key is written twice
+				for (auto &part : subtree_nodes)
+					nodes.insert(part.begin(), part.end());
+			}
+			else
+				result = update(0, root, begin, end, &nodes, nullptr);
+			result.store(0, root_path, &nodes);
+			apply_storage_writes(nodes, _storage);
+			memcpy(out, result.hash, NEOVM_STATE_ROOT_SIZE);
+		}
+	}
+}
@@ -0,0 +1,94 @@
+#include <neovm/storage.hpp>
+
+namespace neo
+{
+	namespace vm
+	{
+		std::string contract_storage_key(const char *script_id, size_t script_id_size, const char *key, size_t key_size)
+		{
+			std::string result;
+			result.reserve(4 + script_id_size + key_size);
+			// the length as a var int, script ids are NEO script hashes (20 bytes) almost always
+			size_t length = script_id_size;
+			while (length >= 0x80)
+			{
+				result.push_back((char)(0x80 | (length & 0x7F)));
+				length >>= 7;
+			}
+			result.push_back((char)length);
+			result.append(script_id, script_id_size);
+			result.append(key, key_size);
+			return result;
+		}
+
+		StorageOverlay::StorageOverlay(IStorage *parent)
+			: _parent(parent)
+		{
+		}
+
+		bool StorageOverlay::get(const std::string &key, std::vector<char> *value)
+		{
+			auto found = _writes.find(key);
+			if (found == _writes.end())
+				return _parent->get(key, value);
+			if (found->second.removed)
+				return false;
+			*value = found->second.value;
+			return true;
+		}
+
+		void StorageOverlay::put(const std::string &key, const std::vector<char> &value)
+		{
+			auto &write = _writes[key];
+			write.removed = false;
+			write.value = value;
+		}
+
+		void StorageOverlay::remove(const std::string &key)
+		{
+			auto &write = _writes[key];
+			write.removed = true;
+			write.value.clear();
+		}
+
+		void StorageOverlay::commit()
+		{
+			apply_storage_writes(_writes, _parent);
+			_writes.clear();
+		}
+
+		void StorageOverlay::discard()
+		{
+			_writes.clear();
+		}
+
+		RecordingStorage::RecordingStorage(IStorage *base)
+			: StorageOverlay(base)
+		{
+		}
+
+		bool RecordingStorage::get(const std::string &key, std::vector<char> *value)
+		{
+			if (_writes.find(key) == _writes.end())
+				_reads.insert(key);
+			return StorageOverlay::get(key, value);
+		}
+
+		void RecordingStorage::clear()
+		{
+			_writes.clear();
+			_reads.clear();
+		}
+
+		void apply_storage_writes(const StorageWriteSet &writes, IStorage *storage)
+		{
+			for (const auto &write : writes)
+			{
+				if (write.second.removed)
+					storage->remove(write.first);
+				else
+					storage->put(write.first, write.second.value);
+			}
+		}
+	}
+}
@@ -0,0 +1,109 @@
+#include <neovm/thread_pool.hpp>
+
+namespace neo
+{
+	namespace vm
+	{
+		ThreadPool::ThreadPool(size_t threads)
+			: _task(nullptr), _count(0), _next(0), _active(0), _generation(0), _stopping(false)
+		{
+			if (threads == 0)
+			{
+				auto hardware = std::thread::hardware_concurrency();
+				threads = hardware > 1 ? hardware - 1 : 0;
+			}
+			_workers.reserve(threads);
+			for (size_t i = 0; i < threads; i++)
+				_workers.emplace_back(&ThreadPool::worker_loop, this);
+		}
+
+		ThreadPool::~ThreadPool()
+		{
+			{
+				std::lock_guard<std::mutex> lock(_mutex);
+				_stopping = true;
+			}
+			_work_ready.notify_all();
+			for (auto &worker : _workers)
+				worker.join();
+		}
+
+		size_t ThreadPool::concurrency() const
+		{
+			return _workers.size() + 1;
+		}
+
+		void ThreadPool::parallel_for(size_t count, const std::function<void(size_t)> &task)
+		{
+			if (count == 0)
+				return;
+			if (_workers.empty() || count == 1)
+			{
+				for (size_t i = 0; i < count; i++)
+					task(i);
+				return;
+			}
+			std::lock_guard<std::mutex> call_lock(_call_mutex);
+			{
+				std::lock_guard<std::mutex> lock(_mutex);
+				_task = &task;
+				_count = count;
+				_next = 0;
+				_active = _workers.size();
+				_error = nullptr;
+				++_generation;
+			}
+			_work_ready.notify_all();
+			run_tasks();
+			std::exception_ptr error;
+			{
+				std::unique_lock<std::mutex> lock(_mutex);
+				_work_done.wait(lock, [this] { return _active == 0; });
+				_task = nullptr;
+				error = _error;
+				_error = nullptr;
+			}
+			if (error)
+				std::rethrow_exception(error);
+		}
+
+		void ThreadPool::worker_loop()
+		{
+			uint64_t seen = 0;
+			for (;;)
+			{
+				{
+					std::unique_lock<std::mutex> lock(_mutex);
+					_work_ready.wait(lock, [this, seen] { return _stopping || _generation != seen; });
+					if (_stopping)
+						return;
+					seen = _generation;
+				}
+				run_tasks();
+				std::lock_guard<std::mutex> lock(_mutex);
+				if (--_active == 0)
+					_work_done.notify_one();
+			}
+		}
+
+		void ThreadPool::run_tasks()
+		{
+			for (;;)
+			{
+				auto i = _next.fetch_add(1);
+				if (i >= _count)
+					return;
+				try
+				{
+					(*_task)(i);
+				}
+				catch (...)
+				{
+					std::lock_guard<std::mutex> lock(_mutex);
+					if (!_error)
+						_error = std::current_exception();
+				}
+			}
+		}
+	}
+}
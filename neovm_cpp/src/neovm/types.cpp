@@ -2,7 +2,8 @@
 #include <neovm/execution_engine.hpp>
 #include <neovm/exceptions.hpp>
 #include <neovm/helper.hpp>
-#include <sstream>
+#include <neovm/json.hpp>
+#include <algorithm>
 
 namespace neo
 {
@@ -27,11 +28,21 @@ namespace neo
 			}
 		}
 
-		std::vector<StackItem*>* Array::GetArray()
+		StackItemVector* Array::GetArray()
 		{
 			return &_array;
 		}
 
+		void Array::references(std::vector<StackItem*> *out) const
+		{
+			out->insert(out->end(), _array.begin(), _array.end());
+		}
+
+		size_t Array::memory_size() const
+		{
+			return sizeof(Array) + _array.capacity() * sizeof(StackItem*);
+		}
+
 		VMBigInteger Array::GetBigInteger() const
 		{
 			throw NeoVmException("not supported operation");
@@ -44,24 +55,21 @@ namespace neo
 
 		std::string Array::GetString() const
 		{
-			return to_json_string({});
+			return to_json_string();
 		}
 
-		std::string Array::to_json_string(std::set<void*> referenced_objects) const
+		void Array::write_json(JsonWriter *writer) const
 		{
-			referenced_objects.insert((void*)this);
-			if (referenced_objects.size() > JSON_MAX_REFERENCE_OBJECT_COUNT)
-				throw NeoVmException("too many objects referenced in json");
-			std::stringstream ss;
-			ss << "[";
+			writer->enter(this);
+			writer->write_raw('[');
 			for (size_t i = 0; i < _array.size(); i++)
 			{
 				if (i > 0)
-					ss << ",";
-				ss << _array[i]->to_json_string(referenced_objects);
+					writer->write_raw(',');
+				_array[i]->write_json(writer);
 			}
-			ss << "]";
-			return ss.str();
+			writer->write_raw(']');
+			writer->leave(this);
 		}
 
 		std::vector<char> Array::GetByteArray() const
@@ -75,79 +83,206 @@ namespace neo
 			if (nullptr == other) return false;
 			if (other->type() != this->type()) return false;
 			Map *a = (Map*)other;
-			if (a == nullptr)
-			{
+			if (this->_count != a->_count)
 				return false;
-			}
-			else
+			for (const auto &entry : _entries)
 			{
-				if (this->_items.size() != a->_items.size())
+				if (!entry.key)
+					continue;
+				auto value = a->get(entry.key);
+				if (!value || !entry.value->Equals(value))
 					return false;
-				for (size_t i = 0; i < this->_items.size(); i++)
+			}
+			return true;
+		}
+
+		const int32_t Map::EMPTY_SLOT;
+		const int32_t Map::REMOVED_SLOT;
+
+		bool Map::is_valid_key(const StackValue &key)
+		{
+			if (!key.is_inline() && !key.item())
+				return false;
+			auto type = key.type();
+			return type == StackItemType::SIT_BYTE_ARRAY || type == StackItemType::SIT_INTEGER || type == StackItemType::SIT_BOOLEAN;
+		}
+
+		void Map::check_key(const StackValue &key)
+		{
+			if (!key.is_inline() && !key.item())
+				throw NeoVmException("Map key can't be null");
+			if (!is_valid_key(key))
+				throw NeoVmException("Map key must be a byte array, integer or boolean");
+		}
+
+		size_t Map::find_slot(const StackValue &key, size_t hash) const
+		{
+			size_t mask = _slots.size() - 1;
+			size_t insert_slot = SIZE_MAX;
+			// there is always an empty slot, see reserve_one
+			for (size_t i = hash & mask;; i = (i + 1) & mask)
+			{
+				auto index = _slots[i];
+				if (index == EMPTY_SLOT)
+					return insert_slot != SIZE_MAX ? insert_slot : i;
+				if (index == REMOVED_SLOT)
 				{
-					auto &pair1 = this->_items[i];
-					auto found = false;
-					for (size_t j = 0; j < a->_items.size(); j++)
-					{
-						auto &pair2 = a->_items[j];
-						if (pair1.first->Equals(pair2.first))
-						{
-							found = true;
-							if (!pair1.second->Equals(pair2.second))
-								return false;
-						}
-					}
-					if (!found)
-						return false;
+					if (insert_slot == SIZE_MAX)
+						insert_slot = i;
+					continue;
 				}
-				return true;
+				const auto &entry = _entries[index];
+				if (entry.hash == hash && StackValue(entry.key).Equals(key))
+					return i;
 			}
 		}
 
+		void Map::rehash(size_t capacity)
+		{
+			size_t live = 0;
+			for (size_t i = 0; i < _entries.size(); i++)
+			{
+				if (_entries[i].key)
+					_entries[live++] = _entries[i];
+			}
+			_entries.resize(live);
+			size_t slots_count = 8;
+			while (slots_count / 4 * 3 < capacity)
+				slots_count *= 2;
+			_slots.assign(slots_count, EMPTY_SLOT);
+			size_t mask = slots_count - 1;
+			for (size_t index = 0; index < _entries.size(); index++)
+			{
+				size_t i = _entries[index].hash & mask;
+				while (_slots[i] != EMPTY_SLOT)
+					i = (i + 1) & mask;
+				_slots[i] = (int32_t)index;
+			}
+		}
+
+		void Map::reserve_one()
+		{
+			// removed entries keep their slot until the next rehash, so _entries.size() is the number of used slots
+			if (_entries.size() + 1 > _slots.size() / 4 * 3)
+				rehash(_count + 1 > _count * 2 ? _count + 1 : _count * 2);
+		}
+
 		void Map::put(StackItem *key, StackItem *value)
 		{
-			if (!key || key->type() != StackItemType::SIT_BYTE_ARRAY)
-				throw NeoVmException("Map key must be string");
+			check_key(key);
 			if (!value)
 				throw NeoVmException("Map value can't be null");
-			for (size_t i = 0; i < _items.size(); i++)
+			auto hash = key->hash_code();
+			reserve_one();
+			auto slot = find_slot(key, hash);
+			if (_slots[slot] >= 0)
 			{
-				auto &pair = _items[i];
-				if (pair.first->Equals(key))
-				{
-					pair.second = value;
-					return;
-				}
+				_entries[_slots[slot]].value = value;
+				return;
 			}
-			_items.push_back(std::make_pair(key, value));
+			_slots[slot] = (int32_t)_entries.size();
+			Entry entry = { key, value, hash };
+			_entries.push_back(entry);
+			_count++;
 		}
 
-		StackItem* Map::get(StackItem *key)
+		void Map::put(ExecutionEngine *engine, const StackValue &key, StackItem *value)
 		{
-			if (!key || key->type() != StackItemType::SIT_BYTE_ARRAY)
-				throw NeoVmException("Map key must be string");
-			for (size_t i = 0; i < _items.size(); i++)
+			check_key(key);
+			if (!value)
+				throw NeoVmException("Map value can't be null");
+			auto hash = key.hash_code();
+			reserve_one();
+			auto slot = find_slot(key, hash);
+			if (_slots[slot] >= 0)
 			{
-				auto &pair = _items[i];
-				if (pair.first->Equals(key))
-				{
-					return pair.second;
-				}
+				_entries[_slots[slot]].value = value;
+				return;
 			}
-			return nullptr;
+			_slots[slot] = (int32_t)_entries.size();
+			Entry entry = { key.to_stack_item(engine), value, hash };
+			_entries.push_back(entry);
+			_count++;
+		}
+
+		StackItem* Map::get(StackItem *key)
+		{
+			return get(StackValue(key));
+		}
+
+		StackItem* Map::get(const StackValue &key)
+		{
+			check_key(key);
+			if (_count == 0)
+				return nullptr;
+			auto index = _slots[find_slot(key, key.hash_code())];
+			return index >= 0 ? _entries[index].value : nullptr;
+		}
+
+		bool Map::remove(const StackValue &key)
+		{
+			check_key(key);
+			if (_count == 0)
+				return false;
+			auto slot = find_slot(key, key.hash_code());
+			auto index = _slots[slot];
+			if (index < 0)
+				return false;
+			_entries[index].key = nullptr;
+			_entries[index].value = nullptr;
+			_slots[slot] = REMOVED_SLOT;
+			_count--;
+			return true;
 		}
 
 		std::vector<StackItem*> Map::keys() const
 		{
 			std::vector<StackItem*> key_items;
-			for (size_t i = 0; i < _items.size(); i++)
+			key_items.reserve(_count);
+			for (const auto &entry : _entries)
 			{
-				auto &pair = _items[i];
-				key_items.push_back(pair.first);
+				if (entry.key)
+					key_items.push_back(entry.key);
 			}
 			return key_items;
 		}
 
+		void Map::keys(StackItemVector *out) const
+		{
+			out->reserve(out->size() + _count);
+			for (const auto &entry : _entries)
+			{
+				if (entry.key)
+					out->push_back(entry.key);
+			}
+		}
+
+		void Map::values(StackItemVector *out) const
+		{
+			out->reserve(out->size() + _count);
+			for (const auto &entry : _entries)
+			{
+				if (entry.key)
+					out->push_back(entry.value);
+			}
+		}
+
+		void Map::references(std::vector<StackItem*> *out) const
+		{
+			for (const auto &entry : _entries)
+			{
+				if (!entry.key)
+					continue;
+				out->push_back(entry.key);
+				out->push_back(entry.value);
+			}
+		}
+
+		size_t Map::memory_size() const
+		{
+			return sizeof(Map) + _entries.capacity() * sizeof(Entry) + _slots.capacity() * sizeof(int32_t);
+		}
+
 		VMBigInteger Map::GetBigInteger() const
 		{
 			throw NeoVmException("not supported operation");
@@ -160,25 +295,34 @@ namespace neo
 
 		std::string Map::GetString() const
 		{
-			return to_json_string({});
+			return to_json_string();
 		}
 
-		std::string Map::to_json_string(std::set<void*> referenced_objects) const
+		void Map::write_json(JsonWriter *writer) const
 		{
-			referenced_objects.insert((void*)this);
-			if (referenced_objects.size() > JSON_MAX_REFERENCE_OBJECT_COUNT)
-				throw NeoVmException("too many objects referenced in json");
-			std::stringstream ss;
-			ss << "{";
-			for (size_t i = 0; i < _items.size(); i++)
+			writer->enter(this);
+			writer->write_raw('{');
+			bool first = true;
+			for (const auto &entry : _entries)
 			{
-				const auto &pair = _items[i];
-				if (i > 0)
-					ss << ",";
-				ss << pair.first->to_json_string(referenced_objects) << ":" << pair.second->to_json_string(referenced_objects);
+				if (!entry.key)
+					continue;
+				if (!first)
+					writer->write_raw(',');
+				first = false;
+				if (entry.key->type() == StackItemType::SIT_BYTE_ARRAY)
+					entry.key->write_json(writer);
+				else
+				{
+					// json object keys are strings
+					auto key = entry.key->GetString();
+					writer->write_string(key.data(), key.size());
+				}
+				writer->write_raw(':');
+				entry.value->write_json(writer);
 			}
-			ss << "}";
-			return ss.str();
+			writer->write_raw('}');
+			writer->leave(this);
 		}
 
 		std::vector<char> Map::GetByteArray() const
@@ -198,6 +342,11 @@ namespace neo
 				return _value == b->_value;
 		}
 
+		size_t Boolean::hash_code() const
+		{
+			return _value ? 1 : 0;
+		}
+
 		VMBigInteger Boolean::GetBigInteger() const
 		{
 			return _value ? 1 : 0;
@@ -213,9 +362,9 @@ namespace neo
 			return _value ? "true" : "false";
 		}
 
-		std::string Boolean::to_json_string(std::set<void*> referenced_objects) const
+		void Boolean::write_json(JsonWriter *writer) const
 		{
-			return GetString();
+			writer->write_bool(_value);
 		}
 
 		std::vector<char> Boolean::GetByteArray() const
@@ -228,12 +377,23 @@ namespace neo
 			if (this == other) return true;
 			if (nullptr == other) return false;
 			if (other->type() != this->type()) return false;
-			return _value == other->GetByteArray();
+			auto other_value = other->GetByteArray();
+			return _value.size() == other_value.size() && std::equal(_value.begin(), _value.end(), other_value.begin());
+		}
+
+		size_t ByteArray::hash_code() const
+		{
+			return Helper::hash_bytes(_value.data(), _value.size());
 		}
 
 		std::vector<char> ByteArray::GetByteArray() const
 		{
-			return _value;
+			return std::vector<char>(_value.begin(), _value.end());
+		}
+
+		size_t ByteArray::memory_size() const
+		{
+			return sizeof(ByteArray) + _value.capacity();
 		}
 
 		std::string ByteArray::GetString() const
@@ -245,9 +405,11 @@ namespace neo
 			return str;
 		}
 
-		std::string ByteArray::to_json_string(std::set<void*> referenced_objects) const
+		void ByteArray::write_json(JsonWriter *writer) const
 		{
-			return Helper::quote_string(GetString());
+			// same text as GetString, which ends at the first zero byte
+			auto end = std::find(_value.begin(), _value.end(), '\0');
+			writer->write_string(_value.data(), end - _value.begin());
 		}
 
 		bool Integer::Equals(StackItem *other)
@@ -262,6 +424,16 @@ namespace neo
 				return _value == i->_value;
 		}
 
+		size_t Integer::hash_code() const
+		{
+			if (!_value.is_small())
+			{
+				auto bytes = _value.to_byte_array();
+				return Helper::hash_bytes(bytes.data(), bytes.size());
+			}
+			return Helper::hash_int64(_value.small_value());
+		}
+
 		VMBigInteger Integer::GetBigInteger() const
 		{
 			return _value;
@@ -274,12 +446,12 @@ namespace neo
 
 		std::string Integer::GetString() const
 		{
-			return std::to_string(_value);
+			return _value.to_string();
 		}
 
-		std::string Integer::to_json_string(std::set<void*> referenced_objects) const
+		void Integer::write_json(JsonWriter *writer) const
 		{
-			return GetString();
+			writer->write_integer(_value);
 		}
 
 		std::vector<char> Integer::GetByteArray() const
@@ -301,7 +473,7 @@ namespace neo
 
 		StackItem * Struct::Clone(ExecutionEngine *engine)
 		{
-			std::vector<StackItem*> newArray;
+			std::vector<StackItem*> newArray(_array.size());
 			for (size_t i = 0; i < _array.size(); i++)
 			{
 				if (_array[i]->IsStruct())
@@ -314,29 +486,7 @@ namespace neo
 					//ǹ̶ֵͣڲֵȻҪƣֱ= 
 				}
 			}
-			return new Struct(engine, newArray);
-		}
-
-		std::string Struct::GetString() const
-		{
-			return to_json_string({});
-		}
-
-		std::string Struct::to_json_string(std::set<void*> referenced_objects) const
-		{
-			referenced_objects.insert((void*)this);
-			if (referenced_objects.size() > JSON_MAX_REFERENCE_OBJECT_COUNT)
-				throw NeoVmException("too many referenced object in json");
-			std::stringstream ss;
-			ss << "[";
-			for (size_t i = 0; i < _array.size(); i++)
-			{
-				if (i > 0)
-					ss << ",";
-				ss << _array[i]->to_json_string(referenced_objects);
-			}
-			ss << "]";
-			return ss.str();
+			return new (engine->memory_resource()) Struct(engine, newArray);
 		}
 
 		bool Userdata::Equals(StackItem *other)
@@ -368,9 +518,10 @@ namespace neo
 			return "<userdata>";
 		}
 
-		std::string Userdata::to_json_string(std::set<void*> referenced_objects) const
+		void Userdata::write_json(JsonWriter *writer) const
 		{
-			return GetString();
+			auto str = GetString();
+			writer->write_string(str.data(), str.size());
 		}
 
 		std::vector<char> Userdata::GetByteArray() const
@@ -383,8 +534,8 @@ namespace neo
 		}
 
 		Array::Array(ExecutionEngine *engine, std::vector<StackItem*> value)
+			: _array(value.begin(), value.end(), Allocator<StackItem*>(engine->memory_resource()))
 		{
-			this->_array = value;
 			_type = StackItemType::SIT_ARRAY;
 			engine->add_stack_item_to_pool(this);
 		}
@@ -404,8 +555,15 @@ namespace neo
 		}
 
 		ByteArray::ByteArray(ExecutionEngine *engine, std::vector<char> value)
+			: _value(value.begin(), value.end(), Allocator<char>(engine->memory_resource()))
+		{
+			_type = StackItemType::SIT_BYTE_ARRAY;
+			engine->add_stack_item_to_pool(this);
+		}
+
+		ByteArray::ByteArray(ExecutionEngine *engine, const char *data, size_t size)
+			: _value(data, data + size, Allocator<char>(engine->memory_resource()))
 		{
-			this->_value = value;
 			_type = StackItemType::SIT_BYTE_ARRAY;
 			engine->add_stack_item_to_pool(this);
 		}
@@ -419,13 +577,15 @@ namespace neo
 
 		Struct::Struct(ExecutionEngine *engine, std::vector<StackItem*> value) : Array(engine, value)
 		{
+			// already added to the engine by the Array constructor
 			_type = StackItemType::SIT_STRUCT;
-			engine->add_stack_item_to_pool(this);
 		}
 
 		Map::Map(ExecutionEngine *engine, std::vector<std::pair<StackItem*, StackItem*>> items)
+			: _entries(Allocator<Entry>(engine->memory_resource())), _slots(Allocator<int32_t>(engine->memory_resource())), _count(0)
 		{
 			this->_type = StackItemType::SIT_MAP;
+			rehash(items.size());
 			for (const auto &pair : items)
 			{
 				put(pair.first, pair.second);
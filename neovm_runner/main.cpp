@@ -7,23 +7,12 @@
 #include <vmimpl/script_table.hpp>
 #include <neovm/types.hpp>
 #include <neovm/script_builder.hpp>
+#include <neovm/file_storage.hpp>
 
 using namespace neo::vm;
 using namespace neo::utils;
 
 
-bool GetStorageContext(neo::vm::ExecutionEngine *engine)
-{
-	// TODO: storage contextuserdataѹջͷźpre_close_callback
-	auto storage_context = new std::string("TODO");
-	engine->add_pre_close_callbacks([storage_context](neo::vm::ExecutionEngine *engine) {
-		std::cout << "freeed storage context" << std::endl;
-		delete storage_context;
-	});
-	engine->evaluation_stack()->push_back(neo::vm::StackItem::to_stack_userdata_item(engine, (void*)storage_context));
-	return true;
-}
-
 bool GetTrigger(neo::vm::ExecutionEngine *engine)
 {
 	// TODO: neo Trigger
@@ -32,41 +21,6 @@ bool GetTrigger(neo::vm::ExecutionEngine *engine)
 	return true;
 }
 
-bool SetStorage(neo::vm::ExecutionEngine *engine)
-{
-	auto cur_script_id = engine->current_context()->script_id();
-	auto &eval_stack = *(engine->evaluation_stack());
-	auto storage_context_item = neo::vm::Helper::pop(eval_stack);
-	if (!storage_context_item->IsUserdata())
-	{
-		throw NeoVmException("need storage context argument");
-	}
-	auto storage_context_addr = ((neo::vm::Userdata*)storage_context_item)->get_userdata_address();
-	auto prop_name = neo::vm::Helper::pop(eval_stack)->GetString();
-	auto prop_value = neo::vm::Helper::pop(eval_stack);
-
-	// TODO:  storage浽
-	std::cout << "storage[" << prop_name << "]=" << prop_value->GetString() << std::endl;
-	return true;
-}
-
-bool GetStorage(ExecutionEngine *engine)
-{
-	auto cur_script_id = engine->current_context()->script_id();
-	auto &eval_stack = *(engine->evaluation_stack());
-	auto storage_context_item = neo::vm::Helper::pop(eval_stack);
-	if (!storage_context_item->IsUserdata())
-	{
-		throw NeoVmException("need storage context argument");
-	}
-	auto storage_context_addr = ((neo::vm::Userdata*)storage_context_item)->get_userdata_address();
-	auto prop_name = neo::vm::Helper::pop(eval_stack)->GetString();
-	// TODO: ϶ȡstorage
-	std::cout << "storage[" << prop_name << "] loaded from chain" << std::endl;
-	engine->evaluation_stack()->push_back(neo::vm::StackItem::to_stack_item(engine, 1234));
-	return true;
-}
-
 bool Dummy(neo::vm::ExecutionEngine *engine)
 {
 	std::cout << "dummy interop service doing" << std::endl;
@@ -78,15 +32,15 @@ bool CorePrint(neo::vm::ExecutionEngine *engine)
 	std::cout << "core_print api doing" << std::endl;
 	auto &eval_stack = *(engine->evaluation_stack());
 	auto item = neo::vm::Helper::pop(eval_stack);
-	if (item->type() == neo::vm::StackItemType::SIT_BYTE_ARRAY)
+	if (item.type() == neo::vm::StackItemType::SIT_BYTE_ARRAY)
 	{
-		auto str = item->GetString();
+		auto str = item.GetString();
 		std::cout << str << std::endl;
 	}
-	else if (item->type() == StackItemType::SIT_INTEGER)
+	else if (item.type() == StackItemType::SIT_INTEGER)
 	{
-		auto num = item->GetBigInteger();
-		std::cout << num << std::endl;
+		auto num = item.GetBigInteger();
+		std::cout << num.to_string() << std::endl;
 	}
 	return true;
 }
@@ -127,12 +81,12 @@ int main(int argc, char **argv)
 	neo::vm::impl::DemoCrypto crypto;
 	neo::vm::impl::DemoScriptTable script_table;
 
+	// contract storage persists between runs, the Neo.Storage services of the interop service read and write it
+	neo::vm::FileStorage storage("neovm_storage.db");
+
 	neo::vm::InteropService interop_service;
 
 	// ⼸Ӧʹ()ע
-	interop_service.register_service("Neo.Storage.GetContext", GetStorageContext);
-	interop_service.register_service("Neo.Storage.Put", SetStorage);
-	interop_service.register_service("Neo.Storage.Get", GetStorage);
 	interop_service.register_service("Neo.Runtime.GetTrigger", GetTrigger);
 
 	interop_service.register_service("dummy", Dummy);
@@ -142,6 +96,7 @@ int main(int argc, char **argv)
 	auto engine = std::make_shared<neo::vm::ExecutionEngine>(&script_container, &crypto, &script_table, &interop_service);
 	engine->open_debug_mode();
 	engine->set_neo_mode(false);
+	engine->set_storage(&storage);
 
 	for (auto i = 1; i < argc; i++)
 	{
@@ -170,6 +125,13 @@ int main(int argc, char **argv)
 		{
 			auto result_item = engine->execute_script("demo_script", script_args, true);
 			std::cout << "vm execute end with status " << engine->state() << std::endl;
+			if (neo::vm::Helper::enum_has_flag(engine->state(), neo::vm::VMState::FAULT))
+			{
+				std::cerr << "fault: " << engine->fault_message() << std::endl;
+				storage.rollback();
+			}
+			else
+				storage.commit();
 			if (result_item)
 			{
 				auto result_str = result_item->GetString();
@@ -179,6 +141,7 @@ int main(int argc, char **argv)
 		catch (std::exception &e)
 		{
 			std::cerr << "error: " << e.what() << std::endl;
+			storage.rollback();
 		}
 	}
 	return 0;
@@ -1,17 +1,162 @@
 #include <neovm_test/stdafx.h>
 
-
-#include <neovm_test/stdafx.h>
-
 #include <iostream>
 #include <fstream>
+#include <map>
+#include <string.h>
 #include <neovm/execution_engine.hpp>
+#include <neovm/script_builder.hpp>
+#include <neovm/storage.hpp>
 #include <vmimpl/script_container.hpp>
 #include <vmimpl/crypto.hpp>
 #include <vmimpl/script_table.hpp>
 
-int main()
+using namespace neo::vm;
+
+namespace
 {
-    return 0;
+	class MemoryStorage : public IStorage
+	{
+	public:
+		std::map<std::string, std::vector<char>> entries;
+
+		virtual bool get(const std::string &key, std::vector<char> *value)
+		{
+			auto found = entries.find(key);
+			if (found == entries.end())
+				return false;
+			*value = found->second;
+			return true;
+		}
+
+		virtual void put(const std::string &key, const std::vector<char> &value)
+		{
+			entries[key] = value;
+		}
+
+		virtual void remove(const std::string &key)
+		{
+			entries.erase(key);
+		}
+	};
+
+	std::vector<char> contract_id(char tag)
+	{
+		return std::vector<char>(20, tag);
+	}
+
+	void put_contract(impl::DemoScriptTable *table, char tag, ScriptBuilder &builder)
+	{
+		auto script = builder.to_char_array();
+		table->put_script(std::string(20, tag), script);
+	}
+
+	// a contract called with APPCALL tail calls another one: the tail call frees the caller's script while the
+	// storage frame of the APPCALL is still open, the callee's write must reach the storage when the frame returns
+	bool test_tail_call_in_storage_frame()
+	{
+		impl::DemoScriptContainer container;
+		impl::DemoCrypto crypto;
+		impl::DemoScriptTable table;
+
+		ScriptBuilder writer;
+		writer.emit_push("value");
+		writer.emit_push("key");
+		writer.emit_sys_call("Neo.Storage.GetContext");
+		writer.emit_sys_call("Neo.Storage.Put");
+		writer.emit(OpCode::OP_RET);
+		put_contract(&table, 'c', writer);
+
+		ScriptBuilder forwarder;
+		forwarder.emit_app_call(contract_id('c'), true);
+		forwarder.emit(OpCode::OP_RET);
+		put_contract(&table, 'b', forwarder);
+
+		ScriptBuilder entry;
+		entry.emit_app_call(contract_id('b'));
+		entry.emit(OpCode::OP_RET);
+
+		MemoryStorage storage;
+		ExecutionEngine engine(&container, &crypto, &table);
+		engine.set_storage(&storage);
+		engine.set_storage_frames(true);
+		engine.load_script(entry.to_char_array(), contract_id('a'), false);
+		engine.execute();
+		return (engine.state() & VMState::HALT) && storage.entries.size() == 1;
+	}
+
+	// script hashes that only differ after a zero byte are different contracts with storages of their own, although the
+	// script table, looking them up as strings, gives both the same script
+	bool test_script_ids_with_zero_bytes()
+	{
+		impl::DemoScriptContainer container;
+		impl::DemoCrypto crypto;
+		impl::DemoScriptTable table;
+
+		ScriptBuilder writer;
+		writer.emit_push("value");
+		writer.emit_push("key");
+		writer.emit_sys_call("Neo.Storage.GetContext");
+		writer.emit_sys_call("Neo.Storage.Put");
+		writer.emit(OpCode::OP_RET);
+		auto script = writer.to_char_array();
+		table.put_script("x", script);
+
+		auto first = contract_id('a');
+		auto second = contract_id('b');
+		first[0] = second[0] = 'x';
+		first[1] = second[1] = 0;
+		ScriptBuilder entry;
+		entry.emit_app_call(first);
+		entry.emit_app_call(second);
+		entry.emit(OpCode::OP_RET);
+
+		MemoryStorage storage;
+		ExecutionEngine engine(&container, &crypto, &table);
+		engine.set_storage(&storage);
+		engine.load_script(entry.to_char_array(), contract_id('e'), false);
+		engine.execute();
+		return (engine.state() & VMState::HALT) && storage.entries.size() == 2;
+	}
+
+	// hashing an empty byte array, whose data pointer may be null
+	bool test_hash_of_empty_bytes()
+	{
+		impl::DemoScriptContainer container;
+		impl::DemoCrypto crypto;
+		ScriptBuilder builder;
+		builder.emit(OpCode::OP_PUSH0);
+		builder.emit(OpCode::OP_SHA256);
+		builder.emit(OpCode::OP_RET);
+
+		ExecutionEngine engine(&container, &crypto);
+		engine.load_script(builder.to_char_array(), contract_id('e'), false);
+		engine.execute();
+		if (!(engine.state() & VMState::HALT))
+			return false;
+		auto hash = engine.evaluation_stack()->pop().GetByteArray();
+		const unsigned char expected[4] = { 0xe3, 0xb0, 0xc4, 0x42 };
+		return hash.size() == 32 && memcmp(hash.data(), expected, sizeof(expected)) == 0;
+	}
 }
 
+int main()
+{
+	int failed = 0;
+	if (!test_tail_call_in_storage_frame())
+	{
+		std::cout << "failed: tail call in a storage frame" << std::endl;
+		failed++;
+	}
+	if (!test_script_ids_with_zero_bytes())
+	{
+		std::cout << "failed: script ids with zero bytes" << std::endl;
+		failed++;
+	}
+	if (!test_hash_of_empty_bytes())
+	{
+		std::cout << "failed: hash of empty bytes" << std::endl;
+		failed++;
+	}
+	return failed;
+}